@@ -2,78 +2,662 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #include <mpi.h>
 #include <netcdf.h>
+#include <zlib.h>
 
+#include "admission.h"
+#include "batch.h"
 #include "calendar.h"
 #include "config.h"
+#include "dataset.h"
 #include "hyperslab.h"
 #include "io.h"
+#include "kernels.h"
 #include "location.h"
+#include "manifest.h"
+#include "node_buffer.h"
+#include "output_writer.h"
+#include "perf.h"
+#include "plan.h"
+#include "prefetch.h"
+#include "progress.h"
+#include "quantize.h"
+#include "rechunk.h"
+#include "server.h"
+#include "slab_cache.h"
+#include "startup.h"
+#include "summary.h"
+#include "transpose.h"
 #include "unit_util.h"
+#include "weather_file.h"
 
-static void resetDailyAvg(float *daily_avg) {
-  for (size_t i = 0; i < 31; ++i) {
-    daily_avg[i] = -99.9f;
+typedef struct RecordCounts_ {
+  size_t written;
+  size_t skipped;
+  size_t files;
+  size_t text_bytes;
+} RecordCounts;
+
+// Converts the values [first, first + count) of every mapping of the tile,
+// one mapping at a time, then evaluates the derived variables over the
+// converted buffers. Mappings which already point at converted values (from
+// the slab cache) are left untouched. A mapping set with a kernel of its own
+// is converted by it in one pass.
+static int convertTile(const Config *config, const NetCdfInfo *info,
+                       const ConverterContainer *converters,
+                       const CellKernels *kernels, Hyperslab h,
+                       const float *values, float *converted_values,
+                       const float **converted_ptrs, size_t first,
+                       size_t count) {
+  if (kernels->convert != NULL) {
+    const float *raw[KERNEL_MAX_MAPPINGS];
+    float *converted[KERNEL_MAX_MAPPINGS];
+    for (size_t m = 0; m < config->num_mappings; ++m) {
+      raw[m] = &values[m * h.flat_size + first];
+      converted[m] = &converted_values[m * h.flat_size + first];
+      converted_ptrs[m] = &converted_values[m * h.flat_size];
+    }
+    kernels->convert(kernels, raw, converted, count);
+    return 0;
+  }
+  float input_fills[config->num_mappings];
+  const float *inputs[config->num_mappings];
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    input_fills[m] = info[m].fill_value;
+  }
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    if (converted_ptrs[m] != NULL) {
+      continue;
+    }
+    const float *raw = &values[m * h.flat_size];
+    float *converted = &converted_values[m * h.flat_size];
+    converted_ptrs[m] = converted;
+    if (config->mappings[m].derived != NULL) {
+      for (size_t k = 0; k < config->num_mappings; ++k) {
+        inputs[k] = converted_ptrs[k] != NULL ? converted_ptrs[k] + first
+                                              : NULL;
+      }
+      if (EvaluateExpression(config->mappings[m].derived, inputs,
+                             input_fills, count, info[m].fill_value,
+                             &converted[first])) {
+        return 1;
+      }
+      continue;
+    }
+    ConvertValues(&converters[m], info[m].fill_value, &raw[first],
+                  &converted[first], count);
   }
+  return 0;
 }
 
-static float calculateMonthlyAvg(const float *daily_avg) {
-  float sum = 0.0f;
-  size_t i = 0;
-  while (daily_avg[i] != -99.9f && i < 31) {
-    sum += daily_avg[i];
-    ++i;
+// With quantized storage the mappings which feed a derived variable, and the
+// temperatures the header is summarized from, stay converted floats until the
+// tile is complete, each in its own region of the slot buffer after the
+// scratch region 0 used by all other mappings.
+static size_t floatRegions(const Config *config, size_t *regions) {
+  size_t num_regions = 1;
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    regions[m] = 0;
   }
-  if (i == 0) {
-    return 0.0f;
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    if (config->mappings[m].is_temp != 0) {
+      regions[m] = num_regions++;
+    }
+  }
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    const Expression *derived = config->mappings[m].derived;
+    for (size_t k = 0; derived != NULL && k < derived->num_inputs; ++k) {
+      if (regions[derived->inputs[k]] == 0) {
+        regions[derived->inputs[k]] = num_regions++;
+      }
+    }
   }
-  return sum / i;
+  return num_regions;
 }
 
-int main(int argc, char **argv) {
-  printf("== GGCMI to DSSAT Weather Extractor ==\n");
-  size_t start_time = time(NULL);
-  if (argc != 2) {
-    fprintf(stderr, "error: not enough arguments\n");
-    return EXIT_FAILURE;
+// Evaluates the derived variables of a quantized tile and quantizes them,
+// together with the float inputs left by the reads. The TAV and AMP of each
+// cell are taken from the float temperatures, as without quantizing.
+static size_t quantizeTile(const Config *config, const NetCdfInfo *info,
+                           const DateTable *dates, Hyperslab h,
+                           const size_t *regions, float *values,
+                           int16_t *quantized, int32_t *offsets, double *tav,
+                           float *amp, int *status) {
+  size_t clamped = 0;
+  float input_fills[config->num_mappings];
+  const float *inputs[config->num_mappings];
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    input_fills[m] = info[m].fill_value;
+    inputs[m] = &values[regions[m] * h.flat_size];
   }
-  MPI_Init(NULL, NULL);
-  int world_size;
+  *status = 0;
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    const Expression *derived = config->mappings[m].derived;
+    if (derived == NULL && regions[m] == 0) {
+      continue;
+    }
+    float *converted = &values[regions[m] * h.flat_size];
+    if (derived != NULL && EvaluateExpression(derived, inputs, input_fills,
+                                              h.flat_size, info[m].fill_value,
+                                              converted)) {
+      *status = 1;
+      return clamped;
+    }
+    offsets[m] = QuantizeOffset(converted, h.flat_size, info[m].fill_value);
+    clamped += QuantizeValues(converted, h.flat_size, info[m].fill_value,
+                              offsets[m], &quantized[m * h.flat_size]);
+  }
+  const float *tmin = NULL;
+  const float *tmax = NULL;
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    if (config->mappings[m].is_temp == 1) {
+      tmin = inputs[m];
+    } else if (config->mappings[m].is_temp == 2) {
+      tmax = inputs[m];
+    }
+  }
+  if (SummarizeTileTemperatures(tmin, tmax,
+                                h.edges.x_length * h.edges.y_length, dates,
+                                tav, amp)) {
+    fprintf(stderr, "error: unable to summarize the temperatures of a "
+                    "tile\n");
+    *status = 1;
+  }
+  return clamped;
+}
+
+// Everything the reads of a tile need, shared with the prefetch thread. Each
+// slot holds the raw values of one tile and the cache entries mapped for it.
+// With quantized storage the values of a slot only hold the float regions,
+// and most mappings are converted and quantized as soon as they are read.
+typedef struct TileContext_ {
+  const Config *config;
+  const NetCdfInfo *info;
+  const Hyperslab *tiles;
+  const ConverterContainer *converters;
+  const size_t *regions;
+  Hyperslab extent;
+  const Hyperslab *slabs;
+  MPI_Comm mpi_comm;
+  TransposeStats transpose;
+  int reads;
+  float *values[PREFETCH_SLOTS];
+  int16_t *quantized[PREFETCH_SLOTS];
+  int32_t *offsets[PREFETCH_SLOTS];
+  SlabCacheEntry *cache_entries[PREFETCH_SLOTS];
+  const float **cached_ptrs[PREFETCH_SLOTS];
+  size_t cache_hits;
+  size_t cache_misses;
+  size_t clamped;
+} TileContext;
+
+static int quantizeMapping(TileContext *context, size_t t, size_t slot,
+                           size_t m) {
+  const Config *config = context->config;
+  const NetCdfInfo *info = &context->info[m];
+  Hyperslab h = context->tiles[t];
+  float *region = &context->values[slot][context->regions[m] * h.flat_size];
+  const float *converted = region;
+  SlabCacheEntry *entry = &context->cache_entries[slot][m];
+  if (config->cache_dir != NULL &&
+      OpenSlabCacheEntry(config->cache_dir, &config->mappings[m], h, entry)) {
+    converted = entry->values;
+    ++context->cache_hits;
+  } else {
+    if (config->cache_dir != NULL) {
+      ++context->cache_misses;
+    }
+    if (ReadHyperslab(&config->mappings[m], info, h, region)) {
+      return 1;
+    }
+    ConvertValues(&context->converters[m], info->fill_value, region, region,
+                  h.flat_size);
+    if (config->cache_dir != NULL) {
+      StoreSlabCacheEntry(config->cache_dir, &config->mappings[m], h,
+                          converted);
+    }
+  }
+  // Inputs of derived variables are quantized once those are evaluated
+  if (context->regions[m] != 0) {
+    if (converted != region) {
+      memcpy(region, converted, sizeof(float) * h.flat_size);
+    }
+    CloseSlabCacheEntry(entry);
+    return 0;
+  }
+  context->offsets[slot][m] =
+      QuantizeOffset(converted, h.flat_size, info->fill_value);
+  context->clamped += QuantizeValues(
+      converted, h.flat_size, info->fill_value, context->offsets[slot][m],
+      &context->quantized[slot][m * h.flat_size]);
+  CloseSlabCacheEntry(entry);
+  return 0;
+}
+
+static int readTile(void *arg, size_t t, size_t slot) {
+  TileContext *context = (TileContext *)arg;
+  const Config *config = context->config;
+  Hyperslab h = context->tiles[t];
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    context->cached_ptrs[slot][m] = NULL;
+  }
+  // The ranks read whole daily maps together and trade them for their slabs
+  if (config->read_strategy != read_tiles) {
+    return TransposedRead(config, context->info, context->extent,
+                          context->slabs, context->mpi_comm,
+                          context->values[slot], &context->transpose);
+  }
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    if (!context->reads || config->mappings[m].derived != NULL) {
+      continue;
+    }
+    if (config->quantize) {
+      if (quantizeMapping(context, t, slot, m)) {
+        return 1;
+      }
+      continue;
+    }
+    if (config->cache_dir != NULL) {
+      if (OpenSlabCacheEntry(config->cache_dir, &config->mappings[m], h,
+                             &context->cache_entries[slot][m])) {
+        context->cached_ptrs[slot][m] = context->cache_entries[slot][m].values;
+        ++context->cache_hits;
+        continue;
+      }
+      ++context->cache_misses;
+    }
+    if (ReadHyperslab(&config->mappings[m], &context->info[m], h,
+                      &context->values[slot][m * h.flat_size])) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void adviseTile(void *arg, size_t t) {
+  TileContext *context = (TileContext *)arg;
+  if (!context->reads) {
+    return;
+  }
+  for (size_t m = 0; m < context->config->num_mappings; ++m) {
+    if (context->config->mappings[m].derived == NULL) {
+      AdviseHyperslab(&context->info[m], context->tiles[t]);
+    }
+  }
+}
+
+static void writeText(const char *filename, const char *text, size_t size,
+                      Admission *admission, RecordCounts *records) {
+  double admitted = AdmitFile(admission);
+  FILE *fh = fopen(filename, "w");
+  if (fh == NULL) {
+    ReleaseFile(admission, admitted);
+    fprintf(stderr, "error: could not open file for writing: %s\n", filename);
+    return;
+  }
+  if (fwrite(text, 1, size, fh) != size) {
+    fprintf(stderr, "error: could not write %s\n", filename);
+  }
+  fclose(fh);
+  ReleaseFile(admission, admitted);
+  records->text_bytes += size;
+}
+
+static void addManifestRow(Manifest *manifest, XY position, const char *path,
+                           size_t bytes, size_t records, uint32_t checksum) {
+  LonLat ll = XYToLonLat(position);
+  ManifestRow row = {.global_id = XYToGlobalId(position),
+                     .longitude = ll.longitude,
+                     .latitude = ll.latitude,
+                     .bytes = bytes,
+                     .records = (uint32_t)records,
+                     .checksum = checksum,
+                     .skipped = path == NULL,
+                     .path = (char *)path};
+  if (AddManifestRow(manifest, &row)) {
+    fprintf(stderr, "warning: manifest row %zu dropped\n",
+            XYToGlobalId(position));
+  }
+}
+
+// The converted values of a tile, either as floats or quantized. Quantized
+// tiles come with the TAV and AMP of their cells.
+typedef struct TileValues_ {
+  const float *const *converted_ptrs;
+  const int16_t *quantized;
+  const int32_t *offsets;
+  const double *tav;
+  const float *amp;
+} TileValues;
+
+// The quantized counterpart of the gather kernels, for the cell at index of
+// each day plane of the tile.
+static int gatherQuantized(const NetCdfInfo *info, Hyperslab h,
+                           size_t num_mappings, const TileValues *values,
+                           size_t index, float *series) {
+  size_t plane = h.edges.x_length * h.edges.y_length;
+  for (size_t d = 0; d < h.edges.days; ++d) {
+    for (size_t m = 0; m < num_mappings; ++m) {
+      float value = DequantizeValue(
+          values->quantized[m * h.flat_size + d * plane + index],
+          values->offsets[m], info[m].fill_value);
+      if (value == info[m].fill_value && d == 0) {
+        return 1;
+      }
+      series[m * h.edges.days + d] = value;
+    }
+  }
+  return 0;
+}
+
+static void processTile(const Config *config, const NetCdfInfo *info,
+                        const CellKernels *kernels, Hyperslab h,
+                        const TileValues *values, const DateTable *dates,
+                        size_t cell_stride, size_t cell_offset,
+                        Manifest *manifest, SummaryGrid *summary,
+                        OutputWriter *writer, Admission *admission,
+                        Progress *progress, RecordCounts *records) {
+  // The series of a cell, mapping after mapping, as the file renders it
+  float *series =
+      (float *)malloc(sizeof(float) * config->num_mappings * h.edges.days);
+  if (series == NULL) {
+    fprintf(stderr, "error: unable to allocate the series of a cell\n");
+    return;
+  }
+  const float *tmin = NULL;
+  const float *tmax = NULL;
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    if (config->mappings[m].is_temp == 1) {
+      tmin = &series[m * h.edges.days];
+    } else if (config->mappings[m].is_temp == 2) {
+      tmax = &series[m * h.edges.days];
+    }
+  }
+  double tav;
+  float amp;
+  size_t plane = h.edges.x_length * h.edges.y_length;
+
+  for (size_t x = 0; x < h.edges.x_length; ++x) {
+    for (size_t y = 0; y < h.edges.y_length; ++y) {
+      // Ranks sharing a tile take every cell_stride-th cell of it
+      if ((x * h.edges.y_length + y) % cell_stride != cell_offset) {
+        continue;
+      }
+      size_t index = HyperslabValueIndex(h, Position(0, x, y));
+      int missing =
+          values->quantized == NULL
+              ? kernels->gather(kernels, values->converted_ptrs, plane, index,
+                                h.edges.days, series)
+              : gatherQuantized(info, h, config->num_mappings, values, index,
+                                series);
+      if (missing) {
+        ++records->skipped;
+        if (manifest != NULL) {
+          addManifestRow(manifest, XYPosition(h.corner.x + x, h.corner.y + y),
+                         NULL, 0, 0, 0);
+        }
+        AddProgress(progress, 1, 0);
+        continue;
+      }
+      records->written += h.edges.days;
+      if (values->quantized == NULL) {
+        SummarizeTemperatures(tmin, tmax, dates, &tav, &amp);
+      } else {
+        tav = values->tav[index];
+        amp = values->amp[index];
+      }
+      XY global_pos = XYPosition(h.corner.x + x, h.corner.y + y);
+      if (summary != NULL) {
+        float rain;
+        int missing_days;
+        SummarizeSeries(config, kernels->fills, series, h.edges.days, &rain,
+                        &missing_days);
+        AddCellSummary(summary, global_pos, tav, amp, rain, missing_days);
+      }
+      LonLat global_ll = XYToLonLat(global_pos);
+      // Now we write out the file
+      char filename[2048 + sizeof(COMPRESSED_OUTPUT_SUFFIX)];
+      GenerateFileName(global_pos, config->output_dir, filename);
+      // Files are rendered in memory when they are compressed or checksummed
+      char *text = NULL;
+      size_t text_size = 0;
+      int direct = writer == NULL && manifest == NULL;
+      double admitted = direct ? AdmitFile(admission) : 0.0;
+      FILE *fh = direct ? fopen(filename, "w")
+                        : open_memstream(&text, &text_size);
+      if (direct && fh == NULL) {
+        ReleaseFile(admission, admitted);
+      }
+      if (fh != NULL) {
+        WriteWeatherFile(fh, config, dates, global_ll, series, tav, amp);
+        ++records->files;
+        if (direct) {
+          text_size = ftell(fh);
+          records->text_bytes += text_size;
+          fclose(fh);
+          ReleaseFile(admission, admitted);
+        } else if (fclose(fh) == 0) {
+          if (writer != NULL) {
+            strcat(filename, COMPRESSED_OUTPUT_SUFFIX);
+          }
+          if (manifest != NULL) {
+            addManifestRow(manifest, global_pos, filename, text_size,
+                           h.edges.days,
+                           (uint32_t)crc32(0L, (const Bytef *)text, text_size));
+          }
+          if (writer != NULL) {
+            SubmitOutput(writer, filename, text, text_size);
+          } else {
+            writeText(filename, text, text_size, admission, records);
+            free(text);
+          }
+        } else {
+          free(text);
+        }
+      } else {
+        fprintf(stderr, "error: could not open file for writing: %s\n",
+                filename);
+      }
+      AddProgress(progress, 1, text_size);
+    }
+  }
+  free(series);
+}
+
+// What a run keeps across the scenarios of a batch. The time-axis table and
+// the sub-tile decomposition are rebuilt only when a scenario needs
+// different ones.
+typedef struct RunState_ {
+  int rechunk;
+  int batch;
+  int broadcast;
+  int units_loaded;
+  double config_seconds;
+  double unit_system_seconds;
+  int thread_level;
+  size_t start_time;
+  int start_year;
+  DateTable dates;
+  Hyperslab slab;
+  size_t num_mappings;
+  size_t max_memory_per_rank;
+  int node_size;
+  int read_strategy;
+  size_t value_bytes;
+  Hyperslab *tiles;
+  size_t num_tiles;
+} RunState;
+
+static int sameSlab(Hyperslab a, Hyperslab b) {
+  for (size_t i = 0; i < 3; ++i) {
+    if (a.corner.shape[i] != b.corner.shape[i] ||
+        a.edges.shape[i] != b.edges.shape[i]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void loadUnitSystem(RunState *run) {
+  if (!run->units_loaded) {
+    double start = PerfWallTime();
+    InitUnitSystem();
+    run->units_loaded = 1;
+    run->unit_system_seconds += PerfWallTime() - start;
+  }
+}
+
+// With a broadcast startup only the root reads the unit system, unless a
+// conversion is not affine and the other ranks need it after all.
+static int buildConverters(const Config *config,
+                           ConverterContainer *converters, MPI_Comm mpi_comm,
+                           RunState *run) {
+  int comm_rank;
+  MPI_Comm_rank(mpi_comm, &comm_rank);
+  if (!run->broadcast || comm_rank == 0) {
+    loadUnitSystem(run);
+  }
+  if (run->broadcast) {
+    size_t num_udunits;
+    if (BroadcastConverters(config, converters, mpi_comm, &num_udunits)) {
+      return 1;
+    }
+    if (num_udunits == 0 || comm_rank == 0) {
+      return 0;
+    }
+    loadUnitSystem(run);
+  }
+  for (size_t i = 0; i < config->num_mappings; ++i) {
+    if (converters[i].affine) {
+      continue;
+    }
+    if (BuildConverter(config->mappings[i].source_unit,
+                       config->mappings[i].target_unit, &converters[i])) {
+      fprintf(stderr, "error: unable to build the converter for %s -> %s\n",
+              config->mappings[i].source_unit, config->mappings[i].target_unit);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Extracts one configuration with the ranks of mpi_comm.
+static int runScenario(Config *config, MPI_Comm mpi_comm, RunState *run) {
+  size_t start_time = run->start_time;
   int world_rank;
-  MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+  int comm_size;
+  int comm_rank;
   MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+  MPI_Comm_size(mpi_comm, &comm_size);
+  MPI_Comm_rank(mpi_comm, &comm_rank);
 
-  char *config_file = argv[1];
-  Config *config;
+  PhaseSample phase;
+  BeginPhase(NULL, &phase, "setup");
 
-  printf("Loading config file: %s\n", config_file);
-  config = LoadConfig(config_file);
-  if (!config) {
-    return EXIT_FAILURE;
+  if (run->rechunk) {
+    config->point_major = 0;
+  }
+  if (config->prefetch && run->thread_level < MPI_THREAD_SERIALIZED) {
+    fprintf(stderr, "warning: the MPI library does not support threads, "
+                    "prefetch is disabled\n");
+    config->prefetch = 0;
+  }
+  if (config->node_shared &&
+      (config->prefetch || config->quantize || config->cache_dir != NULL)) {
+    fprintf(stderr, "warning: node_shared keeps one float tile per node, "
+                    "prefetch, quantize and cache_dir are disabled\n");
+    config->prefetch = 0;
+    config->quantize = 0;
+    free(config->cache_dir);
+    config->cache_dir = NULL;
   }
+  if (config->read_strategy != read_tiles &&
+      (config->prefetch || config->quantize || config->cache_dir != NULL ||
+       config->node_shared)) {
+    fprintf(stderr, "warning: transposed reads fill the whole slab of each "
+                    "rank at once, prefetch, quantize, cache_dir and "
+                    "node_shared are disabled\n");
+    config->prefetch = 0;
+    config->quantize = 0;
+    config->node_shared = 0;
+    free(config->cache_dir);
+    config->cache_dir = NULL;
+  }
+
+  PerfCounters counters;
+  InitPerfCounters(&counters, config->perf_counters);
 
   NetCdfInfo info[config->num_mappings];
   for (size_t i = 0; i < config->num_mappings; ++i) {
     info[i].unit = NULL;
+    info[i].chunk_reader = NULL;
+    info[i].parts = NULL;
+    info[i].num_parts = 0;
+    info[i].members = NULL;
+    info[i].num_members = 0;
   }
   printf("[%d] Checkpoint in seconds: %zu\n", world_rank,
          time(NULL) - start_time);
 
-  if (OpenAllDataFiles(config, MPI_COMM_WORLD, MPI_INFO_ENV) !=
+  double open_start = PerfWallTime();
+  if (OpenAllDataFiles(config, mpi_comm, MPI_INFO_ENV) !=
       config->num_mappings) {
+    FreePerfCounters(&counters);
     CloseAllDataFiles(config, info);
-    MPI_Finalize();
-    FreeConfig(config);
     return EXIT_FAILURE;
   }
 
   int status;
-  if (InjectNetCdfInfo(config, info)) {
+  double metadata_start = PerfWallTime();
+  if (run->broadcast ? BroadcastNetCdfInfo(config, info, mpi_comm)
+                     : InjectNetCdfInfo(config, info)) {
+    FreePerfCounters(&counters);
+    CloseAllDataFiles(config, info);
+    return EXIT_FAILURE;
+  }
+  OpenChunkReaders(config, info);
+  double metadata_end = PerfWallTime();
+
+  if (run->rechunk) {
+    EndPhase(NULL, &phase);
+    PrintPhaseSample(world_rank, &phase);
+    BeginPhase(NULL, &phase, "rechunk");
+    int rechunk_status = EXIT_SUCCESS;
+    size_t budget = config->max_memory_per_rank > 0
+                        ? config->max_memory_per_rank
+                        : DEFAULT_RECHUNK_BUDGET;
+    for (size_t i = 0; i < config->num_mappings; ++i) {
+      if (config->mappings[i].derived == NULL &&
+          RechunkMapping(&config->mappings[i], &info[i], mpi_comm, budget)) {
+        rechunk_status = EXIT_FAILURE;
+        break;
+      }
+    }
+    EndPhase(NULL, &phase);
+    PrintPhaseSample(world_rank, &phase);
+    FreePerfCounters(&counters);
+    CloseAllDataFiles(config, info);
+    return rechunk_status;
+  }
+
+  // With node_shared the extent is split between the nodes rather than the
+  // ranks; the leader of a node reads its tiles into a buffer shared by the
+  // node and every rank of the node converts and writes a part of them.
+  NodeBuffer node = {.node_comm = MPI_COMM_NULL,
+                     .leader_comm = MPI_COMM_NULL,
+                     .node_rank = 0,
+                     .node_size = 1,
+                     .node_index = comm_rank,
+                     .num_nodes = comm_size,
+                     .window = MPI_WIN_NULL,
+                     .values = NULL,
+                     .capacity = 0};
+  if (config->node_shared && SplitNodes(mpi_comm, &node)) {
+    FreePerfCounters(&counters);
     CloseAllDataFiles(config, info);
-    MPI_Finalize();
-    FreeConfig(config);
     return EXIT_FAILURE;
   }
 
@@ -87,7 +671,7 @@ int main(int argc, char **argv) {
     XY bottom_right = LonLatToXY(config->points[1]);
     x_length = bottom_right.x - offset.x + 1;
     y_length = bottom_right.y - offset.y + 1;
-    if (world_rank == 0) {
+    if (comm_rank == 0) {
       printf("Box ul: %zu, %zu\n", offset.x, offset.y);
       printf("Box br: %zu, %zu\n", bottom_right.x, bottom_right.y);
       printf("Box size: %d, %d\n", x_length, y_length);
@@ -98,209 +682,914 @@ int main(int argc, char **argv) {
   // TODO: Enable world_sizes to split into hyperslabs and run from there.
   Hyperslab *slabs = AllocateHyperslabs(
       Position(0, offset.x, offset.y),
-      Edges(info[0].time_len, x_length, y_length), world_size, world_rank);
+      Edges(info[0].time_len, x_length, y_length), node.num_nodes,
+      node.node_index);
 
-  Hyperslab h = slabs[world_rank];
+  Hyperslab h = slabs[node.node_index];
+  Hyperslab extent = CreateHyperslab(
+      Position(0, offset.x, offset.y),
+      Edges(info[0].time_len, x_length, y_length));
 
   int app_status = EXIT_SUCCESS;
-  float *values =
-      (float *)malloc(sizeof(float) * config->num_mappings * h.flat_size);
-  float *converted_values =
-      (float *)malloc(sizeof(float) * config->num_mappings * h.flat_size);
-
-  InitUnitSystem();
   ConverterContainer converters[config->num_mappings];
   for (size_t i = 0; i < config->num_mappings; ++i) {
-    if (BuildConverter(config->mappings[i].source_unit,
-                       config->mappings[i].target_unit, &converters[i])) {
-      fprintf(stderr, "error: unable to build the converter for %s -> %s\n",
-              config->mappings[i].source_unit, config->mappings[i].target_unit);
-      app_status = EXIT_FAILURE;
-      goto release_resources;
+    converters[i].cv = NULL;
+    converters[i].have_unit = NULL;
+    converters[i].want_unit = NULL;
+    converters[i].affine = 0;
+    converters[i].packed = 0;
+  }
+  float fill_values[config->num_mappings];
+  for (size_t i = 0; i < config->num_mappings; ++i) {
+    fill_values[i] = info[i].fill_value;
+  }
+  CellKernels kernels;
+  const float *converted_ptrs[config->num_mappings];
+  const float *cached_ptrs[PREFETCH_SLOTS][config->num_mappings];
+  SlabCacheEntry cache_entries[PREFETCH_SLOTS][config->num_mappings];
+  for (size_t s = 0; s < PREFETCH_SLOTS; ++s) {
+    for (size_t i = 0; i < config->num_mappings; ++i) {
+      cache_entries[s][i].map = NULL;
     }
   }
-  printf("[%d] Checkpoint in seconds: %zu\n", world_rank,
-         time(NULL) - start_time);
-  printf("Starting allocation and fetching data\n");
-  for (size_t m = 0; m < config->num_mappings; ++m) {
-    if ((status = nc_get_vara_float(config->mappings[m].netcdf_id,
-                                    info[m].var_varid, h.corner.shape,
-                                    h.edges.shape, &values[m * h.flat_size]))) {
+  float *values[PREFETCH_SLOTS] = {NULL};
+  float *converted_values = NULL;
+  int16_t *quantized[PREFETCH_SLOTS] = {NULL};
+  int32_t offsets[PREFETCH_SLOTS][config->num_mappings];
+  double *tile_tav = NULL;
+  float *tile_amp = NULL;
+  size_t regions[config->num_mappings];
+  size_t num_regions = floatRegions(config, regions);
+  size_t tile_clamped = 0;
+  Manifest manifest;
+  InitManifest(&manifest, config->manifest_format);
+  SummaryGrid summary_grid = {.tav = NULL, .amp = NULL, .rain = NULL,
+                              .missing_days = NULL};
+  Prefetcher prefetcher;
+  OutputWriter *writer = NULL;
+  int prefetcher_started = 0;
+  Admission admission;
+  int admission_started = 0;
+  Progress progress;
+  int progress_started = 0;
+  // Reading ahead keeps a second raw tile, a third buffer per mapping. A
+  // quantized tile needs two bytes per mapping and its float regions.
+  size_t num_buffers = config->prefetch ? 3 : 2;
+  size_t value_bytes = TileValueBytes(config, num_regions);
+
+  size_t num_tiles = 1;
+  Hyperslab *tiles = NULL;
+  // The chunk caches only fill during the first read, so they are added to
+  // the current RSS as memory the slab buffers have to fit next to.
+  size_t baseline_rss = CurrentRssBytes();
+  for (size_t i = 0; i < config->num_mappings; ++i) {
+    baseline_rss += info[i].chunk_cache_size;
+  }
+  // The ranks of a node pool their budgets for the tile they share, and all
+  // of them derive the same sub-tiles from the sums.
+  size_t budget = config->max_memory_per_rank;
+  if (config->node_shared) {
+    uint64_t node_rss = baseline_rss;
+    MPI_Allreduce(MPI_IN_PLACE, &node_rss, 1, MPI_UINT64_T, MPI_SUM,
+                  node.node_comm);
+    baseline_rss = node_rss;
+    budget *= node.node_size;
+  }
+  // The largest baseline of all ranks, so that all of them agree on whether
+  // the budget leaves room for the slab
+  uint64_t max_rss = baseline_rss;
+  MPI_Allreduce(MPI_IN_PLACE, &max_rss, 1, MPI_UINT64_T, MPI_MAX, mpi_comm);
+  baseline_rss = max_rss;
+  if (run->tiles != NULL && sameSlab(run->slab, h) &&
+      run->num_mappings == config->num_mappings &&
+      run->max_memory_per_rank == config->max_memory_per_rank &&
+      run->node_size == node.node_size &&
+      run->read_strategy == config->read_strategy &&
+      run->value_bytes == value_bytes) {
+    tiles = run->tiles;
+    num_tiles = run->num_tiles;
+  } else if (config->max_memory_per_rank > 0 &&
+             config->read_strategy == read_tiles) {
+    if (baseline_rss >= budget) {
       fprintf(stderr,
-              "error: unable to extract values from %s for variable "
-              "%s.\n\t%s\n\tCorner: %d, %d, %d\n\tEdges: %d, %d, %d\n",
-              config->mappings[m].file_name, config->mappings->netcdf_var,
-              nc_strerror(status), h.corner.day, h.corner.x, h.corner.y,
-              h.edges.days, h.edges.x_length, h.edges.y_length);
-      app_status = EXIT_FAILURE;
-      goto release_resources;
+              "error: [%d] max_memory_per_rank (%zu bytes) is already used "
+              "by the process and chunk caches (%zu bytes)\n",
+              world_rank, budget, baseline_rss);
+    } else {
+      tiles = SubdivideHyperslab(
+          h, config->num_mappings,
+          SubdivisionBudget(config, budget, baseline_rss, value_bytes),
+          &num_tiles);
+    }
+  } else {
+    tiles = (Hyperslab *)malloc(sizeof(Hyperslab));
+    if (tiles != NULL) {
+      tiles[0] = h;
     }
   }
-  printf("Ending allocation and fetching data\n");
-  printf("[%d] Checkpoint in seconds: %zu\n", world_rank,
-         time(NULL) - start_time);
+  // A failure during the setup is only recorded, so that every rank still
+  // takes part in its collective steps, and all of them stop together
+  // before the tiles.
+  if (tiles == NULL) {
+    app_status = EXIT_FAILURE;
+  }
+  if (config->summary != NULL && InitSummaryGrid(&summary_grid, h)) {
+    app_status = EXIT_FAILURE;
+  }
+  if (tiles != NULL && tiles != run->tiles) {
+    free(run->tiles);
+    run->tiles = tiles;
+    run->num_tiles = num_tiles;
+    run->slab = h;
+    run->num_mappings = config->num_mappings;
+    run->max_memory_per_rank = config->max_memory_per_rank;
+    run->node_size = node.node_size;
+    run->read_strategy = config->read_strategy;
+    run->value_bytes = value_bytes;
+  }
+  size_t tile_capacity = 0;
+  HyperslabEdges largest_tile = Edges(0, 0, 0);
+  for (size_t t = 0; tiles != NULL && t < num_tiles; ++t) {
+    if (tiles[t].flat_size > tile_capacity) {
+      tile_capacity = tiles[t].flat_size;
+      largest_tile = tiles[t].edges;
+    }
+  }
+  size_t slab_bytes = largest_tile.days * largest_tile.x_length *
+                      largest_tile.y_length * value_bytes;
+  if (tiles != NULL) {
+    printf("[%d] Sub-tiles: %zu of up to %zux%zu cells over %zu days, "
+           "predicted peak RSS: %.1f MiB%s\n",
+           world_rank, num_tiles, largest_tile.x_length,
+           largest_tile.y_length, largest_tile.days,
+           (baseline_rss + slab_bytes) / 1048576.0,
+           config->node_shared ? " for the node" : "");
+  }
+
+  // Allocating the node buffer is collective
+  if (config->node_shared) {
+    if (AllocateNodeBuffer(&node,
+                           2 * config->num_mappings * tile_capacity) == 0) {
+      values[0] = node.values;
+      converted_values = &node.values[config->num_mappings * tile_capacity];
+    }
+  } else if (app_status != EXIT_SUCCESS) {
+    // Nothing to allocate for
+  } else if (config->quantize) {
+    for (size_t s = 0; s < num_buffers - 1; ++s) {
+      values[s] = (float *)malloc(sizeof(float) * num_regions * tile_capacity);
+      quantized[s] = (int16_t *)malloc(sizeof(int16_t) *
+                                       config->num_mappings * tile_capacity);
+    }
+    size_t tile_cells = largest_tile.x_length * largest_tile.y_length;
+    tile_tav = (double *)malloc(sizeof(double) * tile_cells);
+    tile_amp = (float *)malloc(sizeof(float) * tile_cells);
+  } else {
+    for (size_t s = 0; s < num_buffers - 1; ++s) {
+      values[s] = (float *)malloc(sizeof(float) * config->num_mappings *
+                                  tile_capacity);
+    }
+    converted_values =
+        (float *)malloc(sizeof(float) * config->num_mappings * tile_capacity);
+  }
+  if (app_status == EXIT_SUCCESS &&
+      (values[0] == NULL || (config->prefetch && values[1] == NULL) ||
+       (config->quantize
+            ? quantized[0] == NULL ||
+                  (config->prefetch && quantized[1] == NULL) ||
+                  tile_tav == NULL || tile_amp == NULL
+            : converted_values == NULL))) {
+    fprintf(stderr, "error: [%d] unable to allocate %zu bytes for the slab\n",
+            world_rank, slab_bytes);
+    app_status = EXIT_FAILURE;
+  }
+
+  // Broadcasting the converters is collective
+  double converters_start = PerfWallTime();
+  if (buildConverters(config, converters, mpi_comm, run)) {
+    app_status = EXIT_FAILURE;
+  } else {
+    // Packed values are unpacked by the conversion, in the same pass
+    for (size_t i = 0; i < config->num_mappings; ++i) {
+      if (info[i].packed) {
+        PackConverter(&converters[i], info[i].scale_factor,
+                      info[i].add_offset);
+        if (comm_rank == 0) {
+          printf("Unpacking %s%s with scale %g and offset %g in its "
+                 "conversion\n",
+                 config->mappings[i].netcdf_var,
+                 info[i].native_short ? " from shorts" : "",
+                 info[i].scale_factor, info[i].add_offset);
+        }
+      }
+    }
+    SelectCellKernels(config, converters, fill_values, &kernels);
+    printf("[%d] Startup: config %.3f s, open %.3f s, metadata %.3f s, "
+           "units %.3f s%s\n",
+           world_rank, run->config_seconds, metadata_start - open_start,
+           metadata_end - metadata_start,
+           run->unit_system_seconds + PerfWallTime() - converters_start,
+           run->broadcast ? " (broadcast from the root)" : "");
+  }
 
-  size_t counter = 0;
-  size_t skipped = 0;
-  char date_str[ISODATE_STRING_LEN];
   char start_date_str[ISODATE_STRING_LEN];
   status = snprintf(start_date_str, ISODATE_STRING_LEN, "%d-01-01",
                     config->start_year);
   if (status >= ISODATE_STRING_LEN) {
     fprintf(stderr, "error: year string is weirdly too long.\n");
     app_status = EXIT_FAILURE;
-    goto release_resources;
+  } else if (run->dates.dssat == NULL ||
+             run->start_year != config->start_year ||
+             run->dates.days != info[0].time_len) {
+    FreeDateTable(&run->dates);
+    if (BuildDateTable(start_date_str, info[0].time_len, &run->dates)) {
+      app_status = EXIT_FAILURE;
+    } else {
+      run->start_year = config->start_year;
+    }
   }
+  printf("[%d] Checkpoint in seconds: %zu\n", world_rank,
+         time(NULL) - start_time);
+  EndPhase(NULL, &phase);
+  PrintPhaseSample(world_rank, &phase);
 
-  date_t date;
-  status = ParseDate(start_date_str, &date);
-  if (status) {
-    app_status = EXIT_FAILURE;
+
+  PhaseSample read_phase;
+  PhaseSample convert_phase;
+  PhaseSample process_phase;
+  PhaseSample cache_phase;
+  BeginPhase(NULL, &read_phase, config->prefetch ? "read wait" : "read");
+  BeginPhase(NULL, &convert_phase, "convert");
+  BeginPhase(NULL, &process_phase, "process");
+  BeginPhase(NULL, &cache_phase, "cache");
+  RecordCounts records = {
+      .written = 0, .skipped = 0, .files = 0, .text_bytes = 0};
+  TileContext context = {.config = config,
+                         .info = info,
+                         .tiles = tiles,
+                         .converters = converters,
+                         .regions = regions,
+                         .extent = extent,
+                         .slabs = slabs,
+                         .mpi_comm = mpi_comm,
+                         .transpose = {.read_seconds = 0.0,
+                                       .exchange_seconds = 0.0,
+                                       .bytes_read = 0,
+                                       .bytes_sent = 0},
+                         .reads = node.node_rank == 0,
+                         .cache_hits = 0,
+                         .cache_misses = 0,
+                         .clamped = 0};
+  for (size_t s = 0; s < PREFETCH_SLOTS; ++s) {
+    context.values[s] = values[s];
+    context.quantized[s] = quantized[s];
+    context.offsets[s] = offsets[s];
+    context.cache_entries[s] = cache_entries[s];
+    context.cached_ptrs[s] = cached_ptrs[s];
+  }
+  // The file creation slots are shared by the ranks of each node, and set
+  // up collectively
+  if (config->max_file_creates > 0 || config->max_file_creates_per_node > 0) {
+    if (InitAdmission(&admission, mpi_comm, config->max_file_creates,
+                      config->max_file_creates_per_node)) {
+      app_status = EXIT_FAILURE;
+    } else {
+      admission_started = 1;
+    }
+  }
+  if (app_status == EXIT_SUCCESS && config->compression_level > 0) {
+    writer = OpenOutputWriter(config->compression_level,
+                              config->compress_threads,
+                              admission_started ? &admission : NULL);
+    if (writer == NULL) {
+      fprintf(stderr, "error: [%d] unable to start the output writer\n",
+              world_rank);
+      app_status = EXIT_FAILURE;
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &app_status, 1, MPI_INT, MPI_MAX, mpi_comm);
+  if (app_status != EXIT_SUCCESS) {
     goto release_resources;
   }
-
-  int current_month = date.month;
-  size_t months = 1;
-  float daily_avg[31];
-  double monthly_sum = 0.0;
-  float tminavg = -99.9f;
-  float tmaxavg = -99.9f;
-  float tmin = -99.9f;
-  float tmax = -99.9f;
-  float mavg;
-  float davg;
-  float raw_value;
-  float value;
-  size_t index;
-
-  resetDailyAvg(daily_avg);
-
-  printf("[%d] Checkpoint in seconds: %zu\n", world_rank,
-         time(NULL) - start_time);
   printf("Starting I/O\n");
-
-  char debug_file[15];
-  snprintf(debug_file, 15, "debug_%d.csv", world_rank);
-  FILE *debug = fopen(debug_file, "w");
-  fprintf(debug, "longitude,latitude,ID\n");
-  for (size_t x = 0; x < h.edges.x_length; ++x) {
-    for (size_t y = 0; y < h.edges.y_length; ++y) {
-      ParseDate(start_date_str, &date);
-      for (size_t d = 0; d < h.edges.days; ++d) {
-        for (size_t m = 0; m < config->num_mappings; ++m) {
-          index = (m * h.flat_size) + HyperslabValueIndex(h, Position(d, x, y));
-          raw_value = values[index];
-          if (raw_value == info[m].fill_value) {
-            value = raw_value;
-            if (d == 0) {
-              ++skipped;
-              goto skip_entry;
-            }
-          } else {
-            value = ConvertValue(converters[m].cv, raw_value);
-          }
-          converted_values[index] = value;
-          if (config->mappings[m].is_temp == 1) {
-            tmin = value;
-          } else if (config->mappings[m].is_temp == 2) {
-            tmax = value;
-          }
-        }
-        if (tmax != 99.9f && tmin != 99.9f) {
-          davg = (tmax + tmin) / 2.0f;
-          daily_avg[date.day_of_month - 1] = davg;
-        }
-        counter++;
-        AddOneDay(&date);
-        if (current_month != date.month) {
-          mavg = calculateMonthlyAvg(daily_avg);
-          if (tminavg == -99.9f) {
-            tminavg = mavg;
-          }
-          if (tmaxavg == -99.9f) {
-            tmaxavg = mavg;
-          }
-          if (tminavg > mavg) {
-            tminavg = mavg;
-          }
-          if (tmaxavg < mavg) {
-            tmaxavg = mavg;
-          }
-          monthly_sum += mavg;
-          ++months;
-          current_month = date.month;
-          resetDailyAvg(daily_avg);
-        }
+  // The cells of the slab this rank extracts, as processTile picks them
+  size_t rank_cells = 0;
+  for (size_t t = 0; t < num_tiles; ++t) {
+    size_t tile_cells = tiles[t].edges.x_length * tiles[t].edges.y_length;
+    rank_cells += tile_cells / node.node_size +
+                  ((size_t)node.node_rank < tile_cells % node.node_size);
+  }
+  progress_started = !StartProgress(&progress, config, mpi_comm, rank_cells);
+  Progress *live = progress_started ? &progress : NULL;
+  StartPrefetcher(&prefetcher, num_tiles, readTile, adviseTile, &context,
+                  config->prefetch);
+  prefetcher_started = 1;
+  for (size_t t = 0; t < num_tiles; ++t) {
+    size_t slot;
+    BeginPhase(&counters, &phase, read_phase.name);
+    SetProgressPhase(live, "read");
+    status = WaitForTile(&prefetcher, t, &slot);
+    if (config->node_shared) {
+      status = SyncNodeBuffer(&node, status);
+    }
+    if (status) {
+      app_status = EXIT_FAILURE;
+      break;
+    }
+    EndPhase(&counters, &phase);
+    AccumulatePhase(&read_phase, &phase);
+    BeginPhase(&counters, &phase, "convert");
+    SetProgressPhase(live, "convert");
+    TileValues tile_values = {.converted_ptrs = converted_ptrs,
+                              .quantized = NULL,
+                              .offsets = NULL,
+                              .tav = NULL,
+                              .amp = NULL};
+    if (config->quantize) {
+      tile_clamped += quantizeTile(config, info, &run->dates, tiles[t],
+                                   regions, values[slot], quantized[slot],
+                                   offsets[slot], tile_tav, tile_amp, &status);
+      tile_values.quantized = quantized[slot];
+      tile_values.offsets = offsets[slot];
+      tile_values.tav = tile_tav;
+      tile_values.amp = tile_amp;
+    } else {
+      for (size_t m = 0; m < config->num_mappings; ++m) {
+        converted_ptrs[m] = cached_ptrs[slot][m];
       }
-      XY global_pos = XYPosition(h.corner.x + x, h.corner.y + y);
-      LonLat global_ll = XYToLonLat(global_pos);
-      // Now we write out the file
-      fprintf(debug, "%.2f,%.2f,%zu\n", global_ll.longitude, global_ll.latitude,
-              XYToGlobalId(global_pos));
-      char filename[2048];
-      GenerateFileName(global_pos, config->output_dir, filename);
-      FILE *fh = fopen(filename, "w");
-      if (fh != NULL) {
-        fprintf(fh, "*WEATHER DATA: GGCMI\n\n");
-        fprintf(fh, "@ INSI      LAT     LONG  ELEV   TAV   AMP REFHT WNDHT\n");
-        fprintf(fh, " GGCMI %8.2f %8.2f %5d %5.1f %5.1f\n", global_ll.latitude,
-                global_ll.longitude, -99, (monthly_sum / months),
-                tmaxavg - tminavg);
-        fprintf(fh, "@DATE");
-        for (size_t i = 0; i < config->num_mappings; ++i) {
-          fprintf(fh, "  %4s", config->mappings[i].dssat_var);
-        }
-        fprintf(fh, "\n");
-        ParseDate(start_date_str, &date);
-        for (size_t d = 0; d < h.edges.days; ++d) {
-          DateAsDSSAT2String(&date, date_str);
-          fprintf(fh, "%s", date_str);
-          for (size_t m = 0; m < config->num_mappings; ++m) {
-            index =
-                (m * h.flat_size) + HyperslabValueIndex(h, Position(d, x, y));
-            fprintf(fh, " %5.1f", converted_values[index]);
-          }
-          AddOneDay(&date);
-          fprintf(fh, "\n");
+      size_t first = 0;
+      size_t count = tiles[t].flat_size;
+      if (config->node_shared) {
+        NodeShare(tiles[t].flat_size, node.node_rank, node.node_size, &first,
+                  &count);
+      }
+      status = convertTile(config, info, converters, &kernels, tiles[t],
+                           values[slot], converted_values, converted_ptrs,
+                           first, count);
+      if (config->node_shared) {
+        status = SyncNodeBuffer(&node, status);
+      }
+    }
+    // Transposed reads agree on their own failures, but the next one needs
+    // every rank, so a failed conversion has to stop all of them too
+    if (config->read_strategy != read_tiles) {
+      MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MAX, mpi_comm);
+    }
+    if (status) {
+      app_status = EXIT_FAILURE;
+      break;
+    }
+    EndPhase(&counters, &phase);
+    AccumulatePhase(&convert_phase, &phase);
+    if (config->cache_dir != NULL && !config->quantize) {
+      BeginPhase(&counters, &phase, "cache");
+      SetProgressPhase(live, "cache");
+      for (size_t m = 0; m < config->num_mappings; ++m) {
+        if (config->mappings[m].derived == NULL &&
+            cache_entries[slot][m].map == NULL) {
+          StoreSlabCacheEntry(config->cache_dir, &config->mappings[m],
+                              tiles[t], converted_ptrs[m]);
         }
-        fclose(fh);
-      } else {
-        fprintf(stderr, "error: could not open file for writing: %s\n",
-                filename);
       }
-    skip_entry:
-      monthly_sum = 0.0;
-      tminavg = -99.9f;
-      tmaxavg = -99.9f;
-      tmin = -99.9f;
-      tmax = -99.9f;
-      mavg = -99.9f;
-      months = 1;
-      resetDailyAvg(daily_avg);
-    }
-  }
-  fclose(debug);
-  printf("Records written: %zu\n", counter);
+      EndPhase(&counters, &phase);
+      AccumulatePhase(&cache_phase, &phase);
+    }
+    BeginPhase(&counters, &phase, "process");
+    SetProgressPhase(live, "process");
+    processTile(config, info, &kernels, tiles[t], &tile_values, &run->dates,
+                node.node_size, node.node_rank,
+                config->manifest != NULL ? &manifest : NULL,
+                config->summary != NULL ? &summary_grid : NULL, writer,
+                admission_started ? &admission : NULL, live, &records);
+    EndPhase(&counters, &phase);
+    AccumulatePhase(&process_phase, &phase);
+    for (size_t m = 0; m < config->num_mappings; ++m) {
+      CloseSlabCacheEntry(&cache_entries[slot][m]);
+    }
+    ReleaseTile(&prefetcher, t);
+    // The leader reads the next tile over this one once every rank is done
+    if (config->node_shared) {
+      SyncNodeBuffer(&node, 0);
+    }
+  }
+  StopPrefetcher(&prefetcher);
+  prefetcher_started = 0;
+  // A rank which left the tiles early has to stop the others before the
+  // collectives below, which then are skipped by all of them
+  MPI_Allreduce(MPI_IN_PLACE, &app_status, 1, MPI_INT, MPI_MAX, mpi_comm);
+  if (app_status != EXIT_SUCCESS) {
+    goto release_resources;
+  }
+  // Draining the compression queue is part of writing the output
+  OutputStats output = {.files = records.files,
+                        .failures = 0,
+                        .text_bytes = records.text_bytes,
+                        .written_bytes = records.text_bytes,
+                        .compress_seconds = 0.0};
+  if (writer != NULL) {
+    BeginPhase(&counters, &phase, "process");
+    CloseOutputWriter(writer, &output);
+    writer = NULL;
+    EndPhase(&counters, &phase);
+    AccumulatePhase(&process_phase, &phase);
+    if (output.failures > 0) {
+      app_status = EXIT_FAILURE;
+    }
+  }
+  if (admission_started) {
+    ReportAdmission(&admission, world_rank, mpi_comm);
+  }
+  // The manifest is written once, by all ranks of the run together
+  PhaseSample manifest_phase;
+  if (config->manifest != NULL) {
+    BeginPhase(&counters, &manifest_phase, "manifest");
+    SetProgressPhase(live, "manifest");
+    if (WriteManifest(&manifest, config->manifest, mpi_comm)) {
+      app_status = EXIT_FAILURE;
+    }
+    EndPhase(&counters, &manifest_phase);
+  }
+  // So is the summary, on the grid of the first file read
+  PhaseSample summary_phase;
+  if (config->summary != NULL) {
+    size_t first_file = 0;
+    while (config->mappings[first_file].derived != NULL) {
+      ++first_file;
+    }
+    BeginPhase(&counters, &summary_phase, "summary");
+    SetProgressPhase(live, "summary");
+    if (WriteSummaryGrid(&summary_grid, config->summary,
+                         &config->mappings[first_file], &info[first_file],
+                         mpi_comm, node.node_comm)) {
+      app_status = EXIT_FAILURE;
+    }
+    EndPhase(&counters, &summary_phase);
+  }
+  if (progress_started) {
+    StopProgress(&progress);
+    progress_started = 0;
+  }
+  PrintPhaseSample(world_rank, &read_phase);
+  if (config->read_strategy != read_tiles) {
+    printf("[%d] Transposed reads by %s: read %.3f s, exchange %.3f s, "
+           "%.1f MiB read, %.1f MiB sent to other ranks\n",
+           world_rank,
+           config->read_strategy == read_by_time ? "time" : "variable",
+           context.transpose.read_seconds, context.transpose.exchange_seconds,
+           context.transpose.bytes_read / 1048576.0,
+           context.transpose.bytes_sent / 1048576.0);
+  }
+  if (config->prefetch) {
+    printf("[%d] Prefetch: read %.3f s, hidden %.3f s, exposed %.3f s, "
+           "overlap %.1f%%\n",
+           world_rank, prefetcher.read_seconds,
+           prefetcher.read_seconds * PrefetchOverlap(&prefetcher),
+           prefetcher.wait_seconds, 100.0 * PrefetchOverlap(&prefetcher));
+  }
+  PrintPhaseSample(world_rank, &convert_phase);
+  printf("[%d] Kernels: convert %s, gather %s\n", world_rank,
+         kernels.convert_name, kernels.gather_name);
+  if (config->node_shared) {
+    printf("[%d] Node shared: rank %d of %d on node %d of %d, %.1f MiB "
+           "shared by the node%s\n",
+           world_rank, node.node_rank, node.node_size, node.node_index,
+           node.num_nodes,
+           node.capacity * sizeof(float) / 1048576.0,
+           node.node_rank == 0 ? ", reading" : "");
+  }
+  if (config->quantize) {
+    printf("[%d] Quantized: %.1f MiB of int16 tenths, %zu values clamped\n",
+           world_rank,
+           (num_buffers - 1) * config->num_mappings * tile_capacity *
+               sizeof(int16_t) / 1048576.0,
+           context.clamped + tile_clamped);
+  }
+  if (config->cache_dir != NULL) {
+    PrintPhaseSample(world_rank, &cache_phase);
+    printf("[%d] Slab cache: %zu hits, %zu misses\n", world_rank,
+           context.cache_hits, context.cache_misses);
+  }
+  PrintPhaseSample(world_rank, &process_phase);
+  if (config->manifest != NULL) {
+    PrintPhaseSample(world_rank, &manifest_phase);
+  }
+  if (config->summary != NULL) {
+    PrintPhaseSample(world_rank, &summary_phase);
+  }
+  printf("[%d] Output: %zu files, %.1f MiB rendered, %.1f MiB written, "
+         "%.1f MiB/s",
+         world_rank, output.files, output.text_bytes / 1048576.0,
+         output.written_bytes / 1048576.0,
+         process_phase.seconds > 0.0
+             ? output.text_bytes / 1048576.0 / process_phase.seconds
+             : 0.0);
+  if (config->compression_level > 0) {
+    printf(", gzip level %d on %zu threads, %.3f s compressing, ratio %.1fx",
+           config->compression_level, config->compress_threads,
+           output.compress_seconds,
+           output.written_bytes > 0
+               ? (double)output.text_bytes / output.written_bytes
+               : 0.0);
+  }
+  printf("\n");
+  printf("Records written: %zu\n", records.written);
   printf("Records expected: %zu\n", h.flat_size);
-  printf("Records skipped: %zu\n", skipped * h.edges.days);
+  printf("Records skipped: %zu\n", records.skipped * h.edges.days);
   printf("Ending I/O\n");
+  printf("[%d] Peak RSS: %.1f MiB\n", world_rank, PeakRssBytes() / 1048576.0);
   printf("[%d] Checkpoint in seconds: %zu\n", world_rank,
          time(NULL) - start_time);
 release_resources:
+  if (prefetcher_started) {
+    StopPrefetcher(&prefetcher);
+  }
+  CloseOutputWriter(writer, NULL);
+  if (admission_started) {
+    FreeAdmission(&admission);
+  }
+  if (progress_started) {
+    StopProgress(&progress);
+  }
+  FreeManifest(&manifest);
+  FreeSummaryGrid(&summary_grid);
   for (size_t i = 0; i < config->num_mappings; ++i) {
-    printf("Releasing resources for %s\n", config->mappings[i].file_name);
+    if (config->mappings[i].derived == NULL) {
+      printf("Releasing resources for %s\n", config->mappings[i].file_name);
+    }
     FreeConverterContainer(&converters[i]);
+    for (size_t s = 0; s < PREFETCH_SLOTS; ++s) {
+      CloseSlabCacheEntry(&cache_entries[s][i]);
+    }
   }
-  FreeUnitSystem();
+  FreePerfCounters(&counters);
   free(slabs);
   slabs = NULL;
+  if (config->node_shared) {
+    values[0] = NULL;
+    converted_values = NULL;
+  }
+  FreeNodeBuffer(&node);
   free(converted_values);
   converted_values = NULL;
-  free(values);
-  values = NULL;
+  for (size_t s = 0; s < PREFETCH_SLOTS; ++s) {
+    free(values[s]);
+    values[s] = NULL;
+    free(quantized[s]);
+    quantized[s] = NULL;
+  }
+  free(tile_tav);
+  free(tile_amp);
+  CloseAllDataFiles(config, info);
+  return app_status;
+}
+
+// Loads a single configuration or the scenarios of a batch, from a file or
+// from the text of one.
+static Config **loadConfigs(const char *file_name, const char *text,
+                            int batch, int check_paths, size_t *num_configs) {
+  if (batch) {
+    return file_name != NULL
+               ? LoadBatchConfig(file_name, num_configs)
+               : LoadBatchConfigText(text, check_paths, num_configs);
+  }
+  Config **configs = (Config **)malloc(sizeof(Config *));
+  if (configs == NULL) {
+    return NULL;
+  }
+  configs[0] = file_name != NULL ? LoadConfig(file_name)
+                                 : LoadConfigText(text, check_paths);
+  if (configs[0] == NULL) {
+    free(configs);
+    return NULL;
+  }
+  *num_configs = 1;
+  return configs;
+}
+
+// Prints what extracting a configuration on ranks processes would take,
+// from the metadata of its files and the land mask alone, and the ranks per
+// node that fit node_memory. Without ranks the plan is for the advised ones.
+static int planScenario(Config *config, size_t node_memory,
+                        const char *land_mask, size_t ranks) {
+  if (config->mode == 2) {
+    fprintf(stderr, "error: --plan covers extents, not points\n");
+    return EXIT_FAILURE;
+  }
+  NetCdfInfo info[config->num_mappings];
+  for (size_t i = 0; i < config->num_mappings; ++i) {
+    info[i].unit = NULL;
+    info[i].chunk_reader = NULL;
+    info[i].parts = NULL;
+    info[i].num_parts = 0;
+    info[i].members = NULL;
+    info[i].num_members = 0;
+  }
+  if (OpenAllDataFiles(config, MPI_COMM_SELF, MPI_INFO_NULL) !=
+          config->num_mappings ||
+      InjectNetCdfInfo(config, info)) {
+    CloseAllDataFiles(config, info);
+    return EXIT_FAILURE;
+  }
+  int status = EXIT_SUCCESS;
+  PlanInput inputs[config->num_mappings];
+  for (size_t i = 0; i < config->num_mappings; ++i) {
+    if (InspectPlanInput(&config->mappings[i], &info[i], &inputs[i])) {
+      status = EXIT_FAILURE;
+    }
+  }
+  size_t longitude_len = info[0].longitude_len;
+  unsigned char *mask = NULL;
+  if (status == EXIT_SUCCESS && land_mask != NULL) {
+    mask = ReadLandMask(land_mask, longitude_len, info[0].latitude_len);
+    if (mask == NULL) {
+      status = EXIT_FAILURE;
+    }
+  }
+  XY offset = LonLatToXY(config->points[0]);
+  XY bottom_right = LonLatToXY(config->points[1]);
+  Hyperslab extent = CreateHyperslab(
+      Position(0, offset.x, offset.y),
+      Edges(info[0].time_len, bottom_right.x - offset.x + 1,
+            bottom_right.y - offset.y + 1));
+  size_t regions[config->num_mappings];
+  size_t value_bytes = TileValueBytes(config, floatRegions(config, regions));
+  size_t baseline_rss = CurrentRssBytes();
+  for (size_t i = 0; i < config->num_mappings; ++i) {
+    baseline_rss += info[i].chunk_cache_size;
+  }
+  long online_cores = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t cores = online_cores > 0 ? (size_t)online_cores : 1;
+  PlanAdvice advice;
+  if (status == EXIT_SUCCESS &&
+      AdviseRanks(extent, value_bytes, baseline_rss, node_memory, cores,
+                  &advice)) {
+    status = EXIT_FAILURE;
+  }
+  Hyperslab *slabs = NULL;
+  if (status == EXIT_SUCCESS) {
+    if (ranks == 0) {
+      ranks = advice.ranks_per_node;
+    }
+    slabs = AllocateHyperslabs(extent.corner, extent.edges, ranks, 0);
+    if (slabs == NULL) {
+      status = EXIT_FAILURE;
+    }
+  }
+  if (status != EXIT_SUCCESS) {
+    free(mask);
+    CloseAllDataFiles(config, info);
+    return status;
+  }
+
+  printf("Plan: %zux%zu cells over %zu days, %zu mappings, on %zu ranks\n",
+         extent.edges.x_length, extent.edges.y_length, extent.edges.days,
+         config->num_mappings, ranks);
+  for (size_t i = 0; i < config->num_mappings; ++i) {
+    if (config->mappings[i].derived != NULL) {
+      printf("  %s: derived, no reads\n", config->mappings[i].dssat_var);
+    } else if (inputs[i].chunked) {
+      printf("  %s: chunks of %zu days x %zu x %zu cells, %.1f KiB each on "
+             "disk\n",
+             config->mappings[i].netcdf_var, inputs[i].chunk_days,
+             inputs[i].chunk_y, inputs[i].chunk_x,
+             inputs[i].chunk_bytes / 1024.0);
+    } else {
+      printf("  %s: contiguous\n", config->mappings[i].netcdf_var);
+    }
+  }
+  if (config->read_strategy != read_tiles || config->node_shared) {
+    printf("  (planned as if every rank read its own slab)\n");
+  }
+  printf("%6s %-17s %9s %9s %6s %10s %9s %10s\n", "rank", "slab", "cells",
+         "files", "tiles", "peak MiB", "chunks", "read MiB");
+  size_t total_files = 0;
+  size_t total_chunks = 0;
+  double total_read_bytes = 0.0;
+  size_t largest_peak = 0;
+  for (size_t r = 0; r < ranks; ++r) {
+    RankPlan plan;
+    if (PlanRank(config, inputs, mask, longitude_len, slabs[r], value_bytes,
+                 baseline_rss, &plan)) {
+      status = EXIT_FAILURE;
+      break;
+    }
+    char slab[48];
+    snprintf(slab, sizeof(slab), "%zu,%zu+%zux%zu", plan.slab.corner.x,
+             plan.slab.corner.y, plan.slab.edges.x_length,
+             plan.slab.edges.y_length);
+    printf("%6zu %-17s %9zu %9zu %6zu %10.1f %9zu %10.1f\n", r, slab,
+           plan.cells, plan.files, plan.tiles, plan.peak_bytes / 1048576.0,
+           plan.chunks, plan.read_bytes / 1048576.0);
+    total_files += plan.files;
+    total_chunks += plan.chunks;
+    total_read_bytes += plan.read_bytes;
+    if (plan.peak_bytes > largest_peak) {
+      largest_peak = plan.peak_bytes;
+    }
+  }
+  if (status == EXIT_SUCCESS) {
+    printf("Total: %zu files to create, %zu chunks touched, %.1f MiB read, "
+           "peak %.1f MiB per rank\n",
+           total_files, total_chunks, total_read_bytes / 1048576.0,
+           largest_peak / 1048576.0);
+    printf("Advice for %.1f GiB per node of %zu cores: %zu ranks per node "
+           "with %zu decompress_threads and compress_threads each",
+           node_memory / 1073741824.0, cores, advice.ranks_per_node,
+           advice.threads_per_rank);
+    if (advice.subdivided) {
+      printf(", max_memory_per_rank %zu", advice.max_memory_per_rank);
+    }
+    printf("\n");
+  }
+  free(slabs);
+  free(mask);
   CloseAllDataFiles(config, info);
-  FreeConfig(config);
-  config = NULL;
+  return status;
+}
+
+// Keeps the files of a single configuration open and answers queries for
+// cells until the server is stopped.
+static int serve(Config **configs, size_t num_configs, const char *socket_path,
+                 int world_size) {
+  if (num_configs != 1 || world_size != 1) {
+    fprintf(stderr, "error: --serve takes a single configuration on a single "
+                    "process\n");
+    return EXIT_FAILURE;
+  }
+  Dataset *dataset = OpenDataset(configs[0], 0, 0);
+  if (dataset == NULL) {
+    return EXIT_FAILURE;
+  }
+  int status = ServeDataset(dataset, configs[0], socket_path);
+  CloseDataset(dataset);
+  return status ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+  printf("== GGCMI to DSSAT Weather Extractor ==\n");
+  size_t start_time = time(NULL);
+  // --rechunk rewrites the input files into point-major stores and exits,
+  // --batch runs every scenario of a batch file in one job, --broadcast
+  // leaves the startup work to the root of each run and --serve answers
+  // queries on a socket instead of writing files. --plan prints what a run
+  // would take for a memory budget per node without reading any values.
+  int rechunk = 0;
+  int batch = 0;
+  int broadcast = 0;
+  const char *socket_path = NULL;
+  size_t plan_memory = 0;
+  size_t plan_ranks = 0;
+  const char *land_mask = NULL;
+  if (argc < 2) {
+    fprintf(stderr, "error: not enough arguments\n");
+    return EXIT_FAILURE;
+  }
+  for (int i = 1; i < argc - 1; ++i) {
+    if (strcmp(argv[i], "--rechunk") == 0) {
+      rechunk = 1;
+    } else if (strcmp(argv[i], "--batch") == 0) {
+      batch = 1;
+    } else if (strcmp(argv[i], "--broadcast") == 0) {
+      broadcast = 1;
+    } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc - 1) {
+      socket_path = argv[++i];
+    } else if (strcmp(argv[i], "--plan") == 0 && i + 1 < argc - 1 &&
+               ParseByteString(argv[i + 1], &plan_memory) &&
+               plan_memory > 0) {
+      ++i;
+    } else if (strcmp(argv[i], "--ranks") == 0 && i + 1 < argc - 1 &&
+               (plan_ranks = strtoul(argv[i + 1], NULL, 10)) > 0) {
+      ++i;
+    } else if (strcmp(argv[i], "--land-mask") == 0 && i + 1 < argc - 1) {
+      land_mask = argv[++i];
+    } else {
+      fprintf(stderr, "error: unknown option %s\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+  }
+  // The prefetch thread makes the MPI-IO calls of the reads while the main
+  // thread only computes, so serialized access is enough.
+  int thread_level;
+  MPI_Init_thread(NULL, NULL, MPI_THREAD_SERIALIZED, &thread_level);
+  int world_size;
+  int world_rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+  char *config_file = argv[argc - 1];
+  Config **configs = NULL;
+  size_t num_configs = 1;
+  printf("Loading config file: %s\n", config_file);
+  double config_start = PerfWallTime();
+  if (broadcast) {
+    // Only rank 0 reads the file and checks the directories, so all ranks
+    // have to agree on the outcome.
+    char *text = BroadcastConfigText(config_file, MPI_COMM_WORLD);
+    if (text != NULL) {
+      configs = loadConfigs(NULL, text, batch, world_rank == 0, &num_configs);
+      free(text);
+    }
+    int failed = configs == NULL;
+    MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (failed) {
+      FreeBatchConfig(configs, num_configs);
+      configs = NULL;
+    }
+  } else {
+    configs = loadConfigs(config_file, NULL, batch, 1, &num_configs);
+  }
+  if (configs == NULL) {
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+  double config_seconds = PerfWallTime() - config_start;
+  if (socket_path != NULL) {
+    int status = serve(configs, num_configs, socket_path, world_size);
+    FreeBatchConfig(configs, num_configs);
+    MPI_Finalize();
+    return status;
+  }
+  if (plan_memory > 0) {
+    int status = EXIT_SUCCESS;
+    for (size_t i = 0; world_rank == 0 && i < num_configs; ++i) {
+      if (batch) {
+        printf("Scenario %s\n", configs[i]->name);
+      }
+      if (planScenario(configs[i], plan_memory, land_mask, plan_ranks)) {
+        status = EXIT_FAILURE;
+      }
+    }
+    FreeBatchConfig(configs, num_configs);
+    MPI_Finalize();
+    return status;
+  }
+
+  // Rank 0 estimates the costs so every rank agrees on the plan.
+  double costs[num_configs];
+  double seconds[num_configs];
+  size_t scenario_group[num_configs];
+  int group_ranks[num_configs];
+  size_t num_groups = 1;
+  for (size_t i = 0; i < num_configs; ++i) {
+    costs[i] = world_rank == 0 ? EstimateScenarioCost(configs[i]) : 0.0;
+    seconds[i] = 0.0;
+  }
+  MPI_Bcast(costs, (int)num_configs, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+  if (PlanBatch(costs, num_configs, world_size, scenario_group, group_ranks,
+                &num_groups)) {
+    FreeBatchConfig(configs, num_configs);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+  size_t group = GroupOfRank(group_ranks, num_groups, world_rank);
+  MPI_Comm group_comm;
+  MPI_Comm_split(MPI_COMM_WORLD, (int)group, world_rank, &group_comm);
+
+  int app_status = EXIT_SUCCESS;
+  RunState run = {.rechunk = rechunk,
+                  .batch = batch,
+                  .broadcast = broadcast,
+                  .units_loaded = 0,
+                  .config_seconds = config_seconds,
+                  .unit_system_seconds = 0.0,
+                  .thread_level = thread_level,
+                  .start_time = start_time,
+                  .start_year = 0,
+                  .dates = {.days = 0, .dssat = NULL},
+                  .tiles = NULL,
+                  .num_tiles = 0};
+  for (size_t i = 0; i < num_configs; ++i) {
+    if (scenario_group[i] != group) {
+      continue;
+    }
+    if (batch) {
+      printf("[%d] Scenario %s on %d ranks\n", world_rank, configs[i]->name,
+             group_ranks[group]);
+    }
+    double scenario_start = PerfWallTime();
+    app_status = runScenario(configs[i], group_comm, &run);
+    seconds[i] = PerfWallTime() - scenario_start;
+    if (app_status != EXIT_SUCCESS) {
+      break;
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, seconds, (int)num_configs, MPI_DOUBLE, MPI_MAX,
+                MPI_COMM_WORLD);
+  if (batch && world_rank == 0) {
+    for (size_t i = 0; i < num_configs; ++i) {
+      printf("Scenario %s: %d ranks, %.3f s\n", configs[i]->name,
+             group_ranks[scenario_group[i]], seconds[i]);
+    }
+  }
+  if (run.units_loaded) {
+    FreeUnitSystem();
+  }
+  FreeDateTable(&run.dates);
+  free(run.tiles);
+  run.tiles = NULL;
+  MPI_Comm_free(&group_comm);
+  FreeBatchConfig(configs, num_configs);
+  configs = NULL;
   printf("[%d] Checkpoint in seconds: %zu\n", world_rank,
          time(NULL) - start_time);
   MPI_Finalize();
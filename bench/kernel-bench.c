@@ -0,0 +1,144 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "kernels.h"
+#include "perf.h"
+#include "unit_util.h"
+
+#define BENCH_FILL_VALUE 1.0e20f
+#define BENCH_MAPPINGS 4
+
+// SRAD, TMIN, TMAX and RAIN as read from the GGCMI files, with the affine
+// conversions the startup reduces their units to.
+static const double kSlopes[BENCH_MAPPINGS] = {0.0864, 1.0, 1.0, 86400.0};
+static const double kIntercepts[BENCH_MAPPINGS] = {0.0, -273.15, -273.15,
+                                                   0.0};
+static const float kBases[BENCH_MAPPINGS] = {180.0f, 275.0f, 288.0f, 2.0e-5f};
+
+static float benchValue(size_t m, size_t i, size_t plane) {
+  // A tenth of the cells are ocean, like the edges of real extents
+  if (i % plane % 10 == 9) {
+    return BENCH_FILL_VALUE;
+  }
+  return kBases[m] * (float)(1.0 + 0.2 * sin(i * 0.37 + m));
+}
+
+// The best of the repeats, which leaves out the first touch of the buffers.
+static double bestOf(double best, double start) {
+  double elapsed = PerfWallTime() - start;
+  return best < 0.0 || elapsed < best ? elapsed : best;
+}
+
+// Times the conversion and the gathering of the cells of one tile by the
+// generic loops against the kernels built for the usual mapping set, and
+// checks that both give the same floats.
+int main(int argc, char **argv) {
+  if (argc > 4) {
+    fprintf(stderr, "usage: %s [days] [side] [repeats]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  size_t days = argc > 1 ? strtoul(argv[1], NULL, 10) : 365;
+  size_t side = argc > 2 ? strtoul(argv[2], NULL, 10) : 32;
+  size_t repeats = argc > 3 ? strtoul(argv[3], NULL, 10) : 5;
+  if (days == 0 || side == 0 || repeats == 0) {
+    fprintf(stderr, "error: days, side and repeats have to be positive\n");
+    return EXIT_FAILURE;
+  }
+  size_t plane = side * side;
+  size_t flat_size = days * plane;
+  float *raw = (float *)malloc(sizeof(float) * BENCH_MAPPINGS * flat_size);
+  float *generic = (float *)malloc(sizeof(float) * BENCH_MAPPINGS * flat_size);
+  float *special = (float *)malloc(sizeof(float) * BENCH_MAPPINGS * flat_size);
+  float *series = (float *)malloc(sizeof(float) * BENCH_MAPPINGS * days);
+  if (raw == NULL || generic == NULL || special == NULL || series == NULL) {
+    fprintf(stderr, "error: unable to allocate a tile of %zu values\n",
+            BENCH_MAPPINGS * flat_size);
+    return EXIT_FAILURE;
+  }
+  FileConfig mappings[BENCH_MAPPINGS];
+  memset(mappings, 0, sizeof(mappings));
+  Config config;
+  memset(&config, 0, sizeof(config));
+  config.mappings = mappings;
+  config.num_mappings = BENCH_MAPPINGS;
+  ConverterContainer converters[BENCH_MAPPINGS];
+  memset(converters, 0, sizeof(converters));
+  float fills[BENCH_MAPPINGS];
+  const float *raw_ptrs[BENCH_MAPPINGS];
+  const float *generic_ptrs[BENCH_MAPPINGS];
+  const float *special_ptrs[BENCH_MAPPINGS];
+  float *converted_ptrs[BENCH_MAPPINGS];
+  for (size_t m = 0; m < BENCH_MAPPINGS; ++m) {
+    SetAffineConverter(&converters[m], kSlopes[m], kIntercepts[m]);
+    fills[m] = BENCH_FILL_VALUE;
+    raw_ptrs[m] = &raw[m * flat_size];
+    generic_ptrs[m] = &generic[m * flat_size];
+    special_ptrs[m] = &special[m * flat_size];
+    converted_ptrs[m] = &special[m * flat_size];
+    for (size_t i = 0; i < flat_size; ++i) {
+      raw[m * flat_size + i] = benchValue(m, i, plane);
+    }
+  }
+  CellKernels kernels;
+  SelectCellKernels(&config, converters, fills, &kernels);
+  if (kernels.convert == NULL) {
+    fprintf(stderr, "error: no kernel is built for the usual mappings\n");
+    return EXIT_FAILURE;
+  }
+
+  double convert_generic = -1.0;
+  double convert_special = -1.0;
+  double gather_generic = -1.0;
+  double gather_special = -1.0;
+  double generic_sum = 0.0;
+  double special_sum = 0.0;
+  for (size_t r = 0; r < repeats; ++r) {
+    double start = PerfWallTime();
+    for (size_t m = 0; m < BENCH_MAPPINGS; ++m) {
+      ConvertValues(&converters[m], fills[m], raw_ptrs[m],
+                    &generic[m * flat_size], flat_size);
+    }
+    convert_generic = bestOf(convert_generic, start);
+    start = PerfWallTime();
+    kernels.convert(&kernels, raw_ptrs, converted_ptrs, flat_size);
+    convert_special = bestOf(convert_special, start);
+
+    start = PerfWallTime();
+    for (size_t i = 0; i < plane; ++i) {
+      if (!GatherGeneric(&kernels, generic_ptrs, plane, i, days, series)) {
+        generic_sum += series[days - 1];
+      }
+    }
+    gather_generic = bestOf(gather_generic, start);
+    start = PerfWallTime();
+    for (size_t i = 0; i < plane; ++i) {
+      if (!kernels.gather(&kernels, special_ptrs, plane, i, days, series)) {
+        special_sum += series[days - 1];
+      }
+    }
+    gather_special = bestOf(gather_special, start);
+  }
+  int same = memcmp(generic, special,
+                    sizeof(float) * BENCH_MAPPINGS * flat_size) == 0 &&
+             generic_sum == special_sum;
+
+  printf("Tile: %d mappings, %zu days, %zu x %zu cells, best of %zu\n",
+         BENCH_MAPPINGS, days, side, side, repeats);
+  printf("%-8s %-22s %12s %12s %8s\n", "step", "kernel", "generic s",
+         "kernel s", "speedup");
+  printf("%-8s %-22s %12.6f %12.6f %7.2fx\n", "convert", kernels.convert_name,
+         convert_generic, convert_special,
+         convert_special > 0.0 ? convert_generic / convert_special : 0.0);
+  printf("%-8s %-22s %12.6f %12.6f %7.2fx\n", "gather", kernels.gather_name,
+         gather_generic, gather_special,
+         gather_special > 0.0 ? gather_generic / gather_special : 0.0);
+  printf("Results: %s\n", same ? "identical" : "DIFFERENT");
+  free(raw);
+  free(generic);
+  free(special);
+  free(series);
+  return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,169 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <netcdf.h>
+
+#include "location.h"
+
+#define SYNTHETIC_FILL_VALUE 1.0e20f
+
+// One variable of the synthetic GGCMI inputs: a seasonal cycle around a
+// base value with a gradient across the grid, in the units of the real
+// files.
+typedef struct SyntheticVariable_ {
+  const char *name;
+  const char *units;
+  float base;
+  float amplitude;
+  float gradient;
+  float scale;
+} SyntheticVariable;
+
+static const SyntheticVariable kVariables[] = {
+    {"tasmin", "K", 275.0f, 10.0f, 0.01f, 1.0f},
+    {"tasmax", "K", 288.0f, 10.0f, 0.02f, 1.0f},
+    {"rsds", "W m-2", 180.0f, 60.0f, 0.1f, 1.0f},
+    {"pr", "kg m-2 s-1", 1.5f, 1.5f, 0.0f, 2.0e-5f},
+};
+
+static float syntheticValue(const SyntheticVariable *variable, size_t day,
+                            size_t x, size_t y) {
+  // The last rows are ocean, so the runs skip some cells like real ones
+  if (y > MAX_Y - 10) {
+    return SYNTHETIC_FILL_VALUE;
+  }
+  double season = sin(2.0 * M_PI * day / 365.0);
+  double noise = sin(day * 0.7 + x * 0.1 + y * 0.3);
+  double value = variable->base + variable->amplitude * season +
+                 variable->gradient * ((double)x + y);
+  if (variable->scale != 1.0f) {
+    value = variable->scale * fabs(value * noise);
+  }
+  return (float)value;
+}
+
+static int writeVariable(const char *output_dir,
+                         const SyntheticVariable *variable, size_t days,
+                         int start_year) {
+  int status;
+  int ncid;
+  char file_name[2048];
+  if ((size_t)snprintf(file_name, sizeof(file_name), "%s/%s.nc", output_dir,
+                       variable->name) >= sizeof(file_name)) {
+    fprintf(stderr, "error: output directory name is too long\n");
+    return 1;
+  }
+  if ((status = nc_create(file_name, NC_NETCDF4 | NC_CLOBBER, &ncid))) {
+    fprintf(stderr, "error: cannot create %s: %s\n", file_name,
+            nc_strerror(status));
+    return 1;
+  }
+  // Laid out and compressed like the GGCMI files, one chunk per daily map
+  int dimids[3];
+  int lon_varid, lat_varid, time_varid, varid;
+  size_t chunks[3] = {1, MAX_Y + 1, MAX_X + 1};
+  float fill_value = SYNTHETIC_FILL_VALUE;
+  char time_units[64];
+  snprintf(time_units, sizeof(time_units), "days since %d-01-01 00:00:00",
+           start_year);
+  if ((status = nc_def_dim(ncid, "time", days, &dimids[0])) ||
+      (status = nc_def_dim(ncid, "lat", MAX_Y + 1, &dimids[1])) ||
+      (status = nc_def_dim(ncid, "lon", MAX_X + 1, &dimids[2])) ||
+      (status =
+           nc_def_var(ncid, "time", NC_DOUBLE, 1, &dimids[0], &time_varid)) ||
+      (status = nc_put_att_text(ncid, time_varid, "units",
+                                strlen(time_units), time_units)) ||
+      (status = nc_put_att_text(ncid, time_varid, "calendar", 8,
+                                "standard")) ||
+      (status =
+           nc_def_var(ncid, "lat", NC_DOUBLE, 1, &dimids[1], &lat_varid)) ||
+      (status =
+           nc_def_var(ncid, "lon", NC_DOUBLE, 1, &dimids[2], &lon_varid)) ||
+      (status = nc_def_var(ncid, variable->name, NC_FLOAT, 3, dimids,
+                           &varid)) ||
+      (status = nc_def_var_chunking(ncid, varid, NC_CHUNKED, chunks)) ||
+      (status = nc_def_var_deflate(ncid, varid, 0, 1, 1)) ||
+      (status = nc_def_var_fill(ncid, varid, 0, &fill_value)) ||
+      (status = nc_put_att_float(ncid, varid, "missing_value", NC_FLOAT, 1,
+                                 &fill_value)) ||
+      (status = nc_put_att_text(ncid, varid, "units", strlen(variable->units),
+                                variable->units)) ||
+      (status = nc_enddef(ncid))) {
+    fprintf(stderr, "error: cannot define %s: %s\n", file_name,
+            nc_strerror(status));
+    nc_close(ncid);
+    return 1;
+  }
+
+  double longitudes[MAX_X + 1];
+  double latitudes[MAX_Y + 1];
+  for (size_t x = 0; x <= MAX_X; ++x) {
+    longitudes[x] = (double)x / LONGITUDE_MULTIPLIER - LONGITUDE_OFFSET;
+  }
+  for (size_t y = 0; y <= MAX_Y; ++y) {
+    latitudes[y] = LATITUDE_OFFSET - (double)y / LATITUDE_MULTIPLIER;
+  }
+  float *map = (float *)malloc(sizeof(float) * (MAX_X + 1) * (MAX_Y + 1));
+  if (map == NULL) {
+    fprintf(stderr, "error: unable to allocate a daily map\n");
+    nc_close(ncid);
+    return 1;
+  }
+  status = nc_put_var_double(ncid, lon_varid, longitudes);
+  if (!status) {
+    status = nc_put_var_double(ncid, lat_varid, latitudes);
+  }
+  for (size_t d = 0; !status && d < days; ++d) {
+    double time = (double)d;
+    size_t day_start = d;
+    status = nc_put_var1_double(ncid, time_varid, &day_start, &time);
+    for (size_t y = 0; y <= MAX_Y; ++y) {
+      for (size_t x = 0; x <= MAX_X; ++x) {
+        map[y * (MAX_X + 1) + x] = syntheticValue(variable, d, x, y);
+      }
+    }
+    size_t start[3] = {d, 0, 0};
+    size_t count[3] = {1, MAX_Y + 1, MAX_X + 1};
+    if (!status) {
+      status = nc_put_vara_float(ncid, varid, start, count, map);
+    }
+  }
+  free(map);
+  if (status) {
+    fprintf(stderr, "error: cannot write %s: %s\n", file_name,
+            nc_strerror(status));
+    nc_close(ncid);
+    return 1;
+  }
+  if ((status = nc_close(ncid))) {
+    fprintf(stderr, "error: cannot close %s: %s\n", file_name,
+            nc_strerror(status));
+    return 1;
+  }
+  return 0;
+}
+
+// Writes global inputs with the grid, layout and units of the GGCMI files
+// for the scaling runs, so they do not depend on real data.
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 4) {
+    fprintf(stderr, "usage: %s output_dir [days] [start_year]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  size_t days = argc > 2 ? strtoul(argv[2], NULL, 10) : 365;
+  int start_year = argc > 3 ? atoi(argv[3]) : 2011;
+  if (days == 0) {
+    fprintf(stderr, "error: days is not a positive integer\n");
+    return EXIT_FAILURE;
+  }
+  for (size_t i = 0; i < sizeof(kVariables) / sizeof(kVariables[0]); ++i) {
+    printf("Writing %s/%s.nc (%zu days)\n", argv[1], kVariables[i].name,
+           days);
+    if (writeVariable(argv[1], &kVariables[i], days, start_year)) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+#!/bin/sh
+# Read strategies of ggcmi2dssatw compared on synthetic inputs.
+#
+# usage: reads.sh -a app -g make-synthetic -w work_dir [-r ranks] [-d days]
+#                 [-s side]
+#
+# Every rank count of the list extracts the same extent of side x side cells
+# three times: with the direct per-rank nc_get_vara_float of its slab
+# ("tiles"), and with whole daily maps read by time range or by variable
+# and transposed to the ranks with MPI_Alltoallv. The read phase and wall
+# time of the slowest rank are collected in reads.csv and compared in
+# reads.txt, both in the work directory. MPIEXEC and MPIEXEC_FLAGS work as
+# for scaling.sh.
+set -e
+
+RANKS="1 2 4"
+DAYS=365
+SIDE=40
+APP=
+GENERATOR=
+WORK_DIR=
+STRATEGIES="tiles time variable"
+
+usage() {
+  sed -n '4,5p' "$0" | sed 's/^# //' >&2
+  exit 1
+}
+
+while getopts "a:g:w:r:d:s:" option; do
+  case $option in
+  a) APP=$OPTARG ;;
+  g) GENERATOR=$OPTARG ;;
+  w) WORK_DIR=$OPTARG ;;
+  r) RANKS=$OPTARG ;;
+  d) DAYS=$OPTARG ;;
+  s) SIDE=$OPTARG ;;
+  *) usage ;;
+  esac
+done
+[ -n "$APP" ] && [ -n "$GENERATOR" ] && [ -n "$WORK_DIR" ] || usage
+
+MPIEXEC=${MPIEXEC:-mpiexec}
+if [ -z "${MPIEXEC_FLAGS+set}" ]; then
+  MPIEXEC_FLAGS=
+  if $MPIEXEC --version 2>&1 | grep -qi "open mpi\|openrte"; then
+    MPIEXEC_FLAGS=--oversubscribe
+    if [ "$(id -u)" = 0 ]; then
+      MPIEXEC_FLAGS="$MPIEXEC_FLAGS --allow-run-as-root"
+    fi
+  fi
+fi
+
+# The extent starts at this cell, inland of the ocean rows of the inputs
+X0=100
+Y0=100
+
+mkdir -p "$WORK_DIR/data" "$WORK_DIR/logs"
+if [ ! -f "$WORK_DIR/data/pr.nc" ] ||
+  [ "$(cat "$WORK_DIR/data/days" 2>/dev/null)" != "$DAYS" ]; then
+  "$GENERATOR" "$WORK_DIR/data" "$DAYS"
+  echo "$DAYS" > "$WORK_DIR/data/days"
+fi
+
+longitude() { awk -v x="$1" 'BEGIN { printf "%.2f", x / 2 - 179.75 }'; }
+latitude() { awk -v y="$1" 'BEGIN { printf "%.2f", 89.75 - y / 2 }'; }
+
+# writeConfig file output_dir strategy
+writeConfig() {
+  data=$WORK_DIR/data
+  cat > "$1" <<EOC
+{
+  "start_year": 2011,
+  "output_dir": "$2",
+  "point_major": false,
+  "read_strategy": "$3",
+  "extent": {"top_left": [$(longitude $X0), $(latitude $Y0)],
+             "bottom_right": [$(longitude $((X0 + SIDE - 1))),
+                              $(latitude $((Y0 + SIDE - 1)))]},
+  "mapping": [
+    {"file": "$data/rsds.nc", "netcdfVar": "rsds", "dssatVar": "SRAD",
+     "sourceUnit": "W m-2", "targetUnit": "MJ m-2 day-1"},
+    {"file": "$data/tasmin.nc", "netcdfVar": "tasmin", "dssatVar": "TMIN",
+     "sourceUnit": "K", "targetUnit": "degree_C"},
+    {"file": "$data/tasmax.nc", "netcdfVar": "tasmax", "dssatVar": "TMAX",
+     "sourceUnit": "K", "targetUnit": "degree_C"},
+    {"file": "$data/pr.nc", "netcdfVar": "pr", "dssatVar": "RAIN",
+     "sourceUnit": "mm s-1", "targetUnit": "mm day-1"}
+  ]
+}
+EOC
+}
+
+now() { date +%s.%N; }
+
+CSV=$WORK_DIR/reads.csv
+echo "strategy,ranks,cells,days,read_seconds,wall_seconds" > "$CSV"
+
+for ranks in $RANKS; do
+  for strategy in $STRATEGIES; do
+    name=$strategy-$ranks
+    output=$WORK_DIR/out/$name
+    rm -rf "$output"
+    mkdir -p "$output"
+    writeConfig "$WORK_DIR/$name.json" "$output" "$strategy"
+    echo "Reading by $strategy with $ranks ranks"
+    start=$(now)
+    # shellcheck disable=SC2086
+    if ! $MPIEXEC $MPIEXEC_FLAGS -n "$ranks" "$APP" "$WORK_DIR/$name.json" \
+      > "$WORK_DIR/logs/$name.log" 2>&1; then
+      echo "error: the run failed, see $WORK_DIR/logs/$name.log" >&2
+      exit 1
+    fi
+    end=$(now)
+    rm -rf "$output"
+    awk -v strategy="$strategy" -v ranks="$ranks" -v cells=$((SIDE * SIDE)) \
+      -v days="$DAYS" -v wall="$start $end" '
+      /^\[[0-9]+\] Phase read / {
+        for (i = 4; i < NF && $i != "s"; ++i) {}
+        if ($(i - 1) > read) {
+          read = $(i - 1)
+        }
+      }
+      END {
+        split(wall, times, " ")
+        printf "%s,%d,%d,%d,%.3f,%.3f\n", strategy, ranks, cells, days, read,
+               times[2] - times[1]
+      }' "$WORK_DIR/logs/$name.log" >> "$CSV"
+  done
+done
+
+# The read phase of each transposed strategy against the per-rank reads of
+# the same rank count
+awk -F, '
+  NR > 1 {
+    if ($1 == "tiles") {
+      base[$2] = $5
+    }
+    rows = rows sprintf("%8s %6d %10.3f %10.3f %8.2fx\n", $1, $2, $5, $6,
+                        $5 > 0 ? base[$2] / $5 : 0)
+  }
+  END {
+    printf "%8s %6s %10s %10s %9s\n", "strategy", "ranks", "read (s)",
+           "wall (s)", "vs tiles"
+    printf "%s", rows
+  }' "$CSV" > "$WORK_DIR/reads.txt"
+cat "$WORK_DIR/reads.txt"
+echo "Read times: $CSV"
@@ -0,0 +1,189 @@
+#!/bin/sh
+# Strong and weak scaling runs of ggcmi2dssatw on synthetic inputs.
+#
+# usage: scaling.sh -a app -g make-synthetic -w work_dir [-r ranks]
+#                   [-t threads] [-d days] [-s side]
+#
+# Strong scaling extracts a fixed extent of side x side cells with each rank
+# count of the list; weak scaling gives every rank side x side cells by
+# widening the extent with the rank count. Each run is repeated for every
+# thread count of the list, used for decompress_threads and compress_threads.
+# The per-phase times of the slowest rank are collected in scaling.csv and
+# summarized in scaling.txt, both in the work directory. Open MPI runs are
+# oversubscribed so the rank counts can exceed the cores of the machine; set
+# MPIEXEC and MPIEXEC_FLAGS to launch differently.
+set -e
+
+RANKS="1 2 4"
+THREADS="0"
+DAYS=365
+SIDE=20
+APP=
+GENERATOR=
+WORK_DIR=
+
+usage() {
+  sed -n '4,5p' "$0" | sed 's/^# //' >&2
+  exit 1
+}
+
+while getopts "a:g:w:r:t:d:s:" option; do
+  case $option in
+  a) APP=$OPTARG ;;
+  g) GENERATOR=$OPTARG ;;
+  w) WORK_DIR=$OPTARG ;;
+  r) RANKS=$OPTARG ;;
+  t) THREADS=$OPTARG ;;
+  d) DAYS=$OPTARG ;;
+  s) SIDE=$OPTARG ;;
+  *) usage ;;
+  esac
+done
+[ -n "$APP" ] && [ -n "$GENERATOR" ] && [ -n "$WORK_DIR" ] || usage
+
+MPIEXEC=${MPIEXEC:-mpiexec}
+if [ -z "${MPIEXEC_FLAGS+set}" ]; then
+  MPIEXEC_FLAGS=
+  if $MPIEXEC --version 2>&1 | grep -qi "open mpi\|openrte"; then
+    MPIEXEC_FLAGS=--oversubscribe
+    if [ "$(id -u)" = 0 ]; then
+      MPIEXEC_FLAGS="$MPIEXEC_FLAGS --allow-run-as-root"
+    fi
+  fi
+fi
+
+# The extents start at this cell, inland of the ocean rows of the inputs
+X0=100
+Y0=100
+MAX_X=719
+
+mkdir -p "$WORK_DIR/data" "$WORK_DIR/logs"
+if [ ! -f "$WORK_DIR/data/pr.nc" ] ||
+  [ "$(cat "$WORK_DIR/data/days" 2>/dev/null)" != "$DAYS" ]; then
+  "$GENERATOR" "$WORK_DIR/data" "$DAYS"
+  echo "$DAYS" > "$WORK_DIR/data/days"
+fi
+
+# Longitude and latitude of the centre of a grid cell.
+longitude() { awk -v x="$1" 'BEGIN { printf "%.2f", x / 2 - 179.75 }'; }
+latitude() { awk -v y="$1" 'BEGIN { printf "%.2f", 89.75 - y / 2 }'; }
+
+# writeConfig file output_dir columns rows threads
+writeConfig() {
+  data=$WORK_DIR/data
+  cat > "$1" <<EOF
+{
+  "start_year": 2011,
+  "output_dir": "$2",
+  "decompress_threads": $5,
+  "compress_threads": $5,
+  "extent": {"top_left": [$(longitude $X0), $(latitude $Y0)],
+             "bottom_right": [$(longitude $((X0 + $3 - 1))),
+                              $(latitude $((Y0 + $4 - 1)))]},
+  "mapping": [
+    {"file": "$data/rsds.nc", "netcdfVar": "rsds", "dssatVar": "SRAD",
+     "sourceUnit": "W m-2", "targetUnit": "MJ m-2 day-1"},
+    {"file": "$data/tasmin.nc", "netcdfVar": "tasmin", "dssatVar": "TMIN",
+     "sourceUnit": "K", "targetUnit": "degree_C"},
+    {"file": "$data/tasmax.nc", "netcdfVar": "tasmax", "dssatVar": "TMAX",
+     "sourceUnit": "K", "targetUnit": "degree_C"},
+    {"file": "$data/pr.nc", "netcdfVar": "pr", "dssatVar": "RAIN",
+     "sourceUnit": "mm s-1", "targetUnit": "mm day-1"}
+  ]
+}
+EOF
+}
+
+now() { date +%s.%N; }
+
+CSV=$WORK_DIR/scaling.csv
+echo "kind,ranks,threads,cells,days,phase,seconds" > "$CSV"
+
+# run kind ranks threads columns rows
+run() {
+  name=$1-$2-$3
+  output=$WORK_DIR/out/$name
+  rm -rf "$output"
+  mkdir -p "$output"
+  writeConfig "$WORK_DIR/$name.json" "$output" "$4" "$5" "$3"
+  echo "Running $1 scaling with $2 ranks, $3 threads, $4x$5 cells"
+  start=$(now)
+  # shellcheck disable=SC2086
+  if ! $MPIEXEC $MPIEXEC_FLAGS -n "$2" "$APP" "$WORK_DIR/$name.json" \
+    > "$WORK_DIR/logs/$name.log" 2>&1; then
+    echo "error: the run failed, see $WORK_DIR/logs/$name.log" >&2
+    exit 1
+  fi
+  end=$(now)
+  rm -rf "$output"
+  # The slowest rank sets the time of each phase
+  awk -v kind="$1" -v ranks="$2" -v threads="$3" -v cells=$(($4 * $5)) \
+    -v days="$DAYS" -v wall="$start $end" '
+    /^\[[0-9]+\] Phase / {
+      for (i = NF; i > 3 && $i != "s"; --i) {}
+      phase = $3
+      for (j = 4; j < i - 1; ++j) {
+        phase = phase " " $j
+      }
+      if (!(phase in seconds)) {
+        order[++num_phases] = phase
+      }
+      if ($(i - 1) > seconds[phase]) {
+        seconds[phase] = $(i - 1)
+      }
+    }
+    END {
+      split(wall, times, " ")
+      printf "%s,%d,%d,%d,%d,wall,%.3f\n", kind, ranks, threads, cells, days,
+             times[2] - times[1]
+      for (p = 1; p <= num_phases; ++p) {
+        printf "%s,%d,%d,%d,%d,%s,%.3f\n", kind, ranks, threads, cells, days,
+               order[p], seconds[order[p]]
+      }
+    }' "$WORK_DIR/logs/$name.log" >> "$CSV"
+}
+
+for threads in $THREADS; do
+  for ranks in $RANKS; do
+    run strong "$ranks" "$threads" "$SIDE" "$SIDE"
+  done
+  for ranks in $RANKS; do
+    if [ $((X0 + SIDE * ranks - 1)) -gt $MAX_X ]; then
+      echo "warning: weak scaling to $ranks ranks needs more than the" \
+        "grid width, skipped" >&2
+      continue
+    fi
+    run weak "$ranks" "$threads" $((SIDE * ranks)) "$SIDE"
+  done
+done
+
+# Speedup against the smallest rank count of each series, T1 / Tn for
+# strong scaling and the scaled speedup rn / r1 * T1 / Tn for weak scaling.
+# The efficiency is the speedup per rank relative to that count.
+awk -F, '
+  NR > 1 && $6 == "wall" {
+    key = $1 SUBSEP $3
+    if (!(key in base_ranks)) {
+      base_ranks[key] = $2
+      base_wall[key] = $7
+      series[++num_series] = key
+    }
+    speedup = base_wall[key] / $7
+    if ($1 == "weak") {
+      speedup *= $2 / base_ranks[key]
+    }
+    rows[key] = rows[key] sprintf("%6d %8d %6d %10.3f %8.2f %9.1f%%\n", $2,
+      $4, $3, $7, speedup, 100 * speedup * base_ranks[key] / $2)
+  }
+  END {
+    for (s = 1; s <= num_series; ++s) {
+      split(series[s], parts, SUBSEP)
+      title = parts[1] == "strong" ? "Strong" : "Weak"
+      printf "%s scaling, %d threads\n", title, parts[2]
+      printf "%6s %8s %6s %10s %8s %10s\n", "ranks", "cells", "thr",
+             "wall (s)", "speedup", "efficiency"
+      printf "%s\n", rows[series[s]]
+    }
+  }' "$CSV" > "$WORK_DIR/scaling.txt"
+cat "$WORK_DIR/scaling.txt"
+echo "Phase times: $CSV"
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "admission.h"
+#include "perf.h"
+
+// The slots a node gets: its share of the limit of the run, at least one,
+// and no more than its own limit. A limit of zero does not apply.
+size_t AdmissionCeiling(size_t max_creates, size_t max_creates_per_node,
+                        int num_nodes) {
+  size_t ceiling = (size_t)INT32_MAX;
+  if (max_creates > 0) {
+    size_t share = max_creates / (size_t)num_nodes;
+    ceiling = share > 0 ? share : 1;
+  }
+  if (max_creates_per_node > 0 && max_creates_per_node < ceiling) {
+    ceiling = max_creates_per_node;
+  }
+  return ceiling;
+}
+
+// Collective over mpi_comm. The slots live in an MPI-3 window shared by the
+// ranks of each node; its memory is taken and given back with atomic
+// operations, so the writer threads never call MPI.
+int InitAdmission(Admission *admission, MPI_Comm mpi_comm, size_t max_creates,
+                  size_t max_creates_per_node) {
+  admission->window = MPI_WIN_NULL;
+  admission->slots = NULL;
+  admission->files = 0;
+  admission->wait_seconds = 0.0;
+  admission->first_start = -1.0;
+  admission->last_end = -1.0;
+  pthread_mutex_init(&admission->lock, NULL);
+  if (SplitNodes(mpi_comm, &admission->node)) {
+    FreeAdmission(admission);
+    return 1;
+  }
+  AdmissionSlots *base = NULL;
+  MPI_Aint size = admission->node.node_rank == 0 ? sizeof(AdmissionSlots) : 0;
+  if (MPI_Win_allocate_shared(size, 1, MPI_INFO_NULL, admission->node.node_comm,
+                              &base, &admission->window) != MPI_SUCCESS) {
+    fprintf(stderr, "error: unable to share the file creation slots of the "
+                    "node\n");
+    admission->window = MPI_WIN_NULL;
+    FreeAdmission(admission);
+    return 1;
+  }
+  int displacement;
+  MPI_Win_shared_query(admission->window, 0, &size, &displacement,
+                       &admission->slots);
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, admission->window);
+  admission->ceiling = (int)AdmissionCeiling(
+      max_creates, max_creates_per_node, admission->node.num_nodes);
+  if (admission->node.node_rank == 0) {
+    admission->slots->in_use = 0;
+    admission->slots->limit = admission->ceiling;
+    admission->slots->fastest_ns = INT64_MAX;
+  }
+  MPI_Win_sync(admission->window);
+  MPI_Barrier(admission->node.node_comm);
+  MPI_Win_sync(admission->window);
+  return 0;
+}
+
+// Waits for a slot of the node, backing off while all of them are taken, and
+// returns the time the slot was taken, which ReleaseFile needs. Without
+// admission control it returns at once.
+double AdmitFile(Admission *admission) {
+  if (admission == NULL) {
+    return 0.0;
+  }
+  AdmissionSlots *slots = admission->slots;
+  double start = PerfWallTime();
+  long backoff_us = ADMISSION_MIN_BACKOFF_US;
+  for (;;) {
+    int in_use = __atomic_load_n(&slots->in_use, __ATOMIC_ACQUIRE);
+    int limit = __atomic_load_n(&slots->limit, __ATOMIC_RELAXED);
+    if (in_use < limit) {
+      if (__atomic_compare_exchange_n(&slots->in_use, &in_use, in_use + 1, 0,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        break;
+      }
+      continue;
+    }
+    struct timespec pause = {0, backoff_us * 1000L};
+    nanosleep(&pause, NULL);
+    backoff_us = backoff_us * 2 < ADMISSION_MAX_BACKOFF_US
+                     ? backoff_us * 2
+                     : ADMISSION_MAX_BACKOFF_US;
+  }
+  double admitted = PerfWallTime();
+  pthread_mutex_lock(&admission->lock);
+  admission->wait_seconds += admitted - start;
+  if (admission->first_start < 0.0 || admitted < admission->first_start) {
+    admission->first_start = admitted;
+  }
+  pthread_mutex_unlock(&admission->lock);
+  return admitted;
+}
+
+// Gives the slot back and adapts the limit of the node to how long the file
+// took from opening to closing. Losing a race on the limit skips the step,
+// another create takes it.
+void ReleaseFile(Admission *admission, double start) {
+  if (admission == NULL) {
+    return;
+  }
+  AdmissionSlots *slots = admission->slots;
+  double end = PerfWallTime();
+  int64_t elapsed_ns = (int64_t)((end - start) * 1.0e9);
+  __atomic_fetch_sub(&slots->in_use, 1, __ATOMIC_RELEASE);
+  int64_t fastest = __atomic_load_n(&slots->fastest_ns, __ATOMIC_RELAXED);
+  while (elapsed_ns < fastest &&
+         !__atomic_compare_exchange_n(&slots->fastest_ns, &fastest,
+                                      elapsed_ns, 0, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+  }
+  if (elapsed_ns < fastest) {
+    fastest = elapsed_ns;
+  }
+  int limit = __atomic_load_n(&slots->limit, __ATOMIC_RELAXED);
+  int next = elapsed_ns > ADMISSION_SLOW_FACTOR * fastest ? limit - 1
+                                                          : limit + 1;
+  if (next >= 1 && next <= admission->ceiling) {
+    __atomic_compare_exchange_n(&slots->limit, &limit, next, 0,
+                                __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_lock(&admission->lock);
+  ++admission->files;
+  if (end > admission->last_end) {
+    admission->last_end = end;
+  }
+  pthread_mutex_unlock(&admission->lock);
+}
+
+// Prints the files each rank created per second while it was creating them,
+// and on rank 0 the rate of the run over the longest of those spans, since
+// the clocks of the nodes are not compared. Collective over mpi_comm.
+void ReportAdmission(const Admission *admission, int world_rank,
+                     MPI_Comm mpi_comm) {
+  double seconds = admission->files > 0
+                       ? admission->last_end - admission->first_start
+                       : 0.0;
+  printf("[%d] Admission: %zu files created at %.1f files/s, %.3f s waiting "
+         "for a slot, node limit %d of %d\n",
+         world_rank, admission->files,
+         seconds > 0.0 ? admission->files / seconds : 0.0,
+         admission->wait_seconds,
+         __atomic_load_n(&admission->slots->limit, __ATOMIC_RELAXED),
+         admission->ceiling);
+  int comm_rank;
+  MPI_Comm_rank(mpi_comm, &comm_rank);
+  unsigned long long files = admission->files;
+  MPI_Reduce(comm_rank == 0 ? MPI_IN_PLACE : &files, &files, 1,
+             MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, mpi_comm);
+  MPI_Reduce(comm_rank == 0 ? MPI_IN_PLACE : &seconds, &seconds, 1,
+             MPI_DOUBLE, MPI_MAX, 0, mpi_comm);
+  if (comm_rank == 0) {
+    printf("Files created: %llu at %.1f files/s on %d nodes\n", files,
+           seconds > 0.0 ? files / seconds : 0.0, admission->node.num_nodes);
+  }
+}
+
+void FreeAdmission(Admission *admission) {
+  if (admission->window != MPI_WIN_NULL) {
+    MPI_Win_unlock_all(admission->window);
+    MPI_Win_free(&admission->window);
+  }
+  admission->slots = NULL;
+  FreeNodeBuffer(&admission->node);
+  pthread_mutex_destroy(&admission->lock);
+}
@@ -0,0 +1,52 @@
+#ifndef WTH_ADMISSION_H_
+#define WTH_ADMISSION_H_
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mpi.h>
+
+#include "node_buffer.h"
+
+// A create is slow when it takes this many times the fastest one of the node
+#define ADMISSION_SLOW_FACTOR 8
+// Bounds of the wait between two attempts to take a slot, in microseconds
+#define ADMISSION_MIN_BACKOFF_US 50
+#define ADMISSION_MAX_BACKOFF_US 5000
+
+// The state the ranks of a node share: the slots taken, the current limit
+// and the fastest create seen, in nanoseconds.
+typedef struct AdmissionSlots_ {
+  int in_use;
+  int limit;
+  int64_t fastest_ns;
+} AdmissionSlots;
+
+// Limits the weather files being created at once by the ranks of a node, so
+// a run entering its output phase does not flood the file system with
+// metadata requests. Every rank and writer thread takes one of the node's
+// slots from opening a file to closing it. The limit starts at the ceiling,
+// is lowered by one after each slow create and raised by one after each
+// fast one, never going below one or above the ceiling.
+typedef struct Admission_ {
+  NodeBuffer node;
+  MPI_Win window;
+  AdmissionSlots *slots;
+  int ceiling;
+  pthread_mutex_t lock;
+  size_t files;
+  double wait_seconds;
+  double first_start;
+  double last_end;
+} Admission;
+
+size_t AdmissionCeiling(size_t max_creates, size_t max_creates_per_node,
+                        int num_nodes);
+int InitAdmission(Admission *admission, MPI_Comm mpi_comm, size_t max_creates,
+                  size_t max_creates_per_node);
+double AdmitFile(Admission *admission);
+void ReleaseFile(Admission *admission, double start);
+void ReportAdmission(const Admission *admission, int world_rank,
+                     MPI_Comm mpi_comm);
+void FreeAdmission(Admission *admission);
+#endif // WTH_ADMISSION_H_
@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "batch.h"
+#include "location.h"
+
+// The bytes a scenario reads, scaled down to the share of the grid it
+// extracts. Derived variables are computed from loaded slabs and cost no I/O.
+double EstimateScenarioCost(const Config *config) {
+  double bytes = 0.0;
+  for (size_t i = 0; i < config->num_mappings; ++i) {
+    struct stat source;
+    if (config->mappings[i].derived != NULL) {
+      continue;
+    }
+    if (stat(config->mappings[i].file_name, &source) == 0) {
+      bytes += (double)source.st_size;
+    } else {
+      bytes += 1.0;
+    }
+    for (size_t k = 0; k < config->mappings[i].num_parts; ++k) {
+      if (stat(config->mappings[i].parts[k], &source) == 0) {
+        bytes += (double)source.st_size;
+      }
+    }
+    for (size_t k = 0; k < config->mappings[i].num_members; ++k) {
+      if (stat(config->mappings[i].members[k], &source) == 0) {
+        bytes += (double)source.st_size;
+      }
+    }
+  }
+  double cells = (MAX_X + 1.0) * (MAX_Y + 1.0);
+  if (config->mode < 2) {
+    XY upper_left = LonLatToXY(config->points[0]);
+    XY bottom_right = LonLatToXY(config->points[1]);
+    cells = (bottom_right.x - upper_left.x + 1.0) *
+            (bottom_right.y - upper_left.y + 1.0);
+  } else if (config->num_points > 0) {
+    cells = (double)config->num_points;
+  }
+  return bytes * cells / ((MAX_X + 1.0) * (MAX_Y + 1.0));
+}
+
+// Scenarios are spread over one group per rank (or per scenario when there
+// are fewer ranks), largest first onto the lightest group. The remaining
+// ranks then go to the group with the most work per rank, so every group
+// finishes at about the same time.
+int PlanBatch(const double *costs, size_t num_scenarios, int world_size,
+              size_t *scenario_group, int *group_ranks, size_t *num_groups) {
+  if (num_scenarios == 0 || world_size < 1) {
+    fprintf(stderr, "error: nothing to plan for %zu scenarios on %d ranks\n",
+            num_scenarios, world_size);
+    return 1;
+  }
+  size_t groups =
+      (size_t)world_size < num_scenarios ? (size_t)world_size : num_scenarios;
+  size_t *order = (size_t *)malloc(sizeof(size_t) * num_scenarios);
+  double *loads = (double *)calloc(groups, sizeof(double));
+  if (order == NULL || loads == NULL) {
+    free(order);
+    free(loads);
+    return 1;
+  }
+  for (size_t i = 0; i < num_scenarios; ++i) {
+    order[i] = i;
+  }
+  // Insertion sort by decreasing cost keeps ties in input order.
+  for (size_t i = 1; i < num_scenarios; ++i) {
+    size_t current = order[i];
+    size_t j = i;
+    while (j > 0 && costs[order[j - 1]] < costs[current]) {
+      order[j] = order[j - 1];
+      --j;
+    }
+    order[j] = current;
+  }
+  for (size_t i = 0; i < num_scenarios; ++i) {
+    size_t lightest = 0;
+    for (size_t g = 1; g < groups; ++g) {
+      if (loads[g] < loads[lightest]) {
+        lightest = g;
+      }
+    }
+    scenario_group[order[i]] = lightest;
+    loads[lightest] += costs[order[i]] > 0.0 ? costs[order[i]] : 0.0;
+  }
+  for (size_t g = 0; g < groups; ++g) {
+    group_ranks[g] = 1;
+  }
+  for (int r = (int)groups; r < world_size; ++r) {
+    size_t busiest = 0;
+    for (size_t g = 1; g < groups; ++g) {
+      if (loads[g] / group_ranks[g] > loads[busiest] / group_ranks[busiest]) {
+        busiest = g;
+      }
+    }
+    ++group_ranks[busiest];
+  }
+  free(order);
+  free(loads);
+  *num_groups = groups;
+  return 0;
+}
+
+// Groups take consecutive ranks in group order.
+size_t GroupOfRank(const int *group_ranks, size_t num_groups, int rank) {
+  int first = 0;
+  for (size_t g = 0; g < num_groups; ++g) {
+    first += group_ranks[g];
+    if (rank < first) {
+      return g;
+    }
+  }
+  return num_groups - 1;
+}
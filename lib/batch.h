@@ -0,0 +1,11 @@
+#ifndef WTH_BATCH_H_
+#define WTH_BATCH_H_
+#include <stddef.h>
+
+#include "config.h"
+
+double EstimateScenarioCost(const Config *config);
+int PlanBatch(const double *costs, size_t num_scenarios, int world_size,
+              size_t *scenario_group, int *group_ranks, size_t *num_groups);
+size_t GroupOfRank(const int *group_ranks, size_t num_groups, int rank);
+#endif // WTH_BATCH_H_
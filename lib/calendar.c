@@ -167,4 +167,120 @@ size_t MonthsInDays(size_t days) {
   size_t years = days / 365;
   size_t months = years / 12;
   return months;
-}
\ No newline at end of file
+}
+
+int BuildDateTable(const char *start_date_str, size_t days, DateTable *table) {
+  date_t date;
+  table->days = days;
+  table->dssat = malloc(sizeof(*table->dssat) * days);
+  table->day_of_month = (int *)malloc(sizeof(int) * days);
+  table->month_ends = (int *)malloc(sizeof(int) * days);
+  if (table->dssat == NULL || table->day_of_month == NULL ||
+      table->month_ends == NULL || ParseDate(start_date_str, &date)) {
+    FreeDateTable(table);
+    return date_error;
+  }
+  for (size_t d = 0; d < days; ++d) {
+    int month = date.month;
+    DateAsDSSAT2String(&date, table->dssat[d]);
+    table->day_of_month[d] = date.day_of_month;
+    AddOneDay(&date);
+    table->month_ends[d] = date.month != month;
+  }
+  return date_ok;
+}
+
+void FreeDateTable(DateTable *table) {
+  free(table->dssat);
+  table->dssat = NULL;
+  free(table->day_of_month);
+  table->day_of_month = NULL;
+  free(table->month_ends);
+  table->month_ends = NULL;
+  table->days = 0;
+}
+
+static void ResetDailyAverages(float *daily_avg) {
+  for (size_t i = 0; i < 31; ++i) {
+    daily_avg[i] = -99.9f;
+  }
+}
+
+static float MonthlyAverage(const float *daily_avg) {
+  float sum = 0.0f;
+  size_t i = 0;
+  while (i < 31 && daily_avg[i] != -99.9f) {
+    sum += daily_avg[i];
+    ++i;
+  }
+  if (i == 0) {
+    return 0.0f;
+  }
+  return sum / i;
+}
+
+// The TAV and AMP of a weather file header, from the monthly averages of the
+// daily mean temperature. A missing series counts as -99.9 every day.
+void SummarizeTemperatures(const float *tmin, const float *tmax,
+                           const DateTable *dates, double *tav, float *amp) {
+  size_t months = 1;
+  double monthly_sum = 0.0;
+  float daily_avg[31];
+  float lowest = -99.9f;
+  float highest = -99.9f;
+  ResetDailyAverages(daily_avg);
+  for (size_t d = 0; d < dates->days; ++d) {
+    float low = tmin == NULL ? -99.9f : tmin[d];
+    float high = tmax == NULL ? -99.9f : tmax[d];
+    if (high != 99.9f && low != 99.9f) {
+      daily_avg[dates->day_of_month[d] - 1] = (high + low) / 2.0f;
+    }
+    if (dates->month_ends[d]) {
+      float mavg = MonthlyAverage(daily_avg);
+      if (lowest == -99.9f) {
+        lowest = mavg;
+      }
+      if (highest == -99.9f) {
+        highest = mavg;
+      }
+      if (lowest > mavg) {
+        lowest = mavg;
+      }
+      if (highest < mavg) {
+        highest = mavg;
+      }
+      monthly_sum += mavg;
+      ++months;
+      ResetDailyAverages(daily_avg);
+    }
+  }
+  *tav = monthly_sum / months;
+  *amp = highest - lowest;
+}
+
+// The TAV and AMP of every cell of a tile whose temperatures are stored day
+// plane after day plane, as SummarizeTemperatures finds them from the series
+// of each cell. Either temperature may be missing.
+int SummarizeTileTemperatures(const float *tmin, const float *tmax,
+                              size_t plane, const DateTable *dates,
+                              double *tav, float *amp) {
+  float *low = (float *)malloc(sizeof(float) * 2 * dates->days);
+  if (low == NULL) {
+    return 1;
+  }
+  float *high = &low[dates->days];
+  for (size_t i = 0; i < plane; ++i) {
+    for (size_t d = 0; d < dates->days; ++d) {
+      if (tmin != NULL) {
+        low[d] = tmin[d * plane + i];
+      }
+      if (tmax != NULL) {
+        high[d] = tmax[d * plane + i];
+      }
+    }
+    SummarizeTemperatures(tmin == NULL ? NULL : low,
+                          tmax == NULL ? NULL : high, dates, &tav[i], &amp[i]);
+  }
+  free(low);
+  return 0;
+}
@@ -16,6 +16,14 @@ typedef struct date {
 
 } date_t;
 
+// Per-day calendar of a time axis, built once and shared by every cell.
+typedef struct DateTable_ {
+  size_t days;
+  char (*dssat)[D2DDATE_STRING_LEN];
+  int *day_of_month;
+  int *month_ends;
+} DateTable;
+
 int ValidDateParts(const int year, const int month, const int day_of_month);
 int ValidDate(const date_t *date);
 int CreateDate(int year, int month, int day_of_month, date_t *date);
@@ -24,4 +32,11 @@ int AddOneDay(date_t *date);
 size_t DateAsString(const date_t *date, char *dest_str);
 size_t DateAsDSSAT2String(const date_t *date, char *dest_str);
 size_t MonthsInDays(size_t days);
+int BuildDateTable(const char *start_date_str, size_t days, DateTable *table);
+void FreeDateTable(DateTable *table);
+void SummarizeTemperatures(const float *tmin, const float *tmax,
+                           const DateTable *dates, double *tav, float *amp);
+int SummarizeTileTemperatures(const float *tmin, const float *tmax,
+                              size_t plane, const DateTable *dates,
+                              double *tav, float *amp);
 #endif // GGCMI_WTH_GEN__CALENDAR_H_
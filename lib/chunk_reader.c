@@ -0,0 +1,394 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <hdf5.h>
+#include <zlib.h>
+
+#include "chunk_reader.h"
+
+#define CHUNK_READER_MAX_FILTERS 8
+
+struct ChunkReader_ {
+  hid_t file;
+  hid_t dataset;
+  int fd;
+  hsize_t dims[3];
+  hsize_t chunk_dims[3];
+  H5Z_filter_t filters[CHUNK_READER_MAX_FILTERS];
+  size_t num_filters;
+  size_t chunk_bytes;
+  float fill_value;
+  size_t num_threads;
+  // HDF5 is usually built without thread safety, so every library call is
+  // made under this lock and only inflating and scattering run in parallel.
+  pthread_mutex_t lock;
+};
+
+typedef struct ChunkJob_ {
+  ChunkReader *reader;
+  Hyperslab slab;
+  float *dest;
+  hsize_t first[3];
+  hsize_t count[3];
+  size_t num_chunks;
+  size_t next_chunk;
+  int failed;
+} ChunkJob;
+
+void UnshuffleBytes(const unsigned char *source, size_t size,
+                    size_t element_size, unsigned char *dest) {
+  size_t num_elements = size / element_size;
+  for (size_t b = 0; b < element_size; ++b) {
+    const unsigned char *plane = &source[b * num_elements];
+    for (size_t i = 0; i < num_elements; ++i) {
+      dest[(i * element_size) + b] = plane[i];
+    }
+  }
+  // Trailing bytes which do not make up a whole element are not shuffled
+  size_t tail = num_elements * element_size;
+  memcpy(&dest[tail], &source[tail], size - tail);
+}
+
+// Only the filters HDF5 applies to GGCMI files are understood, anything
+// else leaves the variable to nc_get_vara_float.
+static int InspectLayout(ChunkReader *reader, const char *file_name,
+                         const char *var_name) {
+  hid_t space = H5Dget_space(reader->dataset);
+  hid_t type = H5Dget_type(reader->dataset);
+  hid_t dcpl = H5Dget_create_plist(reader->dataset);
+  int supported = 0;
+  if (space < 0 || type < 0 || dcpl < 0) {
+    goto done;
+  }
+  if (H5Sget_simple_extent_ndims(space) != 3 ||
+      H5Tequal(type, H5T_NATIVE_FLOAT) <= 0 ||
+      H5Pget_layout(dcpl) != H5D_CHUNKED) {
+    printf("Note: %s in %s is not a chunked 3D float variable\n", var_name,
+           file_name);
+    goto done;
+  }
+  H5Sget_simple_extent_dims(space, reader->dims, NULL);
+  H5Pget_chunk(dcpl, 3, reader->chunk_dims);
+  int num_filters = H5Pget_nfilters(dcpl);
+  if (num_filters < 0 || num_filters > CHUNK_READER_MAX_FILTERS) {
+    goto done;
+  }
+  for (int i = 0; i < num_filters; ++i) {
+    unsigned int flags;
+    size_t num_values = 1;
+    unsigned int values[1] = {sizeof(float)};
+    char name[64];
+    unsigned int filter_config;
+    reader->filters[i] =
+        H5Pget_filter2(dcpl, (unsigned int)i, &flags, &num_values, values,
+                       sizeof(name), name, &filter_config);
+    if (reader->filters[i] != H5Z_FILTER_DEFLATE &&
+        !(reader->filters[i] == H5Z_FILTER_SHUFFLE &&
+          (num_values == 0 || values[0] == sizeof(float)))) {
+      printf("Note: %s in %s uses the unsupported filter %s\n", var_name,
+             file_name, name);
+      goto done;
+    }
+  }
+  reader->num_filters = (size_t)num_filters;
+  reader->chunk_bytes = sizeof(float) * reader->chunk_dims[0] *
+                        reader->chunk_dims[1] * reader->chunk_dims[2];
+  reader->fill_value = 0.0f;
+  H5Pget_fill_value(dcpl, H5T_NATIVE_FLOAT, &reader->fill_value);
+  supported = 1;
+done:
+  if (dcpl >= 0) {
+    H5Pclose(dcpl);
+  }
+  if (type >= 0) {
+    H5Tclose(type);
+  }
+  if (space >= 0) {
+    H5Sclose(space);
+  }
+  return supported;
+}
+
+ChunkReader *OpenChunkReader(const char *file_name, const char *var_name,
+                             size_t num_threads) {
+  ChunkReader *reader = (ChunkReader *)calloc(1, sizeof(ChunkReader));
+  if (reader == NULL) {
+    return NULL;
+  }
+  reader->dataset = -1;
+  reader->num_threads = num_threads;
+  H5E_BEGIN_TRY {
+    reader->file = H5Fopen(file_name, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (reader->file >= 0) {
+      reader->dataset = H5Dopen2(reader->file, var_name, H5P_DEFAULT);
+    }
+  }
+  H5E_END_TRY;
+  if (reader->file < 0 || reader->dataset < 0 ||
+      !InspectLayout(reader, file_name, var_name)) {
+    if (reader->dataset >= 0) {
+      H5Dclose(reader->dataset);
+    }
+    if (reader->file >= 0) {
+      H5Fclose(reader->file);
+    }
+    free(reader);
+    return NULL;
+  }
+  // Only used for readahead hints on the chunk byte ranges
+  reader->fd = open(file_name, O_RDONLY);
+  pthread_mutex_init(&reader->lock, NULL);
+  return reader;
+}
+
+size_t ChunkReaderThreads(const ChunkReader *reader) {
+  return reader->num_threads;
+}
+
+void CloseChunkReader(ChunkReader *reader) {
+  if (reader == NULL) {
+    return;
+  }
+  pthread_mutex_destroy(&reader->lock);
+  if (reader->fd != -1) {
+    close(reader->fd);
+  }
+  H5Dclose(reader->dataset);
+  H5Fclose(reader->file);
+  free(reader);
+}
+
+// Runs the filter pipeline backwards over a raw chunk. The result ends up
+// in either buffer, which is returned.
+static unsigned char *DecodeChunk(const ChunkReader *reader, uint32_t mask,
+                                  unsigned char *raw, size_t raw_size,
+                                  unsigned char *scratch) {
+  unsigned char *current = raw;
+  size_t current_size = raw_size;
+  unsigned char *other = scratch;
+  for (size_t f = reader->num_filters; f-- > 0;) {
+    if (mask & (1u << f)) {
+      continue;
+    }
+    if (reader->filters[f] == H5Z_FILTER_DEFLATE) {
+      uLongf inflated = (uLongf)reader->chunk_bytes;
+      if (uncompress(other, &inflated, current, (uLong)current_size) != Z_OK) {
+        return NULL;
+      }
+      current_size = (size_t)inflated;
+    } else {
+      UnshuffleBytes(current, current_size, sizeof(float), other);
+    }
+    unsigned char *swap = current;
+    current = other;
+    other = swap;
+  }
+  return current_size == reader->chunk_bytes ? current : NULL;
+}
+
+static void ScatterChunk(const ChunkReader *reader, const hsize_t *origin,
+                         const float *chunk, Hyperslab slab, float *dest) {
+  size_t low[3];
+  size_t high[3];
+  for (size_t k = 0; k < 3; ++k) {
+    low[k] = slab.corner.shape[k] > origin[k] ? slab.corner.shape[k]
+                                              : (size_t)origin[k];
+    high[k] = slab.corner.shape[k] + slab.edges.shape[k];
+    if (origin[k] + reader->chunk_dims[k] < high[k]) {
+      high[k] = origin[k] + reader->chunk_dims[k];
+    }
+  }
+  size_t run = high[2] - low[2];
+  for (size_t d = low[0]; d < high[0]; ++d) {
+    for (size_t y = low[1]; y < high[1]; ++y) {
+      const float *source =
+          &chunk[(((d - origin[0]) * reader->chunk_dims[1]) + (y - origin[1])) *
+                     reader->chunk_dims[2] +
+                 (low[2] - origin[2])];
+      float *target = &dest[HyperslabValueIndex(
+          slab, Position(d - slab.corner.day, low[2] - slab.corner.x,
+                         y - slab.corner.y))];
+      memcpy(target, source, sizeof(float) * run);
+    }
+  }
+}
+
+static void *ChunkWorker(void *arg) {
+  ChunkJob *job = (ChunkJob *)arg;
+  ChunkReader *reader = job->reader;
+  size_t raw_capacity = reader->chunk_bytes;
+  unsigned char *raw = (unsigned char *)malloc(raw_capacity);
+  unsigned char *scratch = (unsigned char *)malloc(reader->chunk_bytes);
+  float *fill = NULL;
+  int failed = raw == NULL || scratch == NULL;
+  while (!failed) {
+    hsize_t origin[3];
+    hsize_t raw_size = 0;
+    uint32_t mask = 0;
+    pthread_mutex_lock(&reader->lock);
+    if (job->failed || job->next_chunk == job->num_chunks) {
+      pthread_mutex_unlock(&reader->lock);
+      break;
+    }
+    size_t c = job->next_chunk++;
+    origin[2] = (job->first[2] + (c % job->count[2])) * reader->chunk_dims[2];
+    c /= job->count[2];
+    origin[1] = (job->first[1] + (c % job->count[1])) * reader->chunk_dims[1];
+    origin[0] = (job->first[0] + (c / job->count[1])) * reader->chunk_dims[0];
+    // Chunks which were never written have no address, where asking for
+    // their storage size fails with some versions of HDF5
+    unsigned int filter_mask;
+    haddr_t address;
+    if (H5Dget_chunk_info_by_coord(reader->dataset, origin, &filter_mask,
+                                   &address, &raw_size) < 0) {
+      failed = 1;
+    } else if (address == HADDR_UNDEF) {
+      raw_size = 0;
+    } else if (raw_size > raw_capacity) {
+      unsigned char *larger = (unsigned char *)realloc(raw, raw_size);
+      if (larger == NULL) {
+        failed = 1;
+      } else {
+        raw = larger;
+        raw_capacity = raw_size;
+      }
+    }
+    if (!failed && raw_size > 0 &&
+        H5Dread_chunk(reader->dataset, H5P_DEFAULT, origin, &mask, raw) < 0) {
+      failed = 1;
+    }
+    pthread_mutex_unlock(&reader->lock);
+    if (failed) {
+      break;
+    }
+    const float *values;
+    if (raw_size == 0) {
+      // Chunks which were never written hold the fill value
+      if (fill == NULL) {
+        size_t n = reader->chunk_bytes / sizeof(float);
+        fill = (float *)malloc(reader->chunk_bytes);
+        if (fill == NULL) {
+          failed = 1;
+          break;
+        }
+        for (size_t i = 0; i < n; ++i) {
+          fill[i] = reader->fill_value;
+        }
+      }
+      values = fill;
+    } else {
+      values = (const float *)DecodeChunk(reader, mask, raw, (size_t)raw_size,
+                                          scratch);
+      if (values == NULL) {
+        failed = 1;
+        break;
+      }
+    }
+    ScatterChunk(reader, origin, values, job->slab, job->dest);
+  }
+  if (failed) {
+    pthread_mutex_lock(&reader->lock);
+    job->failed = 1;
+    pthread_mutex_unlock(&reader->lock);
+  }
+  free(fill);
+  free(scratch);
+  free(raw);
+  return NULL;
+}
+
+static void CoveringChunks(const ChunkReader *reader, Hyperslab slab,
+                           ChunkJob *job) {
+  job->num_chunks = 1;
+  for (size_t k = 0; k < 3; ++k) {
+    hsize_t last = (slab.corner.shape[k] + slab.edges.shape[k] - 1) /
+                   reader->chunk_dims[k];
+    job->first[k] = slab.corner.shape[k] / reader->chunk_dims[k];
+    job->count[k] = last - job->first[k] + 1;
+    job->num_chunks *= job->count[k];
+  }
+}
+
+// Asks the kernel to start reading the stored chunks of a slab. Chunks
+// which follow each other in the file are merged into one range.
+int AdviseChunkedHyperslab(ChunkReader *reader, Hyperslab slab) {
+  if (reader->fd == -1 || slab.flat_size == 0) {
+    return 1;
+  }
+  ChunkJob job;
+  CoveringChunks(reader, slab, &job);
+  off_t range_start = 0;
+  off_t range_end = 0;
+  pthread_mutex_lock(&reader->lock);
+  for (size_t c = 0; c < job.num_chunks; ++c) {
+    hsize_t coord[3];
+    size_t rest = c;
+    coord[2] = (job.first[2] + (rest % job.count[2])) * reader->chunk_dims[2];
+    rest /= job.count[2];
+    coord[1] = (job.first[1] + (rest % job.count[1])) * reader->chunk_dims[1];
+    coord[0] = (job.first[0] + (rest / job.count[1])) * reader->chunk_dims[0];
+    unsigned int mask;
+    haddr_t address;
+    hsize_t size;
+    if (H5Dget_chunk_info_by_coord(reader->dataset, coord, &mask, &address,
+                                   &size) < 0 ||
+        address == HADDR_UNDEF) {
+      continue;
+    }
+    if ((off_t)address != range_end) {
+      if (range_end > range_start) {
+        posix_fadvise(reader->fd, range_start, range_end - range_start,
+                      POSIX_FADV_WILLNEED);
+      }
+      range_start = (off_t)address;
+    }
+    range_end = (off_t)(address + size);
+  }
+  pthread_mutex_unlock(&reader->lock);
+  if (range_end > range_start) {
+    posix_fadvise(reader->fd, range_start, range_end - range_start,
+                  POSIX_FADV_WILLNEED);
+  }
+  return 0;
+}
+
+int ReadChunkedHyperslab(ChunkReader *reader, Hyperslab slab, float *dest) {
+  ChunkJob job = {.reader = reader,
+                  .slab = slab,
+                  .dest = dest,
+                  .num_chunks = 1,
+                  .next_chunk = 0,
+                  .failed = 0};
+  if (slab.flat_size == 0) {
+    return 0;
+  }
+  CoveringChunks(reader, slab, &job);
+  size_t num_threads = reader->num_threads == 0 ? 1 : reader->num_threads;
+  if (num_threads > job.num_chunks) {
+    num_threads = job.num_chunks;
+  }
+  pthread_t threads[num_threads];
+  size_t started = 0;
+  for (; started + 1 < num_threads; ++started) {
+    if (pthread_create(&threads[started], NULL, ChunkWorker, &job)) {
+      break;
+    }
+  }
+  // The calling thread is one of the workers
+  ChunkWorker(&job);
+  for (size_t t = 0; t < started; ++t) {
+    pthread_join(threads[t], NULL);
+  }
+  if (job.failed) {
+    fprintf(stderr, "error: unable to decode the chunks of the slab at %zu, "
+                    "%zu, %zu\n",
+            slab.corner.day, slab.corner.x, slab.corner.y);
+    return 1;
+  }
+  return 0;
+}
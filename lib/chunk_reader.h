@@ -0,0 +1,20 @@
+#ifndef WTH_CHUNK_READER_H_
+#define WTH_CHUNK_READER_H_
+#include <stddef.h>
+
+#include "hyperslab.h"
+
+// Reads deflate/shuffle compressed chunks of a (time, lat, lon) float
+// variable straight from HDF5 and inflates them on a pool of threads. A
+// reader without threads is only used for readahead hints.
+typedef struct ChunkReader_ ChunkReader;
+
+ChunkReader *OpenChunkReader(const char *file_name, const char *var_name,
+                             size_t num_threads);
+int ReadChunkedHyperslab(ChunkReader *reader, Hyperslab slab, float *dest);
+int AdviseChunkedHyperslab(ChunkReader *reader, Hyperslab slab);
+size_t ChunkReaderThreads(const ChunkReader *reader);
+void CloseChunkReader(ChunkReader *reader);
+void UnshuffleBytes(const unsigned char *source, size_t size,
+                    size_t element_size, unsigned char *dest);
+#endif // WTH_CHUNK_READER_H_
@@ -1,4 +1,6 @@
+#include <glob.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -20,15 +22,119 @@ static char *GetDirectoryString(const char *directory) {
   string_size = strlen(directory);
   if (directory[string_size - 1] != '/') {
     string_size += 1;
-    final_directory = (char *)malloc(string_size);
+    final_directory = (char *)malloc(string_size + 1);
     size_t size = snprintf(final_directory, string_size + 1, "%s/", directory);
   } else {
-    final_directory = (char *)malloc(string_size);
-    strncpy(final_directory, directory, string_size);
+    final_directory = (char *)malloc(string_size + 1);
+    strncpy(final_directory, directory, string_size + 1);
   }
   return final_directory;
 }
 
+// Sets the files of a mapping from its "file": a path, a glob pattern
+// matching the files of one time axis in the order of their names, or an
+// array of paths in time order. The first file becomes file_name and the
+// others its parts.
+static int ParseMappingFiles(json_t *file, FileConfig *mapping) {
+  mapping->file_name = NULL;
+  mapping->parts = NULL;
+  mapping->num_parts = 0;
+  if (file == NULL) {
+    return 0;
+  }
+  const char **names = NULL;
+  size_t num_names = 0;
+  glob_t matches;
+  int globbed = 0;
+  if (json_is_string(file) && strpbrk(json_string_value(file), "*?[") != NULL) {
+    if (glob(json_string_value(file), 0, NULL, &matches) != 0) {
+      fprintf(stderr, "error: no files match %s\n", json_string_value(file));
+      return 1;
+    }
+    globbed = 1;
+    names = (const char **)matches.gl_pathv;
+    num_names = matches.gl_pathc;
+  } else if (json_is_string(file)) {
+    mapping->file_name = strdup(json_string_value(file));
+    return mapping->file_name == NULL;
+  } else if (json_is_array(file) && json_array_size(file) > 0) {
+    num_names = json_array_size(file);
+    names = (const char **)malloc(sizeof(char *) * num_names);
+    if (names == NULL) {
+      return 1;
+    }
+    for (size_t i = 0; i < num_names; ++i) {
+      names[i] = json_string_value(json_array_get(file, i));
+      if (names[i] == NULL) {
+        fprintf(stderr, "error: file #%zu of a mapping is not a string\n",
+                i + 1);
+        free(names);
+        return 1;
+      }
+    }
+  } else {
+    fprintf(stderr, "error: file is not a path, a pattern or a list of "
+                    "paths\n");
+    return 1;
+  }
+  int status = 0;
+  mapping->file_name = strdup(names[0]);
+  if (num_names > 1) {
+    mapping->parts = (char **)calloc(num_names - 1, sizeof(char *));
+    mapping->num_parts = mapping->parts == NULL ? 0 : num_names - 1;
+    status = mapping->parts == NULL;
+    for (size_t i = 0; i < mapping->num_parts; ++i) {
+      mapping->parts[i] = strdup(names[i + 1]);
+      status |= mapping->parts[i] == NULL;
+    }
+  }
+  status |= mapping->file_name == NULL;
+  if (globbed) {
+    globfree(&matches);
+  } else {
+    free(names);
+  }
+  return status;
+}
+
+// Sets the files of the other models of a mapping from its "members", a
+// list of paths holding the same variable on the same grid and time axis.
+static int ParseMappingMembers(json_t *members, FileConfig *mapping) {
+  mapping->members = NULL;
+  mapping->num_members = 0;
+  if (members == NULL) {
+    return 0;
+  }
+  if (!json_is_array(members) || json_array_size(members) == 0) {
+    fprintf(stderr, "error: members is not a list of paths\n");
+    return 1;
+  }
+  if (mapping->num_parts > 0) {
+    fprintf(stderr, "error: an ensemble cannot continue its time axis in "
+                    "other files\n");
+    return 1;
+  }
+  mapping->members =
+      (char **)calloc(json_array_size(members), sizeof(char *));
+  if (mapping->members == NULL) {
+    return 1;
+  }
+  mapping->num_members = json_array_size(members);
+  for (size_t i = 0; i < mapping->num_members; ++i) {
+    const char *name = json_string_value(json_array_get(members, i));
+    if (name == NULL) {
+      fprintf(stderr, "error: member #%zu of a mapping is not a string\n",
+              i + 1);
+      return 1;
+    }
+    mapping->members[i] = strdup(name);
+    if (mapping->members[i] == NULL) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
 static char *InsertConfigString(json_t *obj, const char *key) {
   if (obj == NULL || key == NULL)
     return NULL;
@@ -49,6 +155,65 @@ static char *InsertConfigString(json_t *obj, const char *key) {
   return v;
 }
 
+// Accepts a byte count with an optional binary K/M/G/T suffix.
+int ParseByteString(const char *text, size_t *bytes) {
+  char *suffix;
+  double value = strtod(text, &suffix);
+  if (suffix == text || value < 0.0) {
+    return 0;
+  }
+  // Each suffix falls through to scale by the smaller ones.
+  double multiplier = 1.0;
+  switch (*suffix) {
+  case 'T':
+  case 't':
+    multiplier *= 1024.0;
+    /* fall through */
+  case 'G':
+  case 'g':
+    multiplier *= 1024.0;
+    /* fall through */
+  case 'M':
+  case 'm':
+    multiplier *= 1024.0;
+    /* fall through */
+  case 'K':
+  case 'k':
+    multiplier *= 1024.0;
+    ++suffix;
+    break;
+  case 'B':
+  case 'b':
+  case '\0':
+    break;
+  default:
+    return 0;
+  }
+  if (*suffix == 'B' || *suffix == 'b') {
+    ++suffix;
+  }
+  if (*suffix != '\0') {
+    return 0;
+  }
+  *bytes = (size_t)(value * multiplier);
+  return 1;
+}
+
+// Accepts a plain byte count or a string with a binary K/M/G/T suffix.
+static int ParseByteSize(const json_t *json_v, size_t *bytes) {
+  if (json_is_integer(json_v)) {
+    if (json_integer_value(json_v) < 0) {
+      return 0;
+    }
+    *bytes = (size_t)json_integer_value(json_v);
+    return 1;
+  }
+  if (!json_is_string(json_v)) {
+    return 0;
+  }
+  return ParseByteString(json_string_value(json_v), bytes);
+}
+
 static int ValidLonLatShape(const json_t *arr) {
   if (!json_is_array(arr)) {
     fprintf(stderr, "error: Longitude/Latitude point is not an array.\n");
@@ -135,23 +300,24 @@ static int ValidModeShape(const json_t *obj, const int mode) {
   return 0;
 }
 
-Config *LoadConfig(const char *source) {
-  json_t *root;
-  json_error_t error;
+// Builds the configuration from a parsed JSON object and releases it. The
+// directories are only checked to exist when check_paths is set.
+static Config *ParseConfig(json_t *root, int check_paths) {
   Config *config = NULL;
 
-  root = json_load_file(source, JSON_REJECT_DUPLICATES, &error);
-
-  if (!root) {
-    fprintf(stderr, "error: [line %d] %s\n", error.line, error.text);
-    return NULL;
-  }
   if (!json_is_object(root)) {
     fprintf(stderr, "error: root is not a JSON object\n");
     json_decref(root);
     return NULL;
   }
-  json_t *start_year, *output_dir, *mode_finder, *mappings;
+  json_t *start_year, *output_dir, *mode_finder, *mappings, *perf_counters;
+  json_t *max_memory, *point_major, *cache_dir, *decompress_threads;
+  json_t *prefetch, *compression_level, *compress_threads;
+  json_t *manifest, *manifest_format, *quantize, *node_shared, *summary;
+  json_t *read_strategy, *max_file_creates, *max_file_creates_per_node;
+  json_t *progress_dir, *progress_format, *progress_interval, *progress_report;
+  json_t *ensemble_statistic;
+  size_t max_memory_per_rank = 0;
   int mode = 0;
   start_year = json_object_get(root, "start_year");
   if (!json_is_integer(start_year)) {
@@ -179,7 +345,7 @@ Config *LoadConfig(const char *source) {
     return NULL;
   }
 
-  if (!DirectoryExists(json_string_value(output_dir))) {
+  if (check_paths && !DirectoryExists(json_string_value(output_dir))) {
     fprintf(stderr, "error: output_dir does not exist\n");
     json_decref(root);
     return NULL;
@@ -218,6 +384,199 @@ Config *LoadConfig(const char *source) {
   }
   size_t mappings_size = json_array_size(mappings);
 
+  perf_counters = json_object_get(root, "perf_counters");
+  if (perf_counters != NULL && !json_is_boolean(perf_counters)) {
+    fprintf(stderr, "error: perf_counters is not a boolean\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  max_memory = json_object_get(root, "max_memory_per_rank");
+  if (max_memory != NULL &&
+      !ParseByteSize(max_memory, &max_memory_per_rank)) {
+    fprintf(stderr, "error: max_memory_per_rank is not a valid size\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  point_major = json_object_get(root, "point_major");
+  if (point_major != NULL && !json_is_boolean(point_major)) {
+    fprintf(stderr, "error: point_major is not a boolean\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  cache_dir = json_object_get(root, "cache_dir");
+  if (cache_dir != NULL && !json_is_string(cache_dir)) {
+    fprintf(stderr, "error: cache_dir is not a string\n");
+    json_decref(root);
+    return NULL;
+  }
+  if (check_paths && cache_dir != NULL &&
+      !DirectoryExists(json_string_value(cache_dir))) {
+    fprintf(stderr, "error: cache_dir does not exist\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  decompress_threads = json_object_get(root, "decompress_threads");
+  if (decompress_threads != NULL &&
+      (!json_is_integer(decompress_threads) ||
+       json_integer_value(decompress_threads) < 0)) {
+    fprintf(stderr, "error: decompress_threads is not a positive integer\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  prefetch = json_object_get(root, "prefetch");
+  if (prefetch != NULL && !json_is_boolean(prefetch)) {
+    fprintf(stderr, "error: prefetch is not a boolean\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  compression_level = json_object_get(root, "compression_level");
+  if (compression_level != NULL &&
+      (!json_is_integer(compression_level) ||
+       json_integer_value(compression_level) < 0 ||
+       json_integer_value(compression_level) > 9)) {
+    fprintf(stderr,
+            "error: compression_level is not an integer from 0 to 9\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  compress_threads = json_object_get(root, "compress_threads");
+  if (compress_threads != NULL &&
+      (!json_is_integer(compress_threads) ||
+       json_integer_value(compress_threads) < 0)) {
+    fprintf(stderr, "error: compress_threads is not a positive integer\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  manifest = json_object_get(root, "manifest");
+  if (manifest != NULL && !json_is_string(manifest)) {
+    fprintf(stderr, "error: manifest is not a string\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  summary = json_object_get(root, "summary");
+  if (summary != NULL && !json_is_string(summary)) {
+    fprintf(stderr, "error: summary is not a string\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  manifest_format = json_object_get(root, "manifest_format");
+  if (manifest_format != NULL &&
+      (!json_is_string(manifest_format) ||
+       (strcmp(json_string_value(manifest_format), "csv") != 0 &&
+        strcmp(json_string_value(manifest_format), "binary") != 0))) {
+    fprintf(stderr, "error: manifest_format is not \"csv\" or \"binary\"\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  quantize = json_object_get(root, "quantize");
+  if (quantize != NULL && !json_is_boolean(quantize)) {
+    fprintf(stderr, "error: quantize is not a boolean\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  node_shared = json_object_get(root, "node_shared");
+  if (node_shared != NULL && !json_is_boolean(node_shared)) {
+    fprintf(stderr, "error: node_shared is not a boolean\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  read_strategy = json_object_get(root, "read_strategy");
+  if (read_strategy != NULL &&
+      (!json_is_string(read_strategy) ||
+       (strcmp(json_string_value(read_strategy), "tiles") != 0 &&
+        strcmp(json_string_value(read_strategy), "time") != 0 &&
+        strcmp(json_string_value(read_strategy), "variable") != 0))) {
+    fprintf(stderr, "error: read_strategy is not \"tiles\", \"time\" or "
+                    "\"variable\"\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  max_file_creates = json_object_get(root, "max_file_creates");
+  if (max_file_creates != NULL &&
+      (!json_is_integer(max_file_creates) ||
+       json_integer_value(max_file_creates) < 0)) {
+    fprintf(stderr, "error: max_file_creates is not a positive integer\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  max_file_creates_per_node =
+      json_object_get(root, "max_file_creates_per_node");
+  if (max_file_creates_per_node != NULL &&
+      (!json_is_integer(max_file_creates_per_node) ||
+       json_integer_value(max_file_creates_per_node) < 0)) {
+    fprintf(stderr,
+            "error: max_file_creates_per_node is not a positive integer\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  progress_dir = json_object_get(root, "progress_dir");
+  if (progress_dir != NULL && !json_is_string(progress_dir)) {
+    fprintf(stderr, "error: progress_dir is not a string\n");
+    json_decref(root);
+    return NULL;
+  }
+  if (check_paths && progress_dir != NULL &&
+      !DirectoryExists(json_string_value(progress_dir))) {
+    fprintf(stderr, "error: progress_dir does not exist\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  progress_format = json_object_get(root, "progress_format");
+  if (progress_format != NULL &&
+      (!json_is_string(progress_format) ||
+       (strcmp(json_string_value(progress_format), "heartbeat") != 0 &&
+        strcmp(json_string_value(progress_format), "prometheus") != 0))) {
+    fprintf(stderr,
+            "error: progress_format is not \"heartbeat\" or \"prometheus\"\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  progress_interval = json_object_get(root, "progress_interval");
+  if (progress_interval != NULL &&
+      (!json_is_number(progress_interval) ||
+       json_number_value(progress_interval) <= 0.0)) {
+    fprintf(stderr, "error: progress_interval is not a positive number\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  progress_report = json_object_get(root, "progress_report");
+  if (progress_report != NULL && !json_is_boolean(progress_report)) {
+    fprintf(stderr, "error: progress_report is not a boolean\n");
+    json_decref(root);
+    return NULL;
+  }
+
+  ensemble_statistic = json_object_get(root, "ensemble_statistic");
+  if (ensemble_statistic != NULL &&
+      (!json_is_string(ensemble_statistic) ||
+       (strcmp(json_string_value(ensemble_statistic), "mean") != 0 &&
+        strcmp(json_string_value(ensemble_statistic), "min") != 0 &&
+        strcmp(json_string_value(ensemble_statistic), "max") != 0))) {
+    fprintf(stderr, "error: ensemble_statistic is not \"mean\", \"min\" or "
+                    "\"max\"\n");
+    json_decref(root);
+    return NULL;
+  }
+
   /* Start actually loading in the config once everything is checked */
   config = (Config *)malloc(sizeof(Config));
 
@@ -225,13 +584,71 @@ Config *LoadConfig(const char *source) {
     json_decref(root);
     return NULL;
   }
+  config->name = InsertConfigString(root, "name");
   config->num_mappings = mappings_size;
   config->num_points = mode_size;
   config->start_year = json_integer_value(start_year);
   config->output_dir = GetDirectoryString(json_string_value(output_dir));
   config->mode = mode;
+  config->perf_counters = json_is_true(perf_counters);
+  config->max_memory_per_rank = max_memory_per_rank;
+  config->point_major = !json_is_false(point_major);
+  config->prefetch = json_is_true(prefetch);
+  config->decompress_threads =
+      decompress_threads == NULL ? 0 : json_integer_value(decompress_threads);
+  config->compression_level =
+      compression_level == NULL ? 0 : json_integer_value(compression_level);
+  config->compress_threads =
+      compress_threads == NULL ? 0 : json_integer_value(compress_threads);
+  config->manifest = InsertConfigString(root, "manifest");
+  config->manifest_format =
+      manifest_format != NULL &&
+              strcmp(json_string_value(manifest_format), "binary") == 0
+          ? manifest_binary
+          : manifest_csv;
+  config->summary = InsertConfigString(root, "summary");
+  config->quantize = json_is_true(quantize);
+  config->node_shared = json_is_true(node_shared);
+  config->max_file_creates =
+      max_file_creates == NULL ? 0 : json_integer_value(max_file_creates);
+  config->max_file_creates_per_node =
+      max_file_creates_per_node == NULL
+          ? 0
+          : json_integer_value(max_file_creates_per_node);
+  config->read_strategy = read_tiles;
+  if (read_strategy != NULL) {
+    if (strcmp(json_string_value(read_strategy), "time") == 0) {
+      config->read_strategy = read_by_time;
+    } else if (strcmp(json_string_value(read_strategy), "variable") == 0) {
+      config->read_strategy = read_by_variable;
+    }
+  }
+  config->progress_dir =
+      progress_dir == NULL
+          ? NULL
+          : GetDirectoryString(json_string_value(progress_dir));
+  config->progress_format =
+      progress_format != NULL &&
+              strcmp(json_string_value(progress_format), "prometheus") == 0
+          ? progress_prometheus
+          : progress_heartbeat;
+  config->progress_interval = progress_interval == NULL
+                                  ? 10.0
+                                  : json_number_value(progress_interval);
+  config->progress_report = json_is_true(progress_report);
+  config->ensemble_statistic = ensemble_mean;
+  if (ensemble_statistic != NULL) {
+    if (strcmp(json_string_value(ensemble_statistic), "min") == 0) {
+      config->ensemble_statistic = ensemble_min;
+    } else if (strcmp(json_string_value(ensemble_statistic), "max") == 0) {
+      config->ensemble_statistic = ensemble_max;
+    }
+  }
+  config->cache_dir = cache_dir == NULL
+                          ? NULL
+                          : GetDirectoryString(json_string_value(cache_dir));
   config->points = (LonLat *)malloc(sizeof(LonLat) * mode_size);
-  config->mappings = (FileConfig *)malloc(sizeof(FileConfig) * mappings_size);
+  config->mappings = (FileConfig *)calloc(mappings_size, sizeof(FileConfig));
 
   if (mode == 0) {
     config->points[0].longitude = -LONGITUDE_OFFSET;
@@ -259,17 +676,34 @@ Config *LoadConfig(const char *source) {
   }
 
   size_t index;
+  size_t file_mappings = 0;
   json_t *value;
   json_array_foreach(mappings, index, value) {
-    config->mappings[index].file_name = InsertConfigString(value, "file");
+    if (ParseMappingFiles(json_object_get(value, "file"),
+                          &config->mappings[index])) {
+      fprintf(stderr, "error: cannot use the files of mapping #%zu\n",
+              index + 1);
+      goto cleanup;
+    }
+    if (ParseMappingMembers(json_object_get(value, "members"),
+                            &config->mappings[index])) {
+      fprintf(stderr, "error: cannot use the members of mapping #%zu\n",
+              index + 1);
+      goto cleanup;
+    }
     config->mappings[index].dssat_var = InsertConfigString(value, "dssatVar");
     config->mappings[index].netcdf_var = InsertConfigString(value, "netcdfVar");
     config->mappings[index].source_unit =
         InsertConfigString(value, "sourceUnit");
     config->mappings[index].target_unit =
         InsertConfigString(value, "targetUnit");
+    config->mappings[index].expression =
+        InsertConfigString(value, "expression");
+    config->mappings[index].derived = NULL;
     config->mappings[index].netcdf_id = -1;
     config->mappings[index].is_temp = 0;
+    config->mappings[index].output =
+        !json_is_false(json_object_get(value, "output"));
     if (config->mappings[index].dssat_var != NULL) {
       if (strlen(config->mappings[index].dssat_var) == 4) {
         if (strncmp("TMIN", config->mappings[index].dssat_var, 4) == 0) {
@@ -279,6 +713,56 @@ Config *LoadConfig(const char *source) {
         }
       }
     }
+    if (config->mappings[index].expression != NULL &&
+        json_object_get(value, "file") != NULL) {
+      fprintf(stderr,
+              "error: mapping #%zu is derived and reads no file, remove "
+              "file\n",
+              index + 1);
+      goto cleanup;
+    }
+    if (config->mappings[index].expression != NULL &&
+        (config->mappings[index].source_unit != NULL ||
+         config->mappings[index].target_unit != NULL)) {
+      fprintf(stderr,
+              "error: mapping #%zu is derived and uses the units of its "
+              "inputs, remove sourceUnit/targetUnit\n",
+              index + 1);
+      goto cleanup;
+    }
+    if (config->mappings[index].expression != NULL &&
+        config->mappings[index].num_members > 0) {
+      fprintf(stderr,
+              "error: mapping #%zu is derived and cannot have members\n",
+              index + 1);
+      goto cleanup;
+    }
+    if (config->mappings[index].expression != NULL) {
+      // Derived variables can only refer to the mappings listed before them,
+      // which keeps the evaluation order simple and rules out cycles.
+      const char *names[index + 1];
+      for (size_t i = 0; i < index; ++i) {
+        names[i] = config->mappings[i].dssat_var;
+      }
+      config->mappings[index].derived = CompileExpression(
+          config->mappings[index].expression, names, index);
+      if (config->mappings[index].derived == NULL) {
+        goto cleanup;
+      }
+    } else if (config->mappings[index].file_name == NULL ||
+               config->mappings[index].netcdf_var == NULL) {
+      fprintf(stderr,
+              "error: mapping #%zu needs either file and netcdfVar or an "
+              "expression\n",
+              index + 1);
+      goto cleanup;
+    } else {
+      ++file_mappings;
+    }
+  }
+  if (file_mappings == 0) {
+    fprintf(stderr, "error: at least one mapping must read a NetCDF file\n");
+    goto cleanup;
   }
   json_decref(root);
   return config;
@@ -289,10 +773,147 @@ cleanup:
   return NULL;
 }
 
+// Parses a configuration file, or the text of one when source is NULL.
+static json_t *LoadJson(const char *source, const char *text) {
+  json_error_t error;
+  json_t *root = source != NULL
+                     ? json_load_file(source, JSON_REJECT_DUPLICATES, &error)
+                     : json_loads(text, JSON_REJECT_DUPLICATES, &error);
+  if (!root) {
+    fprintf(stderr, "error: [line %d] %s\n", error.line, error.text);
+  }
+  return root;
+}
+
+Config *LoadConfig(const char *source) {
+  json_t *root = LoadJson(source, NULL);
+  return root == NULL ? NULL : ParseConfig(root, 1);
+}
+
+Config *LoadConfigText(const char *text, int check_paths) {
+  json_t *root = LoadJson(NULL, text);
+  return root == NULL ? NULL : ParseConfig(root, check_paths);
+}
+
+// Reads a whole configuration file so it can be parsed elsewhere.
+char *ReadConfigText(const char *source) {
+  FILE *fh = fopen(source, "rb");
+  if (fh == NULL) {
+    fprintf(stderr, "error: cannot open %s\n", source);
+    return NULL;
+  }
+  char *text = NULL;
+  long size = -1;
+  if (fseek(fh, 0, SEEK_END) == 0 && (size = ftell(fh)) >= 0 &&
+      fseek(fh, 0, SEEK_SET) == 0) {
+    text = (char *)malloc(size + 1);
+  }
+  if (text == NULL || fread(text, 1, size, fh) != (size_t)size) {
+    fprintf(stderr, "error: cannot read %s\n", source);
+    free(text);
+    fclose(fh);
+    return NULL;
+  }
+  text[size] = '\0';
+  fclose(fh);
+  return text;
+}
+
+// A batch file holds the settings shared by all scenarios next to a
+// "scenarios" array. Each scenario is the shared object updated with its
+// own keys, so any option can be overridden per scenario.
+static Config **ParseBatchConfig(json_t *root, int check_paths,
+                                 size_t *num_configs) {
+  json_t *scenarios = json_object_get(root, "scenarios");
+  if (!json_is_array(scenarios) || json_array_size(scenarios) == 0) {
+    fprintf(stderr, "error: root->scenarios is not a non-empty array\n");
+    json_decref(root);
+    return NULL;
+  }
+  json_t *shared = json_deep_copy(root);
+  json_object_del(shared, "scenarios");
+  size_t size = json_array_size(scenarios);
+  Config **configs = (Config **)calloc(size, sizeof(Config *));
+  if (configs == NULL || shared == NULL) {
+    free(configs);
+    json_decref(shared);
+    json_decref(root);
+    return NULL;
+  }
+  size_t index;
+  json_t *value;
+  json_array_foreach(scenarios, index, value) {
+    json_t *scenario = json_deep_copy(shared);
+    if (!json_is_object(value) || json_object_update(scenario, value)) {
+      fprintf(stderr, "error: scenario #%zu is not a JSON object\n",
+              index + 1);
+      json_decref(scenario);
+      goto cleanup;
+    }
+    configs[index] = ParseConfig(scenario, check_paths);
+    if (configs[index] == NULL) {
+      fprintf(stderr, "error: invalid scenario #%zu\n", index + 1);
+      goto cleanup;
+    }
+    if (configs[index]->name == NULL) {
+      char name[32];
+      snprintf(name, sizeof(name), "scenario-%zu", index + 1);
+      configs[index]->name = strdup(name);
+    }
+  }
+  json_decref(shared);
+  json_decref(root);
+  *num_configs = size;
+  return configs;
+
+cleanup:
+  FreeBatchConfig(configs, size);
+  json_decref(shared);
+  json_decref(root);
+  return NULL;
+}
+
+Config **LoadBatchConfig(const char *source, size_t *num_configs) {
+  json_t *root = LoadJson(source, NULL);
+  return root == NULL ? NULL : ParseBatchConfig(root, 1, num_configs);
+}
+
+Config **LoadBatchConfigText(const char *text, int check_paths,
+                             size_t *num_configs) {
+  json_t *root = LoadJson(NULL, text);
+  return root == NULL ? NULL
+                      : ParseBatchConfig(root, check_paths, num_configs);
+}
+
+void FreeBatchConfig(Config **configs, size_t num_configs) {
+  if (configs != NULL) {
+    for (size_t i = 0; i < num_configs; ++i) {
+      FreeConfig(configs[i]);
+    }
+    free(configs);
+  }
+}
+
 void FreeConfig(Config *config) {
   /* Prototype release of nested configuration array */
   if (config != NULL) {
     if (config->mappings != NULL) {
+      for (size_t i = 0; i < config->num_mappings; ++i) {
+        FreeExpression(config->mappings[i].derived);
+        config->mappings[i].derived = NULL;
+        for (size_t k = 0; k < config->mappings[i].num_parts; ++k) {
+          free(config->mappings[i].parts[k]);
+        }
+        free(config->mappings[i].parts);
+        config->mappings[i].parts = NULL;
+        config->mappings[i].num_parts = 0;
+        for (size_t k = 0; k < config->mappings[i].num_members; ++k) {
+          free(config->mappings[i].members[k]);
+        }
+        free(config->mappings[i].members);
+        config->mappings[i].members = NULL;
+        config->mappings[i].num_members = 0;
+      }
       free(config->mappings);
       config->mappings = NULL;
     }
@@ -300,6 +921,16 @@ void FreeConfig(Config *config) {
       free(config->points);
       config->points = NULL;
     }
+    free(config->cache_dir);
+    config->cache_dir = NULL;
+    free(config->name);
+    config->name = NULL;
+    free(config->manifest);
+    config->manifest = NULL;
+    free(config->summary);
+    config->summary = NULL;
+    free(config->progress_dir);
+    config->progress_dir = NULL;
     free(config);
     config = NULL;
   }
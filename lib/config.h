@@ -2,28 +2,75 @@
 #define WTH_CONFIG_H
 #include <stddef.h>
 
+#include "expression.h"
 #include "location.h"
 
+// Missing value of derived variables, matching the GGCMI missing_value.
+#define DERIVED_FILL_VALUE 1.0e20f
+
+enum { manifest_csv, manifest_binary };
+enum { read_tiles, read_by_time, read_by_variable };
+enum { progress_heartbeat, progress_prometheus };
+enum { ensemble_mean, ensemble_min, ensemble_max };
+
 typedef struct FileConfig_ {
   char *file_name;
+  // Files continuing the time axis of file_name, in order
+  char **parts;
+  size_t num_parts;
+  // Files of the other models of an ensemble, reduced with the first one
+  char **members;
+  size_t num_members;
   char *netcdf_var;
   char *dssat_var;
   char *source_unit;
   char *target_unit;
+  char *expression;
+  Expression *derived;
   int netcdf_id;
   int is_temp;
+  int output;
 } FileConfig;
 
 typedef struct Config_ {
+  char *name;
   int start_year;
   char *output_dir;
   size_t num_mappings;
   size_t num_points;
   int mode; // 0=global, 1=extent, 2=points
+  int perf_counters;
+  size_t max_memory_per_rank;
+  int point_major;
+  char *cache_dir;
+  size_t decompress_threads;
+  int prefetch;
+  int compression_level;
+  size_t compress_threads;
+  char *manifest;
+  int manifest_format;
+  char *summary;
+  int quantize;
+  int node_shared;
+  int read_strategy;
+  size_t max_file_creates;
+  size_t max_file_creates_per_node;
+  char *progress_dir;
+  int progress_format;
+  double progress_interval;
+  int progress_report;
+  int ensemble_statistic;
   LonLat *points;
   FileConfig *mappings;
 } Config;
 
 Config *LoadConfig(const char *source);
+Config *LoadConfigText(const char *text, int check_paths);
+char *ReadConfigText(const char *source);
+Config **LoadBatchConfig(const char *source, size_t *num_configs);
+Config **LoadBatchConfigText(const char *text, int check_paths,
+                             size_t *num_configs);
+void FreeBatchConfig(Config **configs, size_t num_configs);
 void FreeConfig(Config *config);
+int ParseByteString(const char *text, size_t *bytes);
 #endif
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mpi.h>
+
+#include "dataset.h"
+#include "hyperslab.h"
+#include "io.h"
+#include "tile_cache.h"
+#include "unit_util.h"
+
+struct Dataset_ {
+  Config *config;
+  NetCdfInfo *info;
+  ConverterContainer *converters;
+  DateTable dates;
+  TileCache cache;
+  size_t tile_side;
+  size_t days;
+  int files_open;
+  int owns_units;
+};
+
+// Opens the files of the configuration on MPI_COMM_SELF, so every process
+// of the caller can query on its own. MPI has to be initialized, and the
+// configuration has to outlive the dataset.
+Dataset *OpenDataset(Config *config, size_t tile_side, size_t cache_tiles) {
+  int initialized;
+  MPI_Initialized(&initialized);
+  if (!initialized) {
+    fprintf(stderr, "error: MPI has to be initialized to open a dataset\n");
+    return NULL;
+  }
+  Dataset *dataset = (Dataset *)calloc(1, sizeof(Dataset));
+  if (dataset == NULL) {
+    fprintf(stderr, "error: unable to allocate the dataset\n");
+    return NULL;
+  }
+  dataset->config = config;
+  dataset->tile_side = tile_side > 0 ? tile_side : DATASET_TILE_SIDE;
+  dataset->info = (NetCdfInfo *)calloc(config->num_mappings,
+                                       sizeof(NetCdfInfo));
+  dataset->converters = (ConverterContainer *)calloc(
+      config->num_mappings, sizeof(ConverterContainer));
+  if (dataset->info == NULL || dataset->converters == NULL) {
+    fprintf(stderr, "error: unable to allocate the dataset\n");
+    CloseDataset(dataset);
+    return NULL;
+  }
+  dataset->files_open = 1;
+  if (OpenAllDataFiles(config, MPI_COMM_SELF, MPI_INFO_NULL) !=
+          (int)config->num_mappings ||
+      InjectNetCdfInfo(config, dataset->info)) {
+    CloseDataset(dataset);
+    return NULL;
+  }
+  OpenChunkReaders(config, dataset->info);
+  dataset->days = dataset->info[0].time_len;
+
+  if (!UnitSystemLoaded()) {
+    InitUnitSystem();
+    dataset->owns_units = 1;
+  }
+  for (size_t i = 0; i < config->num_mappings; ++i) {
+    if (BuildConverter(config->mappings[i].source_unit,
+                       config->mappings[i].target_unit,
+                       &dataset->converters[i])) {
+      fprintf(stderr, "error: unable to build the converter for %s -> %s\n",
+              config->mappings[i].source_unit, config->mappings[i].target_unit);
+      CloseDataset(dataset);
+      return NULL;
+    }
+    if (dataset->info[i].packed) {
+      PackConverter(&dataset->converters[i], dataset->info[i].scale_factor,
+                    dataset->info[i].add_offset);
+    }
+  }
+
+  char start_date_str[ISODATE_STRING_LEN];
+  if (snprintf(start_date_str, ISODATE_STRING_LEN, "%d-01-01",
+               config->start_year) >= ISODATE_STRING_LEN ||
+      BuildDateTable(start_date_str, dataset->days, &dataset->dates)) {
+    fprintf(stderr, "error: cannot build the calendar from %d\n",
+            config->start_year);
+    CloseDataset(dataset);
+    return NULL;
+  }
+  size_t tile_values = config->num_mappings * dataset->days *
+                       dataset->tile_side * dataset->tile_side;
+  // Without a count of its own the cache fills max_memory_per_rank
+  if (cache_tiles == 0 && config->max_memory_per_rank > 0) {
+    cache_tiles = config->max_memory_per_rank / (sizeof(float) * tile_values);
+    cache_tiles = cache_tiles > 0 ? cache_tiles : 1;
+  }
+  if (InitTileCache(&dataset->cache,
+                    cache_tiles > 0 ? cache_tiles : DATASET_CACHE_TILES,
+                    tile_values)) {
+    CloseDataset(dataset);
+    return NULL;
+  }
+  return dataset;
+}
+
+size_t DatasetDays(const Dataset *dataset) { return dataset->days; }
+
+const DateTable *DatasetDates(const Dataset *dataset) {
+  return &dataset->dates;
+}
+
+size_t DatasetWindowCells(LonLat top_left, LonLat bottom_right) {
+  XY first = LonLatToXY(top_left);
+  XY last = LonLatToXY(bottom_right);
+  if (last.x < first.x || last.y < first.y) {
+    return 0;
+  }
+  return (last.x - first.x + 1) * (last.y - first.y + 1);
+}
+
+// Reads and converts every mapping of a tile into the cache entry, the same
+// way the extraction converts a slab.
+static int LoadTile(Dataset *dataset, TileCacheEntry *entry) {
+  const Config *config = dataset->config;
+  const NetCdfInfo *info = dataset->info;
+  size_t x = entry->tile_x * dataset->tile_side;
+  size_t y = entry->tile_y * dataset->tile_side;
+  size_t x_length = info[0].longitude_len - x;
+  size_t y_length = info[0].latitude_len - y;
+  Hyperslab h = CreateHyperslab(
+      Position(0, x, y),
+      Edges(dataset->days,
+            x_length < dataset->tile_side ? x_length : dataset->tile_side,
+            y_length < dataset->tile_side ? y_length : dataset->tile_side));
+  entry->slab = h;
+  float input_fills[config->num_mappings];
+  const float *inputs[config->num_mappings];
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    input_fills[m] = info[m].fill_value;
+    inputs[m] = &entry->values[m * h.flat_size];
+  }
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    float *values = &entry->values[m * h.flat_size];
+    if (config->mappings[m].derived != NULL) {
+      if (EvaluateExpression(config->mappings[m].derived, inputs,
+                             input_fills, h.flat_size, info[m].fill_value,
+                             values)) {
+        return 1;
+      }
+      continue;
+    }
+    if (ReadHyperslab(&config->mappings[m], &info[m], h, values)) {
+      return 1;
+    }
+    for (size_t i = 0; i < h.flat_size; ++i) {
+      if (values[i] != info[m].fill_value) {
+        values[i] = ConvertValue(&dataset->converters[m], values[i]);
+      }
+    }
+  }
+  return 0;
+}
+
+static int QueryGridCell(Dataset *dataset, XY cell, float *series,
+                         CellSummary *summary) {
+  const Config *config = dataset->config;
+  if (cell.x >= dataset->info[0].longitude_len ||
+      cell.y >= dataset->info[0].latitude_len) {
+    fprintf(stderr, "error: cell [%zu][%zu] is outside of the grid\n",
+            cell.x, cell.y);
+    return 1;
+  }
+  int hit;
+  TileCacheEntry *entry =
+      LookupTile(&dataset->cache, cell.x / dataset->tile_side,
+                 cell.y / dataset->tile_side, &hit);
+  if (!hit && LoadTile(dataset, entry)) {
+    InvalidateTile(entry);
+    return 1;
+  }
+  Hyperslab h = entry->slab;
+  LonLat center = XYToLonLat(cell);
+  summary->longitude = center.longitude;
+  summary->latitude = center.latitude;
+  summary->missing = 0;
+  const float *tmin = NULL;
+  const float *tmax = NULL;
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    float *dest = &series[m * dataset->days];
+    const float *values = &entry->values[m * h.flat_size];
+    for (size_t d = 0; d < dataset->days; ++d) {
+      dest[d] = values[HyperslabValueIndex(
+          h, Position(d, cell.x - h.corner.x, cell.y - h.corner.y))];
+    }
+    if (dest[0] == dataset->info[m].fill_value) {
+      summary->missing = 1;
+    }
+    if (config->mappings[m].is_temp == 1) {
+      tmin = dest;
+    } else if (config->mappings[m].is_temp == 2) {
+      tmax = dest;
+    }
+  }
+  if (summary->missing) {
+    summary->tav = -99.0;
+    summary->amp = -99.0f;
+  } else {
+    SummarizeTemperatures(tmin, tmax, &dataset->dates, &summary->tav,
+                          &summary->amp);
+  }
+  return 0;
+}
+
+// Copies the series of every mapping of a cell into series, mapping after
+// mapping with DatasetDays values each, and summarizes it.
+int QueryCell(Dataset *dataset, LonLat position, float *series,
+              CellSummary *summary) {
+  return QueryGridCell(dataset, LonLatToXY(position), series, summary);
+}
+
+// Queries every cell of a window row after row, the series of each cell
+// following the previous one in series.
+int QueryWindow(Dataset *dataset, LonLat top_left, LonLat bottom_right,
+                float *series, CellSummary *summaries) {
+  XY first = LonLatToXY(top_left);
+  XY last = LonLatToXY(bottom_right);
+  size_t cell_values = dataset->config->num_mappings * dataset->days;
+  size_t c = 0;
+  for (size_t y = first.y; y <= last.y; ++y) {
+    for (size_t x = first.x; x <= last.x; ++x) {
+      if (QueryGridCell(dataset, XYPosition(x, y), &series[c * cell_values],
+                        &summaries[c])) {
+        return 1;
+      }
+      ++c;
+    }
+  }
+  return 0;
+}
+
+void DatasetCacheStats(const Dataset *dataset, size_t *hits, size_t *misses) {
+  *hits = dataset->cache.hits;
+  *misses = dataset->cache.misses;
+}
+
+void CloseDataset(Dataset *dataset) {
+  if (dataset == NULL) {
+    return;
+  }
+  FreeTileCache(&dataset->cache);
+  FreeDateTable(&dataset->dates);
+  if (dataset->converters != NULL) {
+    for (size_t i = 0; i < dataset->config->num_mappings; ++i) {
+      FreeConverterContainer(&dataset->converters[i]);
+    }
+  }
+  if (dataset->files_open) {
+    CloseAllDataFiles(dataset->config, dataset->info);
+  }
+  if (dataset->owns_units) {
+    FreeUnitSystem();
+  }
+  free(dataset->converters);
+  free(dataset->info);
+  free(dataset);
+}
@@ -0,0 +1,38 @@
+#ifndef WTH_DATASET_H_
+#define WTH_DATASET_H_
+#include <stddef.h>
+
+#include "calendar.h"
+#include "config.h"
+#include "location.h"
+
+// Cells per side of the tiles read and cached by a dataset, and the number
+// of tiles kept, when the caller does not choose.
+#define DATASET_TILE_SIDE 16
+#define DATASET_CACHE_TILES 16
+
+// The input files of a configuration opened in the calling process, queried
+// for the converted daily series of cells without writing weather files.
+typedef struct Dataset_ Dataset;
+
+// What a weather file header would hold for a cell. Cells missing data on
+// the first day, which the extraction skips, have no TAV and AMP.
+typedef struct CellSummary_ {
+  double longitude;
+  double latitude;
+  int missing;
+  double tav;
+  float amp;
+} CellSummary;
+
+Dataset *OpenDataset(Config *config, size_t tile_side, size_t cache_tiles);
+size_t DatasetDays(const Dataset *dataset);
+const DateTable *DatasetDates(const Dataset *dataset);
+size_t DatasetWindowCells(LonLat top_left, LonLat bottom_right);
+int QueryCell(Dataset *dataset, LonLat position, float *series,
+              CellSummary *summary);
+int QueryWindow(Dataset *dataset, LonLat top_left, LonLat bottom_right,
+                float *series, CellSummary *summaries);
+void DatasetCacheStats(const Dataset *dataset, size_t *hits, size_t *misses);
+void CloseDataset(Dataset *dataset);
+#endif // WTH_DATASET_H_
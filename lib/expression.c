@@ -0,0 +1,366 @@
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "expression.h"
+
+// Values are evaluated in blocks so the operand stack stays in cache while
+// every op still runs as a tight loop over contiguous floats.
+#define EXPRESSION_BLOCK 512
+
+typedef struct ExpressionParser_ {
+  const char *source;
+  const char *cursor;
+  const char *const *names;
+  size_t num_names;
+  Expression *expression;
+  size_t capacity;
+  size_t depth;
+  int failed;
+} ExpressionParser;
+
+static void parseSum(ExpressionParser *parser);
+
+static void parseError(ExpressionParser *parser, const char *message) {
+  if (!parser->failed) {
+    fprintf(stderr, "error: %s at position %zu in expression \"%s\"\n",
+            message, (size_t)(parser->cursor - parser->source) + 1,
+            parser->source);
+  }
+  parser->failed = 1;
+}
+
+static void emit(ExpressionParser *parser, int code, size_t input,
+                 float constant) {
+  if (parser->failed) {
+    return;
+  }
+  Expression *expression = parser->expression;
+  if (expression->num_ops == parser->capacity) {
+    size_t capacity = parser->capacity == 0 ? 16 : parser->capacity * 2;
+    ExpressionOp *ops = (ExpressionOp *)realloc(
+        expression->ops, sizeof(ExpressionOp) * capacity);
+    if (ops == NULL) {
+      parseError(parser, "out of memory");
+      return;
+    }
+    expression->ops = ops;
+    parser->capacity = capacity;
+  }
+  ExpressionOp op = {.code = code, .input = input, .constant = constant};
+  expression->ops[expression->num_ops++] = op;
+  if (code == kOpInput || code == kOpConstant) {
+    ++parser->depth;
+  } else if (code != kOpNegate && code != kOpExp && code != kOpLog &&
+             code != kOpSqrt) {
+    --parser->depth;
+  }
+  if (parser->depth > expression->max_depth) {
+    expression->max_depth = parser->depth;
+  }
+}
+
+static void addInput(Expression *expression, size_t input) {
+  for (size_t i = 0; i < expression->num_inputs; ++i) {
+    if (expression->inputs[i] == input) {
+      return;
+    }
+  }
+  expression->inputs[expression->num_inputs++] = input;
+}
+
+static void skipSpace(ExpressionParser *parser) {
+  while (isspace((unsigned char)*parser->cursor)) {
+    ++parser->cursor;
+  }
+}
+
+static int accept(ExpressionParser *parser, char c) {
+  skipSpace(parser);
+  if (*parser->cursor == c) {
+    ++parser->cursor;
+    return 1;
+  }
+  return 0;
+}
+
+static void expect(ExpressionParser *parser, char c) {
+  if (!accept(parser, c)) {
+    char message[32];
+    snprintf(message, sizeof(message), "expected '%c'", c);
+    parseError(parser, message);
+  }
+}
+
+static void parseCall(ExpressionParser *parser, const char *name,
+                      size_t name_len) {
+  static const struct {
+    const char *name;
+    int code;
+    int arity;
+  } kFunctions[] = {{"exp", kOpExp, 1},   {"log", kOpLog, 1},
+                    {"sqrt", kOpSqrt, 1}, {"min", kOpMin, 2},
+                    {"max", kOpMax, 2}};
+  for (size_t i = 0; i < sizeof(kFunctions) / sizeof(kFunctions[0]); ++i) {
+    if (strlen(kFunctions[i].name) == name_len &&
+        strncmp(kFunctions[i].name, name, name_len) == 0) {
+      parseSum(parser);
+      for (int arg = 1; arg < kFunctions[i].arity; ++arg) {
+        expect(parser, ',');
+        parseSum(parser);
+      }
+      expect(parser, ')');
+      emit(parser, kFunctions[i].code, 0, 0.0f);
+      return;
+    }
+  }
+  parseError(parser, "unknown function");
+}
+
+static void parsePrimary(ExpressionParser *parser) {
+  skipSpace(parser);
+  const char *start = parser->cursor;
+  if (accept(parser, '(')) {
+    parseSum(parser);
+    expect(parser, ')');
+  } else if (isdigit((unsigned char)*start) || *start == '.') {
+    char *end;
+    float constant = strtof(start, &end);
+    if (end == start) {
+      parseError(parser, "invalid number");
+      return;
+    }
+    parser->cursor = end;
+    emit(parser, kOpConstant, 0, constant);
+  } else if (isalpha((unsigned char)*start) || *start == '_') {
+    while (isalnum((unsigned char)*parser->cursor) || *parser->cursor == '_') {
+      ++parser->cursor;
+    }
+    size_t name_len = parser->cursor - start;
+    if (accept(parser, '(')) {
+      parseCall(parser, start, name_len);
+      return;
+    }
+    for (size_t i = 0; i < parser->num_names; ++i) {
+      if (parser->names[i] != NULL && strlen(parser->names[i]) == name_len &&
+          strncmp(parser->names[i], start, name_len) == 0) {
+        emit(parser, kOpInput, i, 0.0f);
+        addInput(parser->expression, i);
+        return;
+      }
+    }
+    parser->cursor = start;
+    parseError(parser, "unknown variable");
+  } else {
+    parseError(parser, "unexpected character");
+  }
+}
+
+static void parseUnary(ExpressionParser *parser) {
+  if (accept(parser, '-')) {
+    parseUnary(parser);
+    emit(parser, kOpNegate, 0, 0.0f);
+  } else if (accept(parser, '+')) {
+    parseUnary(parser);
+  } else {
+    parsePrimary(parser);
+    // Exponentiation binds tighter than unary minus and is right associative
+    if (accept(parser, '^')) {
+      parseUnary(parser);
+      emit(parser, kOpPower, 0, 0.0f);
+    }
+  }
+}
+
+static void parseProduct(ExpressionParser *parser) {
+  parseUnary(parser);
+  while (!parser->failed) {
+    if (accept(parser, '*')) {
+      parseUnary(parser);
+      emit(parser, kOpMultiply, 0, 0.0f);
+    } else if (accept(parser, '/')) {
+      parseUnary(parser);
+      emit(parser, kOpDivide, 0, 0.0f);
+    } else {
+      break;
+    }
+  }
+}
+
+static void parseSum(ExpressionParser *parser) {
+  parseProduct(parser);
+  while (!parser->failed) {
+    if (accept(parser, '+')) {
+      parseProduct(parser);
+      emit(parser, kOpAdd, 0, 0.0f);
+    } else if (accept(parser, '-')) {
+      parseProduct(parser);
+      emit(parser, kOpSubtract, 0, 0.0f);
+    } else {
+      break;
+    }
+  }
+}
+
+Expression *CompileExpression(const char *source, const char *const *names,
+                              size_t num_names) {
+  if (source == NULL) {
+    return NULL;
+  }
+  Expression *expression = (Expression *)calloc(1, sizeof(Expression));
+  if (expression == NULL) {
+    return NULL;
+  }
+  expression->inputs = (size_t *)malloc(sizeof(size_t) * (num_names + 1));
+  if (expression->inputs == NULL) {
+    free(expression);
+    return NULL;
+  }
+  ExpressionParser parser = {.source = source,
+                             .cursor = source,
+                             .names = names,
+                             .num_names = num_names,
+                             .expression = expression,
+                             .capacity = 0,
+                             .depth = 0,
+                             .failed = 0};
+  parseSum(&parser);
+  skipSpace(&parser);
+  if (!parser.failed && *parser.cursor != '\0') {
+    parseError(&parser, "unexpected trailing input");
+  }
+  if (parser.failed) {
+    FreeExpression(expression);
+    return NULL;
+  }
+  return expression;
+}
+
+void FreeExpression(Expression *expression) {
+  if (expression != NULL) {
+    free(expression->ops);
+    expression->ops = NULL;
+    free(expression->inputs);
+    expression->inputs = NULL;
+    free(expression);
+  }
+}
+
+int EvaluateExpression(const Expression *expression,
+                       const float *const *inputs, const float *input_fills,
+                       size_t length, float fill_value, float *dest) {
+  float *stack =
+      (float *)malloc(sizeof(float) * EXPRESSION_BLOCK * expression->max_depth);
+  if (stack == NULL) {
+    fprintf(stderr, "error: unable to allocate the expression stack\n");
+    return 1;
+  }
+  for (size_t offset = 0; offset < length; offset += EXPRESSION_BLOCK) {
+    size_t n = length - offset;
+    if (n > EXPRESSION_BLOCK) {
+      n = EXPRESSION_BLOCK;
+    }
+    float *top = stack;
+    for (size_t o = 0; o < expression->num_ops; ++o) {
+      const ExpressionOp *op = &expression->ops[o];
+      float *a = top - 2 * EXPRESSION_BLOCK;
+      float *b = top - EXPRESSION_BLOCK;
+      switch (op->code) {
+      case kOpInput:
+        memcpy(top, inputs[op->input] + offset, sizeof(float) * n);
+        top += EXPRESSION_BLOCK;
+        break;
+      case kOpConstant:
+        for (size_t i = 0; i < n; ++i) {
+          top[i] = op->constant;
+        }
+        top += EXPRESSION_BLOCK;
+        break;
+      case kOpAdd:
+        for (size_t i = 0; i < n; ++i) {
+          a[i] += b[i];
+        }
+        top = b;
+        break;
+      case kOpSubtract:
+        for (size_t i = 0; i < n; ++i) {
+          a[i] -= b[i];
+        }
+        top = b;
+        break;
+      case kOpMultiply:
+        for (size_t i = 0; i < n; ++i) {
+          a[i] *= b[i];
+        }
+        top = b;
+        break;
+      case kOpDivide:
+        for (size_t i = 0; i < n; ++i) {
+          a[i] /= b[i];
+        }
+        top = b;
+        break;
+      case kOpPower:
+        for (size_t i = 0; i < n; ++i) {
+          a[i] = powf(a[i], b[i]);
+        }
+        top = b;
+        break;
+      case kOpMin:
+        for (size_t i = 0; i < n; ++i) {
+          a[i] = b[i] < a[i] ? b[i] : a[i];
+        }
+        top = b;
+        break;
+      case kOpMax:
+        for (size_t i = 0; i < n; ++i) {
+          a[i] = b[i] > a[i] ? b[i] : a[i];
+        }
+        top = b;
+        break;
+      case kOpNegate:
+        for (size_t i = 0; i < n; ++i) {
+          b[i] = -b[i];
+        }
+        break;
+      case kOpExp:
+        for (size_t i = 0; i < n; ++i) {
+          b[i] = expf(b[i]);
+        }
+        break;
+      case kOpLog:
+        for (size_t i = 0; i < n; ++i) {
+          b[i] = logf(b[i]);
+        }
+        break;
+      case kOpSqrt:
+        for (size_t i = 0; i < n; ++i) {
+          b[i] = sqrtf(b[i]);
+        }
+        break;
+      }
+    }
+    memcpy(dest + offset, stack, sizeof(float) * n);
+    // Division by zero, log, sqrt and pow outside their domains give NaN or
+    // infinities, which no weather file can hold
+    for (size_t i = 0; i < n; ++i) {
+      if (!isfinite(dest[offset + i])) {
+        dest[offset + i] = fill_value;
+      }
+    }
+    // Any missing input makes the derived value missing as well
+    for (size_t k = 0; k < expression->num_inputs; ++k) {
+      const float *input = inputs[expression->inputs[k]] + offset;
+      float input_fill = input_fills[expression->inputs[k]];
+      for (size_t i = 0; i < n; ++i) {
+        if (input[i] == input_fill) {
+          dest[offset + i] = fill_value;
+        }
+      }
+    }
+  }
+  free(stack);
+  return 0;
+}
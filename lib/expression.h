@@ -0,0 +1,43 @@
+#ifndef WTH_EXPRESSION_H_
+#define WTH_EXPRESSION_H_
+#include <stddef.h>
+
+enum {
+  kOpInput,
+  kOpConstant,
+  kOpAdd,
+  kOpSubtract,
+  kOpMultiply,
+  kOpDivide,
+  kOpPower,
+  kOpNegate,
+  kOpExp,
+  kOpLog,
+  kOpSqrt,
+  kOpMin,
+  kOpMax
+};
+
+typedef struct ExpressionOp_ {
+  int code;
+  size_t input;
+  float constant;
+} ExpressionOp;
+
+// A compiled expression is a postfix program over whole buffers. Each op
+// pushes or combines buffers on a stack of at most max_depth entries.
+typedef struct Expression_ {
+  ExpressionOp *ops;
+  size_t num_ops;
+  size_t max_depth;
+  size_t *inputs;
+  size_t num_inputs;
+} Expression;
+
+Expression *CompileExpression(const char *source, const char *const *names,
+                              size_t num_names);
+void FreeExpression(Expression *expression);
+int EvaluateExpression(const Expression *expression,
+                       const float *const *inputs, const float *input_fills,
+                       size_t length, float fill_value, float *dest);
+#endif // WTH_EXPRESSION_H_
@@ -88,3 +88,69 @@ Hyperslab *AllocateHyperslabs(HyperslabPosition offset, HyperslabEdges stride,
   }
   return slabs;
 }
+
+// Bytes held for a slab: the raw and converted float buffers of each mapping.
+size_t HyperslabFootprint(HyperslabEdges edges, size_t num_mappings) {
+  return 2 * num_mappings * edges.days * edges.x_length * edges.y_length *
+         sizeof(float);
+}
+
+Hyperslab *SubdivideHyperslab(Hyperslab slab, size_t num_mappings,
+                              size_t budget, size_t *num_tiles) {
+  *num_tiles = 0;
+  size_t cell_bytes = HyperslabFootprint(Edges(slab.edges.days, 1, 1),
+                                         num_mappings);
+  size_t cells = slab.edges.x_length * slab.edges.y_length;
+  if (cell_bytes == 0 || cells == 0) {
+    return NULL;
+  }
+  size_t max_cells = budget / cell_bytes;
+  if (max_cells == 0) {
+    fprintf(stderr,
+            "error: %zu bytes cannot hold the time series of a single cell "
+            "(%zu bytes)\n",
+            budget, cell_bytes);
+    return NULL;
+  }
+  // Keep whole rows where possible so each read stays contiguous along x.
+  size_t tile_x;
+  size_t tile_y;
+  if (max_cells >= cells) {
+    tile_x = slab.edges.x_length;
+    tile_y = slab.edges.y_length;
+  } else if (max_cells >= slab.edges.x_length) {
+    tile_x = slab.edges.x_length;
+    tile_y = max_cells / slab.edges.x_length;
+  } else {
+    tile_x = max_cells;
+    tile_y = 1;
+  }
+  size_t tiles_x = (slab.edges.x_length + tile_x - 1) / tile_x;
+  size_t tiles_y = (slab.edges.y_length + tile_y - 1) / tile_y;
+  Hyperslab *tiles = (Hyperslab *)malloc(sizeof(Hyperslab) * tiles_x * tiles_y);
+  if (tiles == NULL) {
+    fprintf(stderr, "error: unable to allocate memory for %zu tiles\n",
+            tiles_x * tiles_y);
+    return NULL;
+  }
+  size_t index = 0;
+  for (size_t y = 0; y < tiles_y; ++y) {
+    size_t y_length = tile_y;
+    if ((y + 1) * tile_y > slab.edges.y_length) {
+      y_length = slab.edges.y_length - (y * tile_y);
+    }
+    for (size_t x = 0; x < tiles_x; ++x) {
+      size_t x_length = tile_x;
+      if ((x + 1) * tile_x > slab.edges.x_length) {
+        x_length = slab.edges.x_length - (x * tile_x);
+      }
+      tiles[index] = CreateHyperslab(
+          Position(slab.corner.day, slab.corner.x + (x * tile_x),
+                   slab.corner.y + (y * tile_y)),
+          Edges(slab.edges.days, x_length, y_length));
+      ++index;
+    }
+  }
+  *num_tiles = index;
+  return tiles;
+}
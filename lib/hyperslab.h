@@ -37,4 +37,7 @@ Hyperslab CreateHyperslab(HyperslabPosition corner, HyperslabEdges edges);
 size_t HyperslabValueIndex(Hyperslab hyperslab, HyperslabPosition position);
 Hyperslab *AllocateHyperslabs(HyperslabPosition offset, HyperslabEdges stride,
                               size_t num_slabs, int current_rank);
+size_t HyperslabFootprint(HyperslabEdges edges, size_t num_mappings);
+Hyperslab *SubdivideHyperslab(Hyperslab slab, size_t num_mappings,
+                              size_t budget, size_t *num_tiles);
 #endif // WTH_HYPERSLAB_H
@@ -8,36 +8,248 @@
 
 #include "config.h"
 #include "io.h"
+#include "rechunk.h"
 
 static const char *kLongitudeString = "lon";
 static const char *kLatitudeString = "lat";
 static const char *kTimeString = "time";
 static const char *kFillValueString = "missing_value";
 static const char *kUnitString = "units";
+static const char *kScaleFactorString = "scale_factor";
+static const char *kAddOffsetString = "add_offset";
 
 int OpenAllDataFiles(Config *config, MPI_Comm mpi_comm, MPI_Info mpi_info) {
   for (size_t i = 0; i < config->num_mappings; ++i) {
+    if (config->mappings[i].derived != NULL) {
+      continue;
+    }
     int status;
-    if ((status =
-             nc_open_par(config->mappings[i].file_name, NC_NOWRITE, mpi_comm,
-                         mpi_info, &config->mappings[i].netcdf_id))) {
-      fprintf(stderr, "error: cannot open file %s: %s\n",
-              config->mappings[i].file_name, nc_strerror(status));
+    const char *file_name = config->mappings[i].file_name;
+    // A point-major copy made by --rechunk is read in place of the original
+    // as long as it is newer than the original. The files continuing a time
+    // axis are opened when they are first read.
+    char store_name[2048];
+    if (config->point_major && config->mappings[i].num_parts == 0 &&
+        config->mappings[i].num_members == 0 &&
+        !PointMajorFileName(file_name, store_name, sizeof(store_name)) &&
+        PointMajorStoreIsCurrent(file_name, store_name)) {
+      file_name = store_name;
+    }
+    if ((status = nc_open_par(file_name, NC_NOWRITE, mpi_comm, mpi_info,
+                              &config->mappings[i].netcdf_id))) {
+      fprintf(stderr, "error: cannot open file %s: %s\n", file_name,
+              nc_strerror(status));
       return -1;
     } else {
-      printf("Opened %s\n", config->mappings[i].file_name);
+      printf("Opened %s\n", file_name);
     }
   }
   return config->num_mappings;
 }
 
+// Finds out whether a variable is stored as short integers and how it is
+// packed. Without the attributes the values are taken as they are.
+static int InspectPacking(int netcdf_id, int var_varid, NetCdfInfo *info) {
+  int status;
+  nc_type type;
+  if ((status = nc_inq_vartype(netcdf_id, var_varid, &type))) {
+    return status;
+  }
+  info->native_short = type == NC_SHORT;
+  info->scale_factor = 1.0;
+  info->add_offset = 0.0;
+  int has_scale =
+      nc_get_att_double(netcdf_id, var_varid, kScaleFactorString,
+                        &info->scale_factor) == NC_NOERR;
+  int has_offset = nc_get_att_double(netcdf_id, var_varid, kAddOffsetString,
+                                     &info->add_offset) == NC_NOERR;
+  info->packed = has_scale || has_offset;
+  return NC_NOERR;
+}
+
+// Checks that the files continuing the time axis of a mapping hold its
+// variable on the same grid with the same fill value, and appends their
+// days to the axis. Every file is closed again until it is read.
+static int InspectTimeParts(const FileConfig *mapping, NetCdfInfo *info) {
+  info->parts = NULL;
+  info->num_parts = 0;
+  if (mapping->num_parts == 0) {
+    return 0;
+  }
+  if (info->point_major) {
+    fprintf(stderr, "error: the time axis of %s cannot continue in other "
+                    "files, it is point-major\n",
+            mapping->file_name);
+    return 1;
+  }
+  info->parts = (TimePart *)calloc(mapping->num_parts, sizeof(TimePart));
+  if (info->parts == NULL) {
+    fprintf(stderr, "error: unable to allocate the files of %s\n",
+            mapping->netcdf_var);
+    return 1;
+  }
+  info->num_parts = mapping->num_parts;
+  for (size_t k = 0; k < info->num_parts; ++k) {
+    TimePart *part = &info->parts[k];
+    part->first_day = info->time_len;
+    part->netcdf_id = -1;
+    part->var_varid = -1;
+    part->chunk_reader = NULL;
+    int status;
+    int ncid;
+    int varid;
+    int dimid;
+    size_t longitude_len;
+    size_t latitude_len;
+    float fill_value;
+    NetCdfInfo packing;
+    if ((status = nc_open(mapping->parts[k], NC_NOWRITE, &ncid))) {
+      fprintf(stderr, "error: cannot open file %s: %s\n", mapping->parts[k],
+              nc_strerror(status));
+      return 1;
+    }
+    if ((status = nc_inq_varid(ncid, mapping->netcdf_var, &varid)) ||
+        (status = nc_inq_dimid(ncid, kLongitudeString, &dimid)) ||
+        (status = nc_inq_dimlen(ncid, dimid, &longitude_len)) ||
+        (status = nc_inq_dimid(ncid, kLatitudeString, &dimid)) ||
+        (status = nc_inq_dimlen(ncid, dimid, &latitude_len)) ||
+        (status = nc_inq_dimid(ncid, kTimeString, &dimid)) ||
+        (status = nc_inq_dimlen(ncid, dimid, &part->days)) ||
+        (status = nc_get_att_float(ncid, varid, kFillValueString,
+                                   &fill_value)) ||
+        (status = InspectPacking(ncid, varid, &packing))) {
+      fprintf(stderr, "error: cannot inquire %s in %s: %s\n",
+              mapping->netcdf_var, mapping->parts[k], nc_strerror(status));
+      nc_close(ncid);
+      return 1;
+    }
+    nc_close(ncid);
+    if (longitude_len != info->longitude_len ||
+        latitude_len != info->latitude_len || fill_value != info->fill_value ||
+        packing.native_short != info->native_short ||
+        packing.scale_factor != info->scale_factor ||
+        packing.add_offset != info->add_offset) {
+      fprintf(stderr, "error: %s does not share the grid, fill value and "
+                      "packing of %s\n",
+              mapping->parts[k], mapping->file_name);
+      return 1;
+    }
+    info->time_len += part->days;
+  }
+  return 0;
+}
+
+// Checks that the other models of an ensemble hold the variable of a
+// mapping on the same grid and days, with the same fill value, packing and
+// unit, so their values can be reduced before they are converted.
+static int InspectEnsembleMembers(const FileConfig *mapping,
+                                  NetCdfInfo *info) {
+  info->members = NULL;
+  info->num_members = 0;
+  if (mapping->num_members == 0) {
+    return 0;
+  }
+  if (info->point_major) {
+    fprintf(stderr, "error: the ensemble of %s cannot start with a "
+                    "point-major file\n",
+            mapping->file_name);
+    return 1;
+  }
+  info->members =
+      (EnsembleMember *)calloc(mapping->num_members, sizeof(EnsembleMember));
+  if (info->members == NULL) {
+    fprintf(stderr, "error: unable to allocate the members of %s\n",
+            mapping->netcdf_var);
+    return 1;
+  }
+  info->num_members = mapping->num_members;
+  for (size_t k = 0; k < info->num_members; ++k) {
+    info->members[k].netcdf_id = -1;
+    info->members[k].var_varid = -1;
+    int status;
+    int ncid;
+    int varid;
+    int dimid;
+    size_t longitude_len;
+    size_t latitude_len;
+    size_t time_len;
+    float fill_value;
+    NetCdfInfo packing;
+    char unit[256] = {0};
+    size_t unit_len = 0;
+    if ((status = nc_open(mapping->members[k], NC_NOWRITE, &ncid))) {
+      fprintf(stderr, "error: cannot open file %s: %s\n",
+              mapping->members[k], nc_strerror(status));
+      return 1;
+    }
+    if ((status = nc_inq_varid(ncid, mapping->netcdf_var, &varid)) ||
+        (status = nc_inq_dimid(ncid, kLongitudeString, &dimid)) ||
+        (status = nc_inq_dimlen(ncid, dimid, &longitude_len)) ||
+        (status = nc_inq_dimid(ncid, kLatitudeString, &dimid)) ||
+        (status = nc_inq_dimlen(ncid, dimid, &latitude_len)) ||
+        (status = nc_inq_dimid(ncid, kTimeString, &dimid)) ||
+        (status = nc_inq_dimlen(ncid, dimid, &time_len)) ||
+        (status = nc_get_att_float(ncid, varid, kFillValueString,
+                                   &fill_value)) ||
+        (status = InspectPacking(ncid, varid, &packing)) ||
+        (status = nc_inq_attlen(ncid, varid, kUnitString, &unit_len))) {
+      fprintf(stderr, "error: cannot inquire %s in %s: %s\n",
+              mapping->netcdf_var, mapping->members[k], nc_strerror(status));
+      nc_close(ncid);
+      return 1;
+    }
+    if (unit_len < sizeof(unit)) {
+      nc_get_att_text(ncid, varid, kUnitString, unit);
+    }
+    nc_close(ncid);
+    if (longitude_len != info->longitude_len ||
+        latitude_len != info->latitude_len || time_len != info->time_len ||
+        fill_value != info->fill_value ||
+        packing.native_short != info->native_short ||
+        packing.scale_factor != info->scale_factor ||
+        packing.add_offset != info->add_offset ||
+        strcmp(unit, info->unit) != 0) {
+      fprintf(stderr, "error: %s does not share the grid, days, fill value, "
+                      "packing and unit of %s\n",
+              mapping->members[k], mapping->file_name);
+      return 1;
+    }
+  }
+  return 0;
+}
+
 int InjectNetCdfInfo(Config *config, NetCdfInfo *info) {
   int status;
   char varname[NC_MAX_NAME + 1];
   InqVars inq;
 
+  size_t first_file = config->num_mappings;
   for (size_t i = 0; i < config->num_mappings; ++i) {
     int dimid;
+    if (config->mappings[i].derived != NULL) {
+      info[i].longitude_varid = -1;
+      info[i].latitude_varid = -1;
+      info[i].time_varid = -1;
+      info[i].var_varid = -1;
+      info[i].chunk_cache_size = 0;
+      info[i].point_major = 0;
+      info[i].chunk_reader = NULL;
+      info[i].parts = NULL;
+      info[i].num_parts = 0;
+      info[i].fill_value = DERIVED_FILL_VALUE;
+      info[i].unit = NULL;
+      info[i].native_short = 0;
+      info[i].packed = 0;
+      info[i].scale_factor = 1.0;
+      info[i].add_offset = 0.0;
+      info[i].members = NULL;
+      info[i].num_members = 0;
+      info[i].ensemble_statistic = config->ensemble_statistic;
+      continue;
+    }
+    if (first_file == config->num_mappings) {
+      first_file = i;
+    }
     if ((status = nc_inq(config->mappings[i].netcdf_id, &inq.num_dims,
                          &inq.num_vars, &inq.num_gattrs, &inq.num_unlimited))) {
       fprintf(stderr, "error: cannot inquire NetCDF file #%zu: %s\n", i + 1,
@@ -112,6 +324,17 @@ int InjectNetCdfInfo(Config *config, NetCdfInfo *info) {
           kTimeString, i + 1, nc_strerror(status));
       return 1;
     }
+    // Rechunked stores keep time as the fastest varying dimension
+    int var_dimids[NC_MAX_VAR_DIMS];
+    if ((status = nc_inq_vardimid(config->mappings[i].netcdf_id,
+                                  info[i].var_varid, var_dimids))) {
+      fprintf(stderr, "error: cannot find the dimensions of %s in file #%zu: "
+                      "%s\n",
+              config->mappings[i].netcdf_var, i + 1, nc_strerror(status));
+      return 1;
+    }
+    info[i].point_major = var_dimids[2] == dimid;
+    info[i].chunk_reader = NULL;
     if ((status =
              nc_get_att_float(config->mappings[i].netcdf_id, info[i].var_varid,
                               kFillValueString, &info[i].fill_value))) {
@@ -120,6 +343,21 @@ int InjectNetCdfInfo(Config *config, NetCdfInfo *info) {
               config->mappings[i].netcdf_var, i + 1, nc_strerror(status));
       return 1;
     }
+    if ((status = InspectPacking(config->mappings[i].netcdf_id,
+                                 info[i].var_varid, &info[i]))) {
+      fprintf(stderr, "error: cannot find the type of %s in file #%zu: %s\n",
+              config->mappings[i].netcdf_var, i + 1, nc_strerror(status));
+      return 1;
+    }
+    // The HDF5 chunk cache of each variable grows up to this size while
+    // reading and counts towards the memory used by the rank.
+    size_t cache_elems;
+    float cache_preemption;
+    if (nc_get_var_chunk_cache(config->mappings[i].netcdf_id,
+                               info[i].var_varid, &info[i].chunk_cache_size,
+                               &cache_elems, &cache_preemption)) {
+      info[i].chunk_cache_size = 0;
+    }
     size_t unit_len = 0;
     if ((status = nc_inq_attlen(config->mappings[i].netcdf_id,
                                 info[i].var_varid, kUnitString, &unit_len))) {
@@ -143,10 +381,336 @@ int InjectNetCdfInfo(Config *config, NetCdfInfo *info) {
       return 1;
     }
     info[i].unit[unit_len] = '\0';
+    if (InspectTimeParts(&config->mappings[i], &info[i])) {
+      return 1;
+    }
+    info[i].ensemble_statistic = config->ensemble_statistic;
+    if (InspectEnsembleMembers(&config->mappings[i], &info[i])) {
+      return 1;
+    }
+  }
+  // Derived variables share the grid and time axis of the files
+  for (size_t i = 0; i < config->num_mappings; ++i) {
+    if (config->mappings[i].derived != NULL) {
+      info[i].longitude_len = info[first_file].longitude_len;
+      info[i].latitude_len = info[first_file].latitude_len;
+      info[i].time_len = info[first_file].time_len;
+    }
+  }
+  return 0;
+}
+
+// Compressed map-major inputs can be inflated on several threads, while
+// point-major stores are uncompressed and read as is. Prefetching only uses
+// the chunk index for readahead hints.
+void OpenChunkReaders(const Config *config, NetCdfInfo *info) {
+  for (size_t i = 0; i < config->num_mappings; ++i) {
+    info[i].chunk_reader = NULL;
+    if (config->mappings[i].derived != NULL || info[i].point_major ||
+        (config->decompress_threads == 0 && !config->prefetch)) {
+      continue;
+    }
+    info[i].chunk_reader = OpenChunkReader(config->mappings[i].file_name,
+                                           config->mappings[i].netcdf_var,
+                                           config->decompress_threads);
+    if (info[i].chunk_reader != NULL && config->decompress_threads > 0) {
+      printf("Direct chunk reads for %s on %zu threads\n",
+             config->mappings[i].file_name, config->decompress_threads);
+    }
+  }
+}
+
+// Reads the rows of a point-major store one at a time and scatters them
+// into the day-major layout of the slab.
+static int ReadPointMajorHyperslab(const FileConfig *mapping,
+                                   const NetCdfInfo *info, Hyperslab slab,
+                                   float *dest) {
+  int status;
+  float *row =
+      (float *)malloc(sizeof(float) * slab.edges.x_length * slab.edges.days);
+  if (row == NULL) {
+    fprintf(stderr, "error: unable to allocate a row of %s\n",
+            mapping->file_name);
+    return 1;
+  }
+  for (size_t y = 0; y < slab.edges.y_length; ++y) {
+    size_t start[3] = {slab.corner.y + y, slab.corner.x, slab.corner.day};
+    size_t count[3] = {1, slab.edges.x_length, slab.edges.days};
+    if ((status = nc_get_vara_float(mapping->netcdf_id, info->var_varid, start,
+                                    count, row))) {
+      fprintf(stderr,
+              "error: unable to extract values from the point-major store of "
+              "%s for variable %s.\n\t%s\n\tRow: %zu\n",
+              mapping->file_name, mapping->netcdf_var, nc_strerror(status),
+              slab.corner.y + y);
+      free(row);
+      return 1;
+    }
+    for (size_t x = 0; x < slab.edges.x_length; ++x) {
+      const float *series = &row[x * slab.edges.days];
+      for (size_t d = 0; d < slab.edges.days; ++d) {
+        dest[HyperslabValueIndex(slab, Position(d, x, y))] = series[d];
+      }
+    }
   }
+  free(row);
   return 0;
 }
 
+// Widens the short integers at the start of dest into its floats, from the
+// last one down so that none is overwritten before it is read.
+static void WidenShorts(float *dest, size_t length) {
+  const short *values = (const short *)dest;
+  for (size_t i = length; i-- > 0;) {
+    dest[i] = (float)values[i];
+  }
+}
+
+// Short integers are read as they are, half the bytes of floats, into the
+// front of dest and widened in place.
+static int ReadFileHyperslab(const FileConfig *mapping, const char *file_name,
+                             int netcdf_id, int var_varid, int native_short,
+                             ChunkReader *chunk_reader, Hyperslab slab,
+                             float *dest) {
+  int status;
+  if (chunk_reader != NULL && ChunkReaderThreads(chunk_reader)) {
+    return ReadChunkedHyperslab(chunk_reader, slab, dest);
+  }
+  if (native_short) {
+    status = nc_get_vara_short(netcdf_id, var_varid, slab.corner.shape,
+                               slab.edges.shape, (short *)dest);
+    if (!status) {
+      WidenShorts(dest, slab.flat_size);
+    }
+  } else {
+    status = nc_get_vara_float(netcdf_id, var_varid, slab.corner.shape,
+                               slab.edges.shape, dest);
+  }
+  if (status) {
+    fprintf(stderr,
+            "error: unable to extract values from %s for variable "
+            "%s.\n\t%s\n\tCorner: %zu, %zu, %zu\n\tEdges: %zu, %zu, %zu\n",
+            file_name, mapping->netcdf_var, nc_strerror(status),
+            slab.corner.day, slab.corner.x, slab.corner.y, slab.edges.days,
+            slab.edges.x_length, slab.edges.y_length);
+    return 1;
+  }
+  return 0;
+}
+
+// The part of a slab falling within the days of one file, relative to the
+// start of that file. Its size is zero when they do not overlap.
+static Hyperslab ClipToFile(Hyperslab slab, size_t first_day, size_t days) {
+  size_t begin = slab.corner.day > first_day ? slab.corner.day : first_day;
+  size_t end = slab.corner.day + slab.edges.days;
+  end = end < first_day + days ? end : first_day + days;
+  return CreateHyperslab(
+      Position(begin < end ? begin - first_day : 0, slab.corner.x,
+               slab.corner.y),
+      Edges(begin < end ? end - begin : 0, slab.edges.x_length,
+            slab.edges.y_length));
+}
+
+static size_t FirstFileDays(const NetCdfInfo *info) {
+  return info->num_parts > 0 ? info->parts[0].first_day : info->time_len;
+}
+
+static int OpenTimePart(const FileConfig *mapping, const NetCdfInfo *info,
+                        size_t k) {
+  TimePart *part = &info->parts[k];
+  if (part->netcdf_id != -1) {
+    return 0;
+  }
+  int status;
+  if ((status = nc_open(mapping->parts[k], NC_NOWRITE, &part->netcdf_id))) {
+    fprintf(stderr, "error: cannot open file %s: %s\n", mapping->parts[k],
+            nc_strerror(status));
+    part->netcdf_id = -1;
+    return 1;
+  }
+  if ((status = nc_inq_varid(part->netcdf_id, mapping->netcdf_var,
+                             &part->var_varid))) {
+    fprintf(stderr, "error: cannot find %s varid in %s: %s\n",
+            mapping->netcdf_var, mapping->parts[k], nc_strerror(status));
+    return 1;
+  }
+  // Parts are read the same way as the first file
+  if (info->chunk_reader != NULL) {
+    part->chunk_reader =
+        OpenChunkReader(mapping->parts[k], mapping->netcdf_var,
+                        ChunkReaderThreads(info->chunk_reader));
+  }
+  return 0;
+}
+
+static int OpenEnsembleMember(const FileConfig *mapping,
+                              const NetCdfInfo *info, size_t k) {
+  EnsembleMember *member = &info->members[k];
+  if (member->netcdf_id != -1) {
+    return 0;
+  }
+  int status;
+  if ((status = nc_open(mapping->members[k], NC_NOWRITE,
+                        &member->netcdf_id))) {
+    fprintf(stderr, "error: cannot open file %s: %s\n", mapping->members[k],
+            nc_strerror(status));
+    member->netcdf_id = -1;
+    return 1;
+  }
+  if ((status = nc_inq_varid(member->netcdf_id, mapping->netcdf_var,
+                             &member->var_varid))) {
+    fprintf(stderr, "error: cannot find %s varid in %s: %s\n",
+            mapping->netcdf_var, mapping->members[k], nc_strerror(status));
+    return 1;
+  }
+  return 0;
+}
+
+// Folds the values of one more model into the running statistic of the
+// ensemble in dest. A value missing from any model stays missing.
+void ReduceEnsembleValues(int statistic, float fill_value,
+                          const float *values, float *dest, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    if (dest[i] == fill_value || values[i] == fill_value) {
+      dest[i] = fill_value;
+    } else if (statistic == ensemble_min) {
+      dest[i] = values[i] < dest[i] ? values[i] : dest[i];
+    } else if (statistic == ensemble_max) {
+      dest[i] = values[i] > dest[i] ? values[i] : dest[i];
+    } else {
+      dest[i] += values[i];
+    }
+  }
+}
+
+// Turns the sum of the models into their mean once all are folded in. The
+// first file is one of the models besides the members.
+void FinishEnsembleValues(const NetCdfInfo *info, float *dest,
+                          size_t length) {
+  if (info->ensemble_statistic != ensemble_mean) {
+    return;
+  }
+  float num_models = (float)(info->num_members + 1);
+  for (size_t i = 0; i < length; ++i) {
+    if (dest[i] != info->fill_value) {
+      dest[i] /= num_models;
+    }
+  }
+}
+
+// Reads the slab of the first model into dest and those of the others one
+// after the other into a scratch slab, reducing each as it arrives, so no
+// more than two slabs of the mapping are held at once. The statistic is
+// taken of the stored values, which the converter turns into the target
+// unit afterwards; mean, min and max all commute with its increasing affine
+// conversions.
+static int ReadEnsembleHyperslab(const FileConfig *mapping,
+                                 const NetCdfInfo *info, Hyperslab slab,
+                                 float *dest) {
+  if (ReadFileHyperslab(mapping, mapping->file_name, mapping->netcdf_id,
+                        info->var_varid, info->native_short,
+                        info->chunk_reader, slab, dest)) {
+    return 1;
+  }
+  float *values = (float *)malloc(sizeof(float) * slab.flat_size);
+  if (values == NULL) {
+    fprintf(stderr, "error: unable to allocate a member slab of %s\n",
+            mapping->netcdf_var);
+    return 1;
+  }
+  for (size_t k = 0; k < info->num_members; ++k) {
+    if (OpenEnsembleMember(mapping, info, k) ||
+        ReadFileHyperslab(mapping, mapping->members[k],
+                          info->members[k].netcdf_id,
+                          info->members[k].var_varid, info->native_short,
+                          NULL, slab, values)) {
+      free(values);
+      return 1;
+    }
+    ReduceEnsembleValues(info->ensemble_statistic, info->fill_value, values,
+                         dest, slab.flat_size);
+  }
+  free(values);
+  FinishEnsembleValues(info, dest, slab.flat_size);
+  return 0;
+}
+
+// Reads the days of a slab from the first file and then from each file
+// continuing its time axis, opening the next file and asking for its chunks
+// before reading the current one.
+int ReadHyperslab(const FileConfig *mapping, const NetCdfInfo *info,
+                  Hyperslab slab, float *dest) {
+  if (info->point_major) {
+    return ReadPointMajorHyperslab(mapping, info, slab, dest);
+  }
+  if (info->num_members > 0) {
+    return ReadEnsembleHyperslab(mapping, info, slab, dest);
+  }
+  if (info->num_parts == 0) {
+    return ReadFileHyperslab(mapping, mapping->file_name, mapping->netcdf_id,
+                             info->var_varid, info->native_short,
+                             info->chunk_reader, slab, dest);
+  }
+  size_t plane = slab.edges.x_length * slab.edges.y_length;
+  for (size_t k = 0; k <= info->num_parts; ++k) {
+    size_t first_day = k == 0 ? 0 : info->parts[k - 1].first_day;
+    size_t days = k == 0 ? FirstFileDays(info) : info->parts[k - 1].days;
+    Hyperslab piece = ClipToFile(slab, first_day, days);
+    if (piece.flat_size == 0) {
+      continue;
+    }
+    if (k > 0 && OpenTimePart(mapping, info, k - 1)) {
+      return 1;
+    }
+    if (k < info->num_parts) {
+      const TimePart *next = &info->parts[k];
+      Hyperslab ahead = ClipToFile(slab, next->first_day, next->days);
+      if (ahead.flat_size > 0 && !OpenTimePart(mapping, info, k) &&
+          next->chunk_reader != NULL) {
+        AdviseChunkedHyperslab(next->chunk_reader, ahead);
+      }
+    }
+    float *piece_dest =
+        &dest[(first_day + piece.corner.day - slab.corner.day) * plane];
+    int failed =
+        k == 0 ? ReadFileHyperslab(mapping, mapping->file_name,
+                                   mapping->netcdf_id, info->var_varid,
+                                   info->native_short, info->chunk_reader,
+                                   piece, piece_dest)
+               : ReadFileHyperslab(mapping, mapping->parts[k - 1],
+                                   info->parts[k - 1].netcdf_id,
+                                   info->parts[k - 1].var_varid,
+                                   info->native_short,
+                                   info->parts[k - 1].chunk_reader, piece,
+                                   piece_dest);
+    if (failed) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void AdviseHyperslab(const NetCdfInfo *info, Hyperslab slab) {
+  if (info->num_parts == 0) {
+    if (info->chunk_reader != NULL) {
+      AdviseChunkedHyperslab(info->chunk_reader, slab);
+    }
+    return;
+  }
+  Hyperslab piece = ClipToFile(slab, 0, FirstFileDays(info));
+  if (info->chunk_reader != NULL && piece.flat_size > 0) {
+    AdviseChunkedHyperslab(info->chunk_reader, piece);
+  }
+  // Parts which are not open yet are asked for when the one before is read
+  for (size_t k = 0; k < info->num_parts; ++k) {
+    const TimePart *part = &info->parts[k];
+    piece = ClipToFile(slab, part->first_day, part->days);
+    if (part->chunk_reader != NULL && piece.flat_size > 0) {
+      AdviseChunkedHyperslab(part->chunk_reader, piece);
+    }
+  }
+}
+
 int CloseAllDataFiles(Config *config, NetCdfInfo *info) {
   int retval = 0;
   int status;
@@ -155,6 +719,31 @@ int CloseAllDataFiles(Config *config, NetCdfInfo *info) {
       free(info[i].unit);
       info[i].unit = NULL;
     }
+    CloseChunkReader(info[i].chunk_reader);
+    info[i].chunk_reader = NULL;
+    for (size_t k = 0; k < info[i].num_parts; ++k) {
+      CloseChunkReader(info[i].parts[k].chunk_reader);
+      if (info[i].parts[k].netcdf_id != -1 &&
+          (status = nc_close(info[i].parts[k].netcdf_id))) {
+        fprintf(stderr, "error: %s [%s]", nc_strerror(status),
+                config->mappings[i].parts[k]);
+        retval = 1;
+      }
+    }
+    free(info[i].parts);
+    info[i].parts = NULL;
+    info[i].num_parts = 0;
+    for (size_t k = 0; k < info[i].num_members; ++k) {
+      if (info[i].members[k].netcdf_id != -1 &&
+          (status = nc_close(info[i].members[k].netcdf_id))) {
+        fprintf(stderr, "error: %s [%s]", nc_strerror(status),
+                config->mappings[i].members[k]);
+        retval = 1;
+      }
+    }
+    free(info[i].members);
+    info[i].members = NULL;
+    info[i].num_members = 0;
     if (config->mappings[i].netcdf_id != -1) {
       if ((status = nc_close(config->mappings[i].netcdf_id))) {
         fprintf(stderr, "error: %s [%s]", nc_strerror(status),
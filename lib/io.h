@@ -4,7 +4,9 @@
 
 #include <mpi.h>
 
+#include "chunk_reader.h"
 #include "config.h"
+#include "hyperslab.h"
 
 typedef struct InqVars_ {
   int num_dims;
@@ -13,6 +15,23 @@ typedef struct InqVars_ {
   int num_unlimited;
 } InqVars;
 
+// A file continuing the time axis of a mapping, opened on first use by the
+// process reading it.
+typedef struct TimePart_ {
+  size_t first_day;
+  size_t days;
+  int netcdf_id;
+  int var_varid;
+  ChunkReader *chunk_reader;
+} TimePart;
+
+// The file of another model of an ensemble, opened on first use like the
+// parts of a time axis.
+typedef struct EnsembleMember_ {
+  int netcdf_id;
+  int var_varid;
+} EnsembleMember;
+
 typedef struct NetCdfInfo_ {
   int longitude_varid;
   int latitude_varid;
@@ -21,12 +40,35 @@ typedef struct NetCdfInfo_ {
   size_t longitude_len;
   size_t latitude_len;
   size_t time_len;
+  size_t chunk_cache_size;
+  int point_major;
+  ChunkReader *chunk_reader;
+  TimePart *parts;
+  size_t num_parts;
   float fill_value;
   char *unit;
+  // Variables stored as short integers are read as such, and those with a
+  // scale_factor or add_offset are unpacked by their converter. The fill
+  // value stays packed.
+  int native_short;
+  int packed;
+  double scale_factor;
+  double add_offset;
+  EnsembleMember *members;
+  size_t num_members;
+  int ensemble_statistic;
 } NetCdfInfo;
 
 int OpenAllDataFiles(Config *config, MPI_Comm mpi_comm, MPI_Info mpi_info);
 int CloseAllDataFiles(Config *config, NetCdfInfo *info);
 int InjectNetCdfInfo(Config *config, NetCdfInfo *info);
+void OpenChunkReaders(const Config *config, NetCdfInfo *info);
+int ReadHyperslab(const FileConfig *mapping, const NetCdfInfo *info,
+                  Hyperslab slab, float *dest);
+void AdviseHyperslab(const NetCdfInfo *info, Hyperslab slab);
+void ReduceEnsembleValues(int statistic, float fill_value,
+                          const float *values, float *dest, size_t length);
+void FinishEnsembleValues(const NetCdfInfo *info, float *dest,
+                          size_t length);
 void DebugDataFiles(Config *config);
 #endif // WTH_NETCDF_HANDLER_H
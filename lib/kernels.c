@@ -0,0 +1,192 @@
+#include <string.h>
+
+#include "kernels.h"
+
+void ConvertValues(const ConverterContainer *converter, float fill_value,
+                   const float *raw, float *converted, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    if (raw[i] == fill_value) {
+      converted[i] = raw[i];
+    } else {
+      converted[i] = ConvertValue(converter, raw[i]);
+    }
+  }
+}
+
+// The role a kernel converts a mapping with, and its coefficients. A slope
+// of exactly one makes the multiplication exact, so the offset role gives the
+// same floats as the affine converter.
+int ConversionRole(const ConverterContainer *converter, double *slope,
+                   double *intercept) {
+  *slope = 1.0;
+  *intercept = 0.0;
+  if (!converter->affine && converter->cv == NULL) {
+    return kConvertCopy;
+  }
+  if (!AffineCoefficients(converter, slope, intercept)) {
+    return kConvertUdunits;
+  }
+  return *slope == 1.0 ? kConvertOffset : kConvertAffine;
+}
+
+// The conversions of one mapping with its role known at build time, which
+// leaves the fill value as the only branch of the loop.
+static void ConvertCopy(const float *raw, float *converted, float fill,
+                        double slope, double intercept, size_t count) {
+  (void)fill;
+  (void)slope;
+  (void)intercept;
+  if (converted != raw) {
+    memcpy(converted, raw, sizeof(float) * count);
+  }
+}
+
+static void ConvertOffset(const float *raw, float *converted, float fill,
+                          double slope, double intercept, size_t count) {
+  (void)slope;
+  for (size_t i = 0; i < count; ++i) {
+    float value = raw[i];
+    converted[i] = value == fill ? value : (float)(value + intercept);
+  }
+}
+
+static void ConvertAffine(const float *raw, float *converted, float fill,
+                          double slope, double intercept, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    float value = raw[i];
+    converted[i] =
+        value == fill ? value : (float)(slope * value + intercept);
+  }
+}
+
+// The mapping sets with kernels of their own: a name, the mapping count and
+// the role of each mapping in the order of the configuration. The usual
+// SRAD, TMIN, TMAX and RAIN come first, alone or followed by one mapping
+// written as read, then any set of affine conversions. The first set a
+// scenario fits is used.
+#define KERNEL_SETS(X)                                                       \
+  X(srad_tmin_tmax_rain, 4, (Affine, Offset, Offset, Affine))                \
+  X(srad_tmin_tmax_rain_copy, 5, (Affine, Offset, Offset, Affine, Copy))     \
+  X(affine4, 4, (Affine, Affine, Affine, Affine))                            \
+  X(affine5, 5, (Affine, Affine, Affine, Affine, Affine))
+
+#define CONVERT_MAPPING(m, role)                                             \
+  Convert##role(raw[m], converted[m], kernels->fills[m], kernels->slopes[m], \
+                kernels->intercepts[m], count);
+#define CONVERT_ROLES4(a, b, c, d)                                           \
+  CONVERT_MAPPING(0, a)                                                      \
+  CONVERT_MAPPING(1, b) CONVERT_MAPPING(2, c) CONVERT_MAPPING(3, d)
+#define CONVERT_ROLES5(a, b, c, d, e)                                        \
+  CONVERT_ROLES4(a, b, c, d) CONVERT_MAPPING(4, e)
+#define ROLE_VALUES4(a, b, c, d)                                             \
+  kConvert##a, kConvert##b, kConvert##c, kConvert##d
+#define ROLE_VALUES5(a, b, c, d, e) ROLE_VALUES4(a, b, c, d), kConvert##e
+
+#define DEFINE_CONVERT(name, n, roles)                                       \
+  static void Convert_##name(const CellKernels *kernels,                     \
+                             const float *const *raw,                        \
+                             float *const *converted, size_t count) {        \
+    CONVERT_ROLES##n roles                                                   \
+  }
+KERNEL_SETS(DEFINE_CONVERT)
+
+// Gathering a cell only depends on the mapping count, which unrolls the
+// loop over the mappings of a day.
+#define REPEAT4(F) F(0) F(1) F(2) F(3)
+#define REPEAT5(F) REPEAT4(F) F(4)
+#define MISSING(m) || converted[m][index] == kernels->fills[m]
+#define GATHER_DAY(m) series[m * days + d] = converted[m][d * plane + index];
+
+#define DEFINE_GATHER(n)                                                     \
+  static int Gather##n(const CellKernels *kernels,                           \
+                       const float *const *converted, size_t plane,          \
+                       size_t index, size_t days, float *series) {           \
+    if (0 REPEAT##n(MISSING)) {                                              \
+      return 1;                                                              \
+    }                                                                        \
+    for (size_t d = 0; d < days; ++d) {                                      \
+      REPEAT##n(GATHER_DAY)                                                  \
+    }                                                                        \
+    return 0;                                                                \
+  }
+DEFINE_GATHER(4)
+DEFINE_GATHER(5)
+
+int GatherGeneric(const CellKernels *kernels, const float *const *converted,
+                  size_t plane, size_t index, size_t days, float *series) {
+  for (size_t m = 0; m < kernels->num_mappings; ++m) {
+    if (converted[m][index] == kernels->fills[m]) {
+      return 1;
+    }
+  }
+  for (size_t d = 0; d < days; ++d) {
+    for (size_t m = 0; m < kernels->num_mappings; ++m) {
+      series[m * days + d] = converted[m][d * plane + index];
+    }
+  }
+  return 0;
+}
+
+typedef struct KernelSet_ {
+  const char *name;
+  size_t num_mappings;
+  int roles[KERNEL_MAX_MAPPINGS];
+  ConvertKernel convert;
+} KernelSet;
+
+#define KERNEL_SET_ENTRY(name, n, roles)                                     \
+  {#name, n, {ROLE_VALUES##n roles}, Convert_##name},
+static const KernelSet kKernelSets[] = {KERNEL_SETS(KERNEL_SET_ENTRY)};
+
+// An affine kernel takes offsets as well, they only differ by a slope of one.
+static int RoleFits(int kernel_role, int role) {
+  return kernel_role == role ||
+         (kernel_role == kConvertAffine && role == kConvertOffset);
+}
+
+// Picks the kernels built for the mappings of the configuration, or the
+// generic ones. Derived variables, quantized tiles and the slab cache keep
+// the generic conversions, which handle them.
+void SelectCellKernels(const Config *config,
+                       const ConverterContainer *converters,
+                       const float *fills, CellKernels *kernels) {
+  size_t num_mappings = config->num_mappings;
+  kernels->num_mappings = num_mappings;
+  kernels->fills = fills;
+  kernels->convert = NULL;
+  kernels->convert_name = "generic";
+  kernels->gather = GatherGeneric;
+  kernels->gather_name = "generic";
+  if (num_mappings == 4) {
+    kernels->gather = Gather4;
+    kernels->gather_name = "4 mappings";
+  } else if (num_mappings == 5) {
+    kernels->gather = Gather5;
+    kernels->gather_name = "5 mappings";
+  }
+  if (num_mappings > KERNEL_MAX_MAPPINGS || config->quantize ||
+      config->cache_dir != NULL) {
+    return;
+  }
+  int roles[KERNEL_MAX_MAPPINGS];
+  for (size_t m = 0; m < num_mappings; ++m) {
+    if (config->mappings[m].derived != NULL) {
+      return;
+    }
+    roles[m] = ConversionRole(&converters[m], &kernels->slopes[m],
+                              &kernels->intercepts[m]);
+  }
+  for (size_t s = 0; s < sizeof(kKernelSets) / sizeof(kKernelSets[0]); ++s) {
+    const KernelSet *set = &kKernelSets[s];
+    size_t m = 0;
+    while (set->num_mappings == num_mappings && m < num_mappings &&
+           RoleFits(set->roles[m], roles[m])) {
+      ++m;
+    }
+    if (set->num_mappings == num_mappings && m == num_mappings) {
+      kernels->convert = set->convert;
+      kernels->convert_name = set->name;
+      return;
+    }
+  }
+}
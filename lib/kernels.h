@@ -0,0 +1,51 @@
+#ifndef WTH_KERNELS_H_
+#define WTH_KERNELS_H_
+#include <stddef.h>
+
+#include "config.h"
+#include "unit_util.h"
+
+// How a kernel converts the values of a mapping: as they are read, by an
+// added offset (temperatures) or by a scale and an offset (fluxes).
+enum { kConvertCopy, kConvertOffset, kConvertAffine, kConvertUdunits };
+
+// The largest mapping set a kernel is built for
+#define KERNEL_MAX_MAPPINGS 5
+
+typedef struct CellKernels_ CellKernels;
+
+// Converts count values of every mapping from raw into converted.
+typedef void (*ConvertKernel)(const CellKernels *kernels,
+                              const float *const *raw, float *const *converted,
+                              size_t count);
+// Copies the series of the cell at index of each day plane of a tile into
+// series, mapping after mapping, unless a mapping is missing on the first
+// day, which returns 1.
+typedef int (*GatherKernel)(const CellKernels *kernels,
+                            const float *const *converted, size_t plane,
+                            size_t index, size_t days, float *series);
+
+// The kernels a scenario runs. Convert is NULL when the conversions have no
+// kernel of their own and are left to the converters, gather always runs.
+// The fill values of the mappings belong to the caller.
+struct CellKernels_ {
+  const char *convert_name;
+  const char *gather_name;
+  size_t num_mappings;
+  ConvertKernel convert;
+  GatherKernel gather;
+  const float *fills;
+  double slopes[KERNEL_MAX_MAPPINGS];
+  double intercepts[KERNEL_MAX_MAPPINGS];
+};
+
+void ConvertValues(const ConverterContainer *converter, float fill_value,
+                   const float *raw, float *converted, size_t length);
+int ConversionRole(const ConverterContainer *converter, double *slope,
+                   double *intercept);
+int GatherGeneric(const CellKernels *kernels, const float *const *converted,
+                  size_t plane, size_t index, size_t days, float *series);
+void SelectCellKernels(const Config *config,
+                       const ConverterContainer *converters,
+                       const float *fills, CellKernels *kernels);
+#endif // WTH_KERNELS_H_
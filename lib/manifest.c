@@ -0,0 +1,251 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <mpi.h>
+
+#include "manifest.h"
+
+static const char *kCsvHeader =
+    "global_id,longitude,latitude,path,bytes,records,skipped,checksum\n";
+
+typedef struct RowExtent_ {
+  uint64_t global_id;
+  uint64_t length;
+} RowExtent;
+
+void InitManifest(Manifest *manifest, int format) {
+  manifest->format = format;
+  manifest->num_rows = 0;
+  manifest->capacity = 0;
+  manifest->rows = NULL;
+}
+
+// Copies the row and its path.
+int AddManifestRow(Manifest *manifest, const ManifestRow *row) {
+  if (manifest->num_rows == manifest->capacity) {
+    size_t capacity = manifest->capacity == 0 ? 1024 : 2 * manifest->capacity;
+    ManifestRow *rows = (ManifestRow *)realloc(
+        manifest->rows, sizeof(ManifestRow) * capacity);
+    if (rows == NULL) {
+      return 1;
+    }
+    manifest->rows = rows;
+    manifest->capacity = capacity;
+  }
+  ManifestRow *copy = &manifest->rows[manifest->num_rows];
+  *copy = *row;
+  copy->path = strdup(row->path == NULL ? "" : row->path);
+  if (copy->path == NULL) {
+    return 1;
+  }
+  ++manifest->num_rows;
+  return 0;
+}
+
+// Returns the size of the row like snprintf does, and only writes it when
+// it fits. Binary rows hold the fields below in native byte order followed
+// by the path without a terminator.
+size_t FormatManifestRow(const ManifestRow *row, int format, char *dest,
+                         size_t dest_size) {
+  if (format == manifest_csv) {
+    return snprintf(dest, dest_size,
+                    "%" PRIu64 ",%.2f,%.2f,%s,%" PRIu64 ",%" PRIu32
+                    ",%d,%08" PRIx32 "\n",
+                    row->global_id, row->longitude, row->latitude, row->path,
+                    row->bytes, row->records, row->skipped ? 1 : 0,
+                    row->checksum);
+  }
+  size_t path_len = strlen(row->path);
+  if (path_len > UINT16_MAX) {
+    path_len = UINT16_MAX;
+  }
+  size_t size = MANIFEST_ROW_SIZE + path_len;
+  if (dest == NULL || dest_size < size) {
+    return size;
+  }
+  uint8_t skipped = row->skipped ? 1 : 0;
+  uint8_t pad = 0;
+  uint16_t path_len16 = (uint16_t)path_len;
+  memcpy(dest, &row->global_id, 8);
+  memcpy(dest + 8, &row->longitude, 8);
+  memcpy(dest + 16, &row->latitude, 8);
+  memcpy(dest + 24, &row->bytes, 8);
+  memcpy(dest + 32, &row->records, 4);
+  memcpy(dest + 36, &row->checksum, 4);
+  memcpy(dest + 40, &skipped, 1);
+  memcpy(dest + 41, &pad, 1);
+  memcpy(dest + 42, &path_len16, 2);
+  memcpy(dest + MANIFEST_ROW_SIZE, row->path, path_len);
+  return size;
+}
+
+static int CompareRows(const void *a, const void *b) {
+  uint64_t left = ((const ManifestRow *)a)->global_id;
+  uint64_t right = ((const ManifestRow *)b)->global_id;
+  return (left > right) - (left < right);
+}
+
+static int CompareExtents(const void *a, const void *b) {
+  uint64_t left = ((const RowExtent *)a)->global_id;
+  uint64_t right = ((const RowExtent *)b)->global_id;
+  return (left > right) - (left < right);
+}
+
+static size_t FormatHeader(int format, uint64_t num_rows, char *dest) {
+  if (format == manifest_csv) {
+    size_t size = strlen(kCsvHeader);
+    memcpy(dest, kCsvHeader, size);
+    return size;
+  }
+  uint32_t version = MANIFEST_VERSION;
+  uint32_t row_size = MANIFEST_ROW_SIZE;
+  memcpy(dest, MANIFEST_MAGIC, 8);
+  memcpy(dest + 8, &version, 4);
+  memcpy(dest + 12, &row_size, 4);
+  memcpy(dest + 16, &num_rows, 8);
+  return MANIFEST_HEADER_SIZE;
+}
+
+// Every rank renders its rows, the (global ID, length) pairs of all rows are
+// gathered so each rank can place its rows in global ID order, and the
+// rows are written through a file view in one collective call.
+int WriteManifest(Manifest *manifest, const char *file_name,
+                  MPI_Comm mpi_comm) {
+  int comm_size;
+  int comm_rank;
+  MPI_Comm_size(mpi_comm, &comm_size);
+  MPI_Comm_rank(mpi_comm, &comm_rank);
+  qsort(manifest->rows, manifest->num_rows, sizeof(ManifestRow), CompareRows);
+
+  size_t header_max = strlen(kCsvHeader) + MANIFEST_HEADER_SIZE;
+  size_t text_size = comm_rank == 0 ? header_max : 0;
+  RowExtent *local = (RowExtent *)malloc(
+      sizeof(RowExtent) * (manifest->num_rows > 0 ? manifest->num_rows : 1));
+  // The ranks agree on their allocations before every collective step, so
+  // that all of them give up together
+  int failed = local == NULL;
+  MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, mpi_comm);
+  if (failed) {
+    free(local);
+    return 1;
+  }
+  for (size_t i = 0; i < manifest->num_rows; ++i) {
+    local[i].global_id = manifest->rows[i].global_id;
+    local[i].length =
+        FormatManifestRow(&manifest->rows[i], manifest->format, NULL, 0);
+    text_size += local[i].length;
+  }
+
+  int counts[comm_size];
+  int displs[comm_size];
+  int local_count = (int)(2 * manifest->num_rows);
+  MPI_Allgather(&local_count, 1, MPI_INT, counts, 1, MPI_INT, mpi_comm);
+  size_t total = 0;
+  for (int r = 0; r < comm_size; ++r) {
+    displs[r] = (int)total;
+    total += counts[r];
+  }
+  size_t num_rows = total / 2;
+  RowExtent *all =
+      (RowExtent *)malloc(sizeof(RowExtent) * (num_rows > 0 ? num_rows : 1));
+  // One more byte for the terminator snprintf adds to the last CSV row
+  char *text = (char *)malloc(text_size + 1);
+  MPI_Aint *offsets = (MPI_Aint *)malloc(
+      sizeof(MPI_Aint) * (manifest->num_rows + 1));
+  int *lengths = (int *)malloc(sizeof(int) * (manifest->num_rows + 1));
+  failed = all == NULL || text == NULL || offsets == NULL || lengths == NULL;
+  if (failed) {
+    fprintf(stderr, "error: unable to allocate the manifest of %zu rows\n",
+            num_rows);
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, mpi_comm);
+  if (failed) {
+    free(local);
+    free(all);
+    free(text);
+    free(offsets);
+    free(lengths);
+    return 1;
+  }
+  MPI_Allgatherv(local, local_count, MPI_UINT64_T, all, counts, displs,
+                 MPI_UINT64_T, mpi_comm);
+  qsort(all, num_rows, sizeof(RowExtent), CompareExtents);
+
+  // Offsets of the rows in the file, replacing their lengths in place
+  char header[128];
+  size_t header_size = FormatHeader(manifest->format, num_rows, header);
+  uint64_t offset = header_size;
+  for (size_t i = 0; i < num_rows; ++i) {
+    uint64_t length = all[i].length;
+    all[i].length = offset;
+    offset += length;
+  }
+
+  size_t used = 0;
+  size_t num_blocks = 0;
+  if (comm_rank == 0) {
+    offsets[0] = 0;
+    lengths[0] = (int)header_size;
+    memcpy(text, header, header_size);
+    used = header_size;
+    num_blocks = 1;
+  }
+  for (size_t i = 0; i < manifest->num_rows; ++i) {
+    RowExtent key = {local[i].global_id, 0};
+    RowExtent *found = (RowExtent *)bsearch(&key, all, num_rows,
+                                            sizeof(RowExtent), CompareExtents);
+    size_t length = FormatManifestRow(&manifest->rows[i], manifest->format,
+                                      text + used, text_size + 1 - used);
+    MPI_Aint row_offset = (MPI_Aint)found->length;
+    // Rows which follow each other in the file are merged into one block
+    if (num_blocks > 0 &&
+        offsets[num_blocks - 1] + lengths[num_blocks - 1] == row_offset) {
+      lengths[num_blocks - 1] += (int)length;
+    } else {
+      offsets[num_blocks] = row_offset;
+      lengths[num_blocks] = (int)length;
+      ++num_blocks;
+    }
+    used += length;
+  }
+
+  int status = 0;
+  MPI_File fh;
+  MPI_Datatype view;
+  if (MPI_File_open(mpi_comm, file_name, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                    MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+    fprintf(stderr, "error: could not open the manifest %s\n", file_name);
+    status = 1;
+  } else {
+    MPI_File_set_size(fh, 0);
+    MPI_Type_create_hindexed((int)num_blocks, lengths, offsets, MPI_BYTE,
+                             &view);
+    MPI_Type_commit(&view);
+    MPI_File_set_view(fh, 0, MPI_BYTE, view, "native", MPI_INFO_NULL);
+    if (MPI_File_write_all(fh, text, (int)used, MPI_BYTE,
+                           MPI_STATUS_IGNORE) != MPI_SUCCESS) {
+      fprintf(stderr, "error: could not write the manifest %s\n", file_name);
+      status = 1;
+    }
+    MPI_Type_free(&view);
+    MPI_File_close(&fh);
+  }
+  free(local);
+  free(all);
+  free(text);
+  free(offsets);
+  free(lengths);
+  return status;
+}
+
+void FreeManifest(Manifest *manifest) {
+  for (size_t i = 0; i < manifest->num_rows; ++i) {
+    free(manifest->rows[i].path);
+  }
+  free(manifest->rows);
+  manifest->rows = NULL;
+  manifest->num_rows = 0;
+  manifest->capacity = 0;
+}
@@ -0,0 +1,42 @@
+#ifndef WTH_MANIFEST_H_
+#define WTH_MANIFEST_H_
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mpi.h>
+
+#include "config.h"
+
+#define MANIFEST_MAGIC "GGCMIMAN"
+#define MANIFEST_VERSION 1
+// Bytes of the binary file header and of the fixed part of a binary row.
+#define MANIFEST_HEADER_SIZE 24
+#define MANIFEST_ROW_SIZE 44
+
+typedef struct ManifestRow_ {
+  uint64_t global_id;
+  double longitude;
+  double latitude;
+  uint64_t bytes;
+  uint32_t records;
+  uint32_t checksum;
+  int skipped;
+  char *path;
+} ManifestRow;
+
+// Rows of the cells written by one rank, kept in memory until the run ends.
+typedef struct Manifest_ {
+  int format;
+  size_t num_rows;
+  size_t capacity;
+  ManifestRow *rows;
+} Manifest;
+
+void InitManifest(Manifest *manifest, int format);
+int AddManifestRow(Manifest *manifest, const ManifestRow *row);
+size_t FormatManifestRow(const ManifestRow *row, int format, char *dest,
+                         size_t dest_size);
+int WriteManifest(Manifest *manifest, const char *file_name,
+                  MPI_Comm mpi_comm);
+void FreeManifest(Manifest *manifest);
+#endif // WTH_MANIFEST_H_
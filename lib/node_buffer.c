@@ -0,0 +1,88 @@
+#include <stdio.h>
+
+#include "node_buffer.h"
+
+// The part of length items a rank works on, in contiguous blocks which
+// differ by at most one item.
+void NodeShare(size_t length, int rank, int size, size_t *first,
+               size_t *count) {
+  size_t base = length / size;
+  size_t extra = length % size;
+  *first = rank * base + ((size_t)rank < extra ? (size_t)rank : extra);
+  *count = base + ((size_t)rank < extra ? 1 : 0);
+}
+
+int SplitNodes(MPI_Comm mpi_comm, NodeBuffer *node) {
+  int comm_rank;
+  MPI_Comm_rank(mpi_comm, &comm_rank);
+  node->leader_comm = MPI_COMM_NULL;
+  node->window = MPI_WIN_NULL;
+  node->values = NULL;
+  node->capacity = 0;
+  if (MPI_Comm_split_type(mpi_comm, MPI_COMM_TYPE_SHARED, comm_rank,
+                          MPI_INFO_NULL, &node->node_comm) != MPI_SUCCESS) {
+    fprintf(stderr, "error: [%d] unable to split the ranks by node\n",
+            comm_rank);
+    node->node_comm = MPI_COMM_NULL;
+    return 1;
+  }
+  MPI_Comm_rank(node->node_comm, &node->node_rank);
+  MPI_Comm_size(node->node_comm, &node->node_size);
+  MPI_Comm_split(mpi_comm, node->node_rank == 0 ? 0 : MPI_UNDEFINED,
+                 comm_rank, &node->leader_comm);
+  int placement[2] = {0, 0};
+  if (node->leader_comm != MPI_COMM_NULL) {
+    MPI_Comm_rank(node->leader_comm, &placement[0]);
+    MPI_Comm_size(node->leader_comm, &placement[1]);
+  }
+  MPI_Bcast(placement, 2, MPI_INT, 0, node->node_comm);
+  node->node_index = placement[0];
+  node->num_nodes = placement[1];
+  return 0;
+}
+
+// Allocates capacity floats on the leader, mapped into every rank of the
+// node. Collective over the node; the window stays open for passive access
+// until it is freed, with SyncNodeBuffer separating the phases.
+int AllocateNodeBuffer(NodeBuffer *node, size_t capacity) {
+  float *base = NULL;
+  MPI_Aint size = node->node_rank == 0 ? capacity * sizeof(float) : 0;
+  if (MPI_Win_allocate_shared(size, sizeof(float), MPI_INFO_NULL,
+                              node->node_comm, &base,
+                              &node->window) != MPI_SUCCESS) {
+    fprintf(stderr, "error: unable to allocate %zu bytes shared by the "
+                    "node\n",
+            capacity * sizeof(float));
+    node->window = MPI_WIN_NULL;
+    return 1;
+  }
+  int displacement;
+  MPI_Win_shared_query(node->window, 0, &size, &displacement, &node->values);
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, node->window);
+  node->capacity = capacity;
+  return 0;
+}
+
+// Makes the stores of every rank of the node visible to the others once all
+// of them get here, and returns the largest status passed in.
+int SyncNodeBuffer(NodeBuffer *node, int status) {
+  MPI_Win_sync(node->window);
+  MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MAX, node->node_comm);
+  MPI_Win_sync(node->window);
+  return status;
+}
+
+void FreeNodeBuffer(NodeBuffer *node) {
+  if (node->window != MPI_WIN_NULL) {
+    MPI_Win_unlock_all(node->window);
+    MPI_Win_free(&node->window);
+  }
+  node->values = NULL;
+  node->capacity = 0;
+  if (node->leader_comm != MPI_COMM_NULL) {
+    MPI_Comm_free(&node->leader_comm);
+  }
+  if (node->node_comm != MPI_COMM_NULL) {
+    MPI_Comm_free(&node->node_comm);
+  }
+}
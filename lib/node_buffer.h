@@ -0,0 +1,28 @@
+#ifndef WTH_NODE_BUFFER_H_
+#define WTH_NODE_BUFFER_H_
+#include <stddef.h>
+
+#include <mpi.h>
+
+// The ranks of a communicator which share a node, and a buffer allocated
+// once per node in an MPI-3 shared window. Rank 0 of each node leads it: it
+// owns the memory and the leaders together make up leader_comm.
+typedef struct NodeBuffer_ {
+  MPI_Comm node_comm;
+  MPI_Comm leader_comm;
+  int node_rank;
+  int node_size;
+  int node_index;
+  int num_nodes;
+  MPI_Win window;
+  float *values;
+  size_t capacity;
+} NodeBuffer;
+
+void NodeShare(size_t length, int rank, int size, size_t *first,
+               size_t *count);
+int SplitNodes(MPI_Comm mpi_comm, NodeBuffer *node);
+int AllocateNodeBuffer(NodeBuffer *node, size_t capacity);
+int SyncNodeBuffer(NodeBuffer *node, int status);
+void FreeNodeBuffer(NodeBuffer *node);
+#endif // WTH_NODE_BUFFER_H_
@@ -0,0 +1,212 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+
+#include "admission.h"
+#include "output_writer.h"
+#include "perf.h"
+
+typedef struct OutputJob_ {
+  char *file_name;
+  char *text;
+  size_t size;
+} OutputJob;
+
+struct OutputWriter_ {
+  int level;
+  Admission *admission;
+  size_t num_threads;
+  pthread_t *threads;
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+  OutputJob *queue;
+  size_t capacity;
+  size_t head;
+  size_t count;
+  int closing;
+  OutputStats stats;
+};
+
+// Deflates into a single gzip member, which is what gzip and zcat expect.
+int GzipBuffer(const char *source, size_t size, int level,
+               unsigned char **dest, size_t *dest_size) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  *dest = NULL;
+  *dest_size = 0;
+  if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return 1;
+  }
+  size_t bound = deflateBound(&stream, size);
+  unsigned char *buffer = (unsigned char *)malloc(bound);
+  if (buffer == NULL) {
+    deflateEnd(&stream);
+    return 1;
+  }
+  stream.next_in = (unsigned char *)source;
+  stream.avail_in = size;
+  stream.next_out = buffer;
+  stream.avail_out = bound;
+  int status = deflate(&stream, Z_FINISH);
+  deflateEnd(&stream);
+  if (status != Z_STREAM_END) {
+    free(buffer);
+    return 1;
+  }
+  *dest = buffer;
+  *dest_size = stream.total_out;
+  return 0;
+}
+
+// Compresses and writes one file, adding the outcome to stats. The file is
+// only opened once admission grants it a slot.
+static void WriteJob(const OutputJob *job, int level, Admission *admission,
+                     OutputStats *stats) {
+  double start = PerfWallTime();
+  unsigned char *compressed;
+  size_t compressed_size;
+  int failed = GzipBuffer(job->text, job->size, level, &compressed,
+                          &compressed_size);
+  stats->compress_seconds += PerfWallTime() - start;
+  if (!failed) {
+    double admitted = AdmitFile(admission);
+    FILE *fh = fopen(job->file_name, "wb");
+    if (fh == NULL) {
+      fprintf(stderr, "error: could not open file for writing: %s\n",
+              job->file_name);
+      failed = 1;
+    } else {
+      failed = fwrite(compressed, 1, compressed_size, fh) != compressed_size;
+      failed |= fclose(fh) != 0;
+      if (failed) {
+        fprintf(stderr, "error: could not write %s\n", job->file_name);
+      }
+    }
+    ReleaseFile(admission, admitted);
+    free(compressed);
+  } else {
+    fprintf(stderr, "error: could not compress %s\n", job->file_name);
+  }
+  ++stats->files;
+  stats->text_bytes += job->size;
+  if (failed) {
+    ++stats->failures;
+  } else {
+    stats->written_bytes += compressed_size;
+  }
+}
+
+static void *OutputWorker(void *arg) {
+  OutputWriter *writer = (OutputWriter *)arg;
+  OutputStats stats = {0, 0, 0, 0, 0.0};
+  pthread_mutex_lock(&writer->lock);
+  for (;;) {
+    while (writer->count == 0 && !writer->closing) {
+      pthread_cond_wait(&writer->not_empty, &writer->lock);
+    }
+    if (writer->count == 0) {
+      break;
+    }
+    OutputJob job = writer->queue[writer->head];
+    writer->head = (writer->head + 1) % writer->capacity;
+    --writer->count;
+    pthread_cond_signal(&writer->not_full);
+    pthread_mutex_unlock(&writer->lock);
+    WriteJob(&job, writer->level, writer->admission, &stats);
+    free(job.file_name);
+    free(job.text);
+    pthread_mutex_lock(&writer->lock);
+  }
+  writer->stats.files += stats.files;
+  writer->stats.failures += stats.failures;
+  writer->stats.text_bytes += stats.text_bytes;
+  writer->stats.written_bytes += stats.written_bytes;
+  writer->stats.compress_seconds += stats.compress_seconds;
+  pthread_mutex_unlock(&writer->lock);
+  return NULL;
+}
+
+OutputWriter *OpenOutputWriter(int level, size_t num_threads,
+                               Admission *admission) {
+  OutputWriter *writer = (OutputWriter *)calloc(1, sizeof(OutputWriter));
+  if (writer == NULL) {
+    return NULL;
+  }
+  writer->level = level;
+  writer->admission = admission;
+  writer->capacity = num_threads > 0 ? 4 * num_threads : 1;
+  writer->queue = (OutputJob *)malloc(sizeof(OutputJob) * writer->capacity);
+  writer->threads = (pthread_t *)malloc(sizeof(pthread_t) * (num_threads + 1));
+  if (writer->queue == NULL || writer->threads == NULL) {
+    free(writer->queue);
+    free(writer->threads);
+    free(writer);
+    return NULL;
+  }
+  pthread_mutex_init(&writer->lock, NULL);
+  pthread_cond_init(&writer->not_empty, NULL);
+  pthread_cond_init(&writer->not_full, NULL);
+  for (size_t t = 0; t < num_threads; ++t) {
+    if (pthread_create(&writer->threads[t], NULL, OutputWorker, writer)) {
+      fprintf(stderr, "warning: started %zu of %zu compression threads\n", t,
+              num_threads);
+      break;
+    }
+    ++writer->num_threads;
+  }
+  return writer;
+}
+
+// Takes ownership of text, which must come from malloc.
+int SubmitOutput(OutputWriter *writer, const char *file_name, char *text,
+                 size_t size) {
+  OutputJob job = {strdup(file_name), text, size};
+  if (job.file_name == NULL) {
+    free(text);
+    return 1;
+  }
+  if (writer->num_threads == 0) {
+    size_t failures = writer->stats.failures;
+    WriteJob(&job, writer->level, writer->admission, &writer->stats);
+    free(job.file_name);
+    free(job.text);
+    return writer->stats.failures != failures;
+  }
+  pthread_mutex_lock(&writer->lock);
+  while (writer->count == writer->capacity) {
+    pthread_cond_wait(&writer->not_full, &writer->lock);
+  }
+  writer->queue[(writer->head + writer->count) % writer->capacity] = job;
+  ++writer->count;
+  pthread_cond_signal(&writer->not_empty);
+  pthread_mutex_unlock(&writer->lock);
+  return 0;
+}
+
+// Waits for the queued files to be written and releases the writer.
+void CloseOutputWriter(OutputWriter *writer, OutputStats *stats) {
+  if (writer == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&writer->lock);
+  writer->closing = 1;
+  pthread_cond_broadcast(&writer->not_empty);
+  pthread_mutex_unlock(&writer->lock);
+  for (size_t t = 0; t < writer->num_threads; ++t) {
+    pthread_join(writer->threads[t], NULL);
+  }
+  if (stats != NULL) {
+    *stats = writer->stats;
+  }
+  pthread_cond_destroy(&writer->not_full);
+  pthread_cond_destroy(&writer->not_empty);
+  pthread_mutex_destroy(&writer->lock);
+  free(writer->queue);
+  free(writer->threads);
+  free(writer);
+}
@@ -0,0 +1,32 @@
+#ifndef WTH_OUTPUT_WRITER_H_
+#define WTH_OUTPUT_WRITER_H_
+#include <stddef.h>
+
+#include "admission.h"
+
+// Suffix of the files written by an OutputWriter.
+#define COMPRESSED_OUTPUT_SUFFIX ".gz"
+
+typedef struct OutputStats_ {
+  size_t files;
+  size_t failures;
+  size_t text_bytes;
+  size_t written_bytes;
+  double compress_seconds;
+} OutputStats;
+
+// Gzips rendered weather files and writes them on a pool of threads. The
+// queue in front of the pool is bounded so rendering blocks instead of
+// piling up text when the threads fall behind. Without threads the files are
+// compressed by the caller. With admission control, each file takes a slot
+// of the node while it is open.
+typedef struct OutputWriter_ OutputWriter;
+
+OutputWriter *OpenOutputWriter(int level, size_t num_threads,
+                               Admission *admission);
+int SubmitOutput(OutputWriter *writer, const char *file_name, char *text,
+                 size_t size);
+void CloseOutputWriter(OutputWriter *writer, OutputStats *stats);
+int GzipBuffer(const char *source, size_t size, int level,
+               unsigned char **dest, size_t *dest_size);
+#endif // WTH_OUTPUT_WRITER_H_
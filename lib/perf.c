@@ -0,0 +1,185 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/perf_event.h>
+
+#include "perf.h"
+
+static const char *kCounterNames[kPerfNumCounters] = {
+    "cycles", "instructions", "llc_misses", "branch_misses"};
+static const uint64_t kCounterConfigs[kPerfNumCounters] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+// Counter reads carry the enabled/running times so multiplexed counters can
+// be scaled back up to an estimate of the full phase.
+typedef struct PerfReading_ {
+  uint64_t value;
+  uint64_t time_enabled;
+  uint64_t time_running;
+} PerfReading;
+
+static int OpenCounter(uint64_t config) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+double PerfWallTime(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+}
+
+void InitPerfCounters(PerfCounters *counters, int enabled) {
+  counters->num_available = 0;
+  counters->enabled = enabled;
+  for (size_t i = 0; i < kPerfNumCounters; ++i) {
+    counters->fds[i] = -1;
+    if (!enabled) {
+      continue;
+    }
+    counters->fds[i] = OpenCounter(kCounterConfigs[i]);
+    if (counters->fds[i] == -1) {
+      // Containers and locked down kernels (perf_event_paranoid) refuse the
+      // syscall, so only phase timers are reported in that case.
+      fprintf(stderr, "warning: %s counter unavailable: %s\n",
+              kCounterNames[i], strerror(errno));
+    } else {
+      ++counters->num_available;
+    }
+  }
+}
+
+void FreePerfCounters(PerfCounters *counters) {
+  for (size_t i = 0; i < kPerfNumCounters; ++i) {
+    if (counters->fds[i] != -1) {
+      close(counters->fds[i]);
+      counters->fds[i] = -1;
+    }
+  }
+  counters->num_available = 0;
+  counters->enabled = 0;
+}
+
+void BeginPhase(PerfCounters *counters, PhaseSample *sample, const char *name) {
+  sample->name = name;
+  sample->seconds = 0.0;
+  sample->requested = counters != NULL && counters->enabled;
+  for (size_t i = 0; i < kPerfNumCounters; ++i) {
+    sample->counts[i] = 0;
+    sample->valid[i] = 0;
+    if (counters != NULL && counters->fds[i] != -1) {
+      ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+  sample->start = PerfWallTime();
+}
+
+void EndPhase(PerfCounters *counters, PhaseSample *sample) {
+  sample->seconds = PerfWallTime() - sample->start;
+  if (counters == NULL) {
+    return;
+  }
+  PerfReading reading;
+  for (size_t i = 0; i < kPerfNumCounters; ++i) {
+    if (counters->fds[i] == -1) {
+      continue;
+    }
+    ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    if (read(counters->fds[i], &reading, sizeof(reading)) !=
+        sizeof(reading)) {
+      continue;
+    }
+    if (reading.time_running == 0) {
+      continue;
+    }
+    if (reading.time_running < reading.time_enabled) {
+      reading.value = (uint64_t)((double)reading.value *
+                                 ((double)reading.time_enabled /
+                                  (double)reading.time_running));
+    }
+    sample->counts[i] = reading.value;
+    sample->valid[i] = 1;
+  }
+}
+
+void AccumulatePhase(PhaseSample *total, const PhaseSample *sample) {
+  total->seconds += sample->seconds;
+  total->requested |= sample->requested;
+  for (size_t i = 0; i < kPerfNumCounters; ++i) {
+    if (sample->valid[i]) {
+      total->counts[i] += sample->counts[i];
+      total->valid[i] = 1;
+    }
+  }
+}
+
+// Renders the line of a phase: its time and, when counters were requested,
+// each of them, with those the kernel refused or did not schedule as n/a.
+size_t FormatPhaseSample(int rank, const PhaseSample *sample, char *dest,
+                         size_t size) {
+  int len = snprintf(dest, size, "[%d] Phase %-10s %10.3f s", rank,
+                     sample->name, sample->seconds);
+  for (size_t i = 0; i < kPerfNumCounters && len < (int)size; ++i) {
+    if (sample->valid[i]) {
+      len += snprintf(dest + len, size - len, " %s=%llu", kCounterNames[i],
+                      (unsigned long long)sample->counts[i]);
+    } else if (sample->requested) {
+      len += snprintf(dest + len, size - len, " %s=n/a", kCounterNames[i]);
+    }
+  }
+  if (len < (int)size && sample->valid[kPerfCycles] &&
+      sample->valid[kPerfInstructions] && sample->counts[kPerfCycles] > 0) {
+    len += snprintf(dest + len, size - len, " ipc=%.2f",
+                    (double)sample->counts[kPerfInstructions] /
+                        (double)sample->counts[kPerfCycles]);
+  }
+  return (size_t)len;
+}
+
+void PrintPhaseSample(int rank, const PhaseSample *sample) {
+  char line[512];
+  FormatPhaseSample(rank, sample, line, sizeof(line));
+  printf("%s\n", line);
+}
+
+size_t CurrentRssBytes(void) {
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (statm == NULL) {
+    return 0;
+  }
+  unsigned long size_pages;
+  unsigned long resident_pages;
+  int fields = fscanf(statm, "%lu %lu", &size_pages, &resident_pages);
+  fclose(statm);
+  if (fields != 2) {
+    return 0;
+  }
+  return (size_t)resident_pages * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+size_t PeakRssBytes(void) {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage)) {
+    return 0;
+  }
+  // Linux reports ru_maxrss in kilobytes.
+  return (size_t)usage.ru_maxrss * 1024;
+}
@@ -0,0 +1,42 @@
+#ifndef WTH_PERF_H_
+#define WTH_PERF_H_
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+  kPerfCycles,
+  kPerfInstructions,
+  kPerfLlcMisses,
+  kPerfBranchMisses,
+  kPerfNumCounters
+};
+
+typedef struct PerfCounters_ {
+  int fds[kPerfNumCounters];
+  int num_available;
+  int enabled;
+} PerfCounters;
+
+// Requested is set when the phase was measured with counters enabled, so a
+// counter which is not valid then is reported as unavailable.
+typedef struct PhaseSample_ {
+  const char *name;
+  double start;
+  double seconds;
+  uint64_t counts[kPerfNumCounters];
+  int valid[kPerfNumCounters];
+  int requested;
+} PhaseSample;
+
+double PerfWallTime(void);
+void InitPerfCounters(PerfCounters *counters, int enabled);
+void FreePerfCounters(PerfCounters *counters);
+void BeginPhase(PerfCounters *counters, PhaseSample *sample, const char *name);
+void EndPhase(PerfCounters *counters, PhaseSample *sample);
+void AccumulatePhase(PhaseSample *total, const PhaseSample *sample);
+size_t FormatPhaseSample(int rank, const PhaseSample *sample, char *dest,
+                         size_t size);
+void PrintPhaseSample(int rank, const PhaseSample *sample);
+size_t CurrentRssBytes(void);
+size_t PeakRssBytes(void);
+#endif // WTH_PERF_H_
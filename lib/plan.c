@@ -0,0 +1,353 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <netcdf.h>
+
+#include "plan.h"
+#include "rechunk.h"
+
+static const char *kLongitudeString = "lon";
+static const char *kLatitudeString = "lat";
+static const char *kTimeString = "time";
+
+static double FileBytes(const char *file_name) {
+  struct stat source;
+  return stat(file_name, &source) == 0 ? (double)source.st_size : 0.0;
+}
+
+static size_t CeilDiv(size_t value, size_t divisor) {
+  return (value + divisor - 1) / divisor;
+}
+
+// Reads the chunk shape of the variable of an open mapping. The bytes of a
+// chunk on disk are those of the files of the mapping spread over its
+// chunks, which makes compressed chunks count at their compressed size.
+int InspectPlanInput(const FileConfig *mapping, const NetCdfInfo *info,
+                     PlanInput *input) {
+  input->chunked = 0;
+  input->chunk_days = 0;
+  input->chunk_y = 0;
+  input->chunk_x = 0;
+  input->chunk_bytes = 0.0;
+  if (mapping->derived != NULL) {
+    return 0;
+  }
+  int status;
+  int storage;
+  size_t chunks[NC_MAX_VAR_DIMS];
+  int var_dimids[NC_MAX_VAR_DIMS];
+  int time_dimid;
+  int latitude_dimid;
+  if ((status = nc_inq_var_chunking(mapping->netcdf_id, info->var_varid,
+                                    &storage, chunks)) ||
+      (status = nc_inq_vardimid(mapping->netcdf_id, info->var_varid,
+                                var_dimids)) ||
+      (status = nc_inq_dimid(mapping->netcdf_id, kTimeString, &time_dimid)) ||
+      (status = nc_inq_dimid(mapping->netcdf_id, kLatitudeString,
+                             &latitude_dimid))) {
+    fprintf(stderr, "error: cannot inquire the storage of %s in %s: %s\n",
+            mapping->netcdf_var, mapping->file_name, nc_strerror(status));
+    return 1;
+  }
+  if (storage != NC_CHUNKED) {
+    return 0;
+  }
+  input->chunked = 1;
+  for (size_t d = 0; d < 3; ++d) {
+    if (var_dimids[d] == time_dimid) {
+      input->chunk_days = chunks[d];
+    } else if (var_dimids[d] == latitude_dimid) {
+      input->chunk_y = chunks[d];
+    } else {
+      input->chunk_x = chunks[d];
+    }
+  }
+  // A point-major store made by --rechunk is read in place of the file
+  double bytes = 0.0;
+  char store_name[2048];
+  if (info->point_major &&
+      !PointMajorFileName(mapping->file_name, store_name,
+                          sizeof(store_name))) {
+    bytes = FileBytes(store_name);
+  } else {
+    bytes = FileBytes(mapping->file_name);
+    for (size_t k = 0; k < mapping->num_parts; ++k) {
+      bytes += FileBytes(mapping->parts[k]);
+    }
+    // The chunks of an ensemble are read once from every model
+    for (size_t k = 0; k < mapping->num_members; ++k) {
+      bytes += FileBytes(mapping->members[k]);
+    }
+  }
+  double num_chunks = (double)CeilDiv(info->time_len, input->chunk_days) *
+                      CeilDiv(info->latitude_len, input->chunk_y) *
+                      CeilDiv(info->longitude_len, input->chunk_x);
+  input->chunk_bytes =
+      bytes > 0.0 ? bytes / num_chunks
+                  : (double)input->chunk_days * input->chunk_y *
+                        input->chunk_x * sizeof(float);
+  return 0;
+}
+
+static size_t ChunkSpan(size_t first, size_t length, size_t chunk) {
+  if (length == 0) {
+    return 0;
+  }
+  return (first + length - 1) / chunk - first / chunk + 1;
+}
+
+// The chunks a read of the slab has to decompress. Contiguous variables
+// have none.
+size_t ChunksTouched(const PlanInput *input, Hyperslab slab) {
+  if (!input->chunked) {
+    return 0;
+  }
+  return ChunkSpan(slab.corner.day, slab.edges.days, input->chunk_days) *
+         ChunkSpan(slab.corner.y, slab.edges.y_length, input->chunk_y) *
+         ChunkSpan(slab.corner.x, slab.edges.x_length, input->chunk_x);
+}
+
+double PlannedReadBytes(const PlanInput *input, Hyperslab slab) {
+  if (!input->chunked) {
+    return (double)slab.flat_size * sizeof(float);
+  }
+  return ChunksTouched(input, slab) * input->chunk_bytes;
+}
+
+// Reads the first variable on the (lat, lon) grid of a NetCDF file as a mask
+// where cells holding a value other than zero or the fill value are land.
+// The grid has to match the grid of the inputs.
+unsigned char *ReadLandMask(const char *file_name, size_t longitude_len,
+                            size_t latitude_len) {
+  int status;
+  int ncid;
+  if ((status = nc_open(file_name, NC_NOWRITE, &ncid))) {
+    fprintf(stderr, "error: cannot open file %s: %s\n", file_name,
+            nc_strerror(status));
+    return NULL;
+  }
+  int num_dims, num_vars, num_gattrs, num_unlimited;
+  int longitude_dimid, latitude_dimid;
+  size_t mask_longitude_len, mask_latitude_len;
+  if ((status = nc_inq(ncid, &num_dims, &num_vars, &num_gattrs,
+                       &num_unlimited)) ||
+      (status = nc_inq_dimid(ncid, kLongitudeString, &longitude_dimid)) ||
+      (status = nc_inq_dimlen(ncid, longitude_dimid, &mask_longitude_len)) ||
+      (status = nc_inq_dimid(ncid, kLatitudeString, &latitude_dimid)) ||
+      (status = nc_inq_dimlen(ncid, latitude_dimid, &mask_latitude_len))) {
+    fprintf(stderr, "error: cannot inquire the grid of %s: %s\n", file_name,
+            nc_strerror(status));
+    nc_close(ncid);
+    return NULL;
+  }
+  if (mask_longitude_len != longitude_len ||
+      mask_latitude_len != latitude_len) {
+    fprintf(stderr, "error: the land mask %s is on a %zux%zu grid, the "
+                    "inputs on %zux%zu\n",
+            file_name, mask_longitude_len, mask_latitude_len, longitude_len,
+            latitude_len);
+    nc_close(ncid);
+    return NULL;
+  }
+  int varid = -1;
+  for (int v = 0; v < num_vars && varid == -1; ++v) {
+    int var_dims;
+    int var_dimids[NC_MAX_VAR_DIMS];
+    if (nc_inq_varndims(ncid, v, &var_dims) == NC_NOERR && var_dims == 2 &&
+        nc_inq_vardimid(ncid, v, var_dimids) == NC_NOERR &&
+        var_dimids[0] == latitude_dimid && var_dimids[1] == longitude_dimid) {
+      varid = v;
+    }
+  }
+  if (varid == -1) {
+    fprintf(stderr, "error: %s has no variable on the (lat, lon) grid\n",
+            file_name);
+    nc_close(ncid);
+    return NULL;
+  }
+  size_t cells = longitude_len * latitude_len;
+  float *values = (float *)malloc(sizeof(float) * cells);
+  unsigned char *mask = (unsigned char *)malloc(cells);
+  if (values == NULL || mask == NULL) {
+    fprintf(stderr, "error: unable to allocate the land mask of %s\n",
+            file_name);
+    free(values);
+    free(mask);
+    nc_close(ncid);
+    return NULL;
+  }
+  float fill_value = NC_FILL_FLOAT;
+  if (nc_get_att_float(ncid, varid, "_FillValue", &fill_value) != NC_NOERR) {
+    nc_get_att_float(ncid, varid, "missing_value", &fill_value);
+  }
+  if ((status = nc_get_var_float(ncid, varid, values))) {
+    fprintf(stderr, "error: cannot read the land mask of %s: %s\n", file_name,
+            nc_strerror(status));
+    free(values);
+    free(mask);
+    nc_close(ncid);
+    return NULL;
+  }
+  nc_close(ncid);
+  for (size_t i = 0; i < cells; ++i) {
+    mask[i] = values[i] == values[i] && values[i] != fill_value &&
+              values[i] != 0.0f;
+  }
+  free(values);
+  return mask;
+}
+
+// The cells of the slab which get a weather file: its land cells, or all of
+// them without a mask.
+size_t CountLandCells(const unsigned char *mask, size_t longitude_len,
+                      Hyperslab slab) {
+  if (mask == NULL) {
+    return slab.edges.x_length * slab.edges.y_length;
+  }
+  size_t land = 0;
+  for (size_t y = 0; y < slab.edges.y_length; ++y) {
+    const unsigned char *row =
+        &mask[(slab.corner.y + y) * longitude_len + slab.corner.x];
+    for (size_t x = 0; x < slab.edges.x_length; ++x) {
+      land += row[x];
+    }
+  }
+  return land;
+}
+
+// The bytes a rank holds per value of a tile: the raw buffers (a second one
+// when reading ahead) and the converted one per mapping, or for a quantized
+// tile two bytes per mapping and the float regions of each raw buffer. An
+// ensemble reads its other models through one more float per value.
+size_t TileValueBytes(const Config *config, size_t num_regions) {
+  size_t num_buffers = config->prefetch ? 3 : 2;
+  size_t scratch = 0;
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    if (config->mappings[m].num_members > 0) {
+      scratch = sizeof(float);
+    }
+  }
+  if (config->quantize) {
+    return (num_buffers - 1) * (config->num_mappings * sizeof(int16_t) +
+                                num_regions * sizeof(float)) +
+           scratch;
+  }
+  return num_buffers * config->num_mappings * sizeof(float) + scratch;
+}
+
+// The budget SubdivideHyperslab is given for the room a rank has left next to
+// its baseline, scaled from value_bytes per value to the two float buffers
+// per mapping which it accounts for.
+size_t SubdivisionBudget(const Config *config, size_t budget,
+                         size_t baseline_bytes, size_t value_bytes) {
+  return (budget - baseline_bytes) / value_bytes * 2 * config->num_mappings *
+         sizeof(float);
+}
+
+// Predicts the work of the rank reading slab the way a run does: the slab
+// is subdivided to fit max_memory_per_rank next to baseline_bytes, and each
+// of its tiles decompresses the chunks it touches again.
+int PlanRank(const Config *config, const PlanInput *inputs,
+             const unsigned char *mask, size_t longitude_len, Hyperslab slab,
+             size_t value_bytes, size_t baseline_bytes, RankPlan *plan) {
+  plan->slab = slab;
+  plan->cells = slab.edges.x_length * slab.edges.y_length;
+  plan->files = CountLandCells(mask, longitude_len, slab);
+  plan->tiles = 0;
+  plan->largest_tile = Edges(0, 0, 0);
+  plan->peak_bytes = baseline_bytes;
+  plan->chunks = 0;
+  plan->read_bytes = 0.0;
+  if (plan->cells == 0) {
+    return 0;
+  }
+  size_t num_tiles = 1;
+  Hyperslab *tiles = &slab;
+  size_t budget = config->max_memory_per_rank;
+  if (budget > 0 && config->read_strategy == read_tiles) {
+    if (baseline_bytes >= budget) {
+      fprintf(stderr, "error: max_memory_per_rank (%zu bytes) is already "
+                      "used by the process and chunk caches (%zu bytes)\n",
+              budget, baseline_bytes);
+      return 1;
+    }
+    tiles = SubdivideHyperslab(
+        slab, config->num_mappings,
+        SubdivisionBudget(config, budget, baseline_bytes, value_bytes),
+        &num_tiles);
+    if (tiles == NULL) {
+      return 1;
+    }
+  }
+  plan->tiles = num_tiles;
+  for (size_t t = 0; t < num_tiles; ++t) {
+    HyperslabEdges edges = tiles[t].edges;
+    if (edges.days * edges.x_length * edges.y_length >
+        plan->largest_tile.days * plan->largest_tile.x_length *
+            plan->largest_tile.y_length) {
+      plan->largest_tile = edges;
+    }
+    for (size_t m = 0; m < config->num_mappings; ++m) {
+      if (config->mappings[m].derived == NULL) {
+        plan->chunks += ChunksTouched(&inputs[m], tiles[t]);
+        plan->read_bytes += PlannedReadBytes(&inputs[m], tiles[t]);
+      }
+    }
+  }
+  plan->peak_bytes += plan->largest_tile.days * plan->largest_tile.x_length *
+                      plan->largest_tile.y_length * value_bytes;
+  if (tiles != &slab) {
+    free(tiles);
+  }
+  return 0;
+}
+
+// The most ranks up to the cores of a node whose slabs of the extent fit the
+// node memory whole when the extent is split over one node. When none does,
+// the slabs have to be subdivided: every core gets a rank as long as each
+// one has room for the series of a cell next to its baseline.
+int AdviseRanks(Hyperslab extent, size_t value_bytes, size_t baseline_bytes,
+                size_t node_memory, size_t cores, PlanAdvice *advice) {
+  advice->ranks_per_node = 0;
+  advice->threads_per_rank = 1;
+  advice->max_memory_per_rank = 0;
+  advice->subdivided = 0;
+  for (size_t ranks = cores; ranks > 0; --ranks) {
+    // Not a rank of any run, so the candidates are not printed
+    Hyperslab *slabs = AllocateHyperslabs(extent.corner, extent.edges, ranks,
+                                          -1);
+    if (slabs == NULL) {
+      return 1;
+    }
+    size_t largest = 0;
+    for (size_t r = 0; r < ranks; ++r) {
+      if (slabs[r].flat_size > largest) {
+        largest = slabs[r].flat_size;
+      }
+    }
+    free(slabs);
+    if (ranks * (baseline_bytes + largest * value_bytes) <= node_memory) {
+      advice->ranks_per_node = ranks;
+      advice->threads_per_rank = cores / ranks;
+      return 0;
+    }
+  }
+  size_t cell_bytes = extent.edges.days * value_bytes;
+  size_t ranks = cores;
+  while (ranks > 0 && node_memory / ranks < baseline_bytes + cell_bytes) {
+    --ranks;
+  }
+  if (ranks == 0) {
+    fprintf(stderr, "error: %zu bytes per node cannot hold a rank (%zu "
+                    "bytes) and the series of a cell (%zu bytes)\n",
+            node_memory, baseline_bytes, cell_bytes);
+    return 1;
+  }
+  advice->ranks_per_node = ranks;
+  advice->threads_per_rank = cores / ranks;
+  advice->max_memory_per_rank = node_memory / ranks;
+  advice->subdivided = 1;
+  return 0;
+}
@@ -0,0 +1,58 @@
+#ifndef WTH_PLAN_H_
+#define WTH_PLAN_H_
+#include <stddef.h>
+
+#include "config.h"
+#include "hyperslab.h"
+#include "io.h"
+
+// How a mapping is stored: the chunk shape of its variable along the days,
+// rows and columns of the grid, and the bytes a chunk takes on disk on
+// average. Contiguous variables have no chunks and are read as they are.
+typedef struct PlanInput_ {
+  int chunked;
+  size_t chunk_days;
+  size_t chunk_y;
+  size_t chunk_x;
+  double chunk_bytes;
+} PlanInput;
+
+// The predicted work of one rank for its slab of the extent.
+typedef struct RankPlan_ {
+  Hyperslab slab;
+  size_t cells;
+  size_t files;
+  size_t tiles;
+  HyperslabEdges largest_tile;
+  size_t peak_bytes;
+  size_t chunks;
+  double read_bytes;
+} RankPlan;
+
+// The ranks per node a node memory budget fits, and the threads each of them
+// gets from the remaining cores. Subdivided is set when even one rank per
+// core needs max_memory_per_rank to split its slab.
+typedef struct PlanAdvice_ {
+  size_t ranks_per_node;
+  size_t threads_per_rank;
+  size_t max_memory_per_rank;
+  int subdivided;
+} PlanAdvice;
+
+int InspectPlanInput(const FileConfig *mapping, const NetCdfInfo *info,
+                     PlanInput *input);
+size_t ChunksTouched(const PlanInput *input, Hyperslab slab);
+double PlannedReadBytes(const PlanInput *input, Hyperslab slab);
+unsigned char *ReadLandMask(const char *file_name, size_t longitude_len,
+                            size_t latitude_len);
+size_t CountLandCells(const unsigned char *mask, size_t longitude_len,
+                      Hyperslab slab);
+size_t TileValueBytes(const Config *config, size_t num_regions);
+size_t SubdivisionBudget(const Config *config, size_t budget,
+                         size_t baseline_bytes, size_t value_bytes);
+int PlanRank(const Config *config, const PlanInput *inputs,
+             const unsigned char *mask, size_t longitude_len, Hyperslab slab,
+             size_t value_bytes, size_t baseline_bytes, RankPlan *plan);
+int AdviseRanks(Hyperslab extent, size_t value_bytes, size_t baseline_bytes,
+                size_t node_memory, size_t cores, PlanAdvice *advice);
+#endif // WTH_PLAN_H_
@@ -0,0 +1,119 @@
+#include <stdio.h>
+
+#include "perf.h"
+#include "prefetch.h"
+
+static void *PrefetchThread(void *arg) {
+  Prefetcher *prefetcher = (Prefetcher *)arg;
+  for (size_t t = 0; t < prefetcher->num_tiles; ++t) {
+    // A slot can be refilled once the tile it held has been released
+    pthread_mutex_lock(&prefetcher->lock);
+    while (!prefetcher->stop &&
+           t >= prefetcher->released + prefetcher->num_slots) {
+      pthread_cond_wait(&prefetcher->cond, &prefetcher->lock);
+    }
+    int stop = prefetcher->stop;
+    pthread_mutex_unlock(&prefetcher->lock);
+    if (stop) {
+      break;
+    }
+    if (prefetcher->advise != NULL && t + 1 < prefetcher->num_tiles) {
+      prefetcher->advise(prefetcher->context, t + 1);
+    }
+    double start = PerfWallTime();
+    int failed = prefetcher->read(prefetcher->context, t,
+                                  t % prefetcher->num_slots);
+    double elapsed = PerfWallTime() - start;
+    pthread_mutex_lock(&prefetcher->lock);
+    prefetcher->read_seconds += elapsed;
+    if (failed) {
+      prefetcher->failed = 1;
+    } else {
+      prefetcher->ready = t + 1;
+    }
+    pthread_cond_broadcast(&prefetcher->cond);
+    pthread_mutex_unlock(&prefetcher->lock);
+    if (failed) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+int StartPrefetcher(Prefetcher *prefetcher, size_t num_tiles,
+                    PrefetchReadFunction read, PrefetchAdviseFunction advise,
+                    void *context, int threaded) {
+  prefetcher->read = read;
+  prefetcher->advise = advise;
+  prefetcher->context = context;
+  prefetcher->num_tiles = num_tiles;
+  prefetcher->num_slots = threaded ? PREFETCH_SLOTS : 1;
+  prefetcher->ready = 0;
+  prefetcher->released = 0;
+  prefetcher->failed = 0;
+  prefetcher->stop = 0;
+  prefetcher->threaded = threaded;
+  prefetcher->read_seconds = 0.0;
+  prefetcher->wait_seconds = 0.0;
+  pthread_mutex_init(&prefetcher->lock, NULL);
+  pthread_cond_init(&prefetcher->cond, NULL);
+  if (threaded && pthread_create(&prefetcher->thread, NULL, PrefetchThread,
+                                 prefetcher)) {
+    fprintf(stderr, "warning: cannot start the prefetch thread, reading "
+                    "tiles on demand\n");
+    prefetcher->threaded = 0;
+  }
+  return prefetcher->threaded;
+}
+
+int WaitForTile(Prefetcher *prefetcher, size_t tile, size_t *slot) {
+  *slot = tile % prefetcher->num_slots;
+  double start = PerfWallTime();
+  if (!prefetcher->threaded) {
+    if (prefetcher->advise != NULL && tile + 1 < prefetcher->num_tiles) {
+      prefetcher->advise(prefetcher->context, tile + 1);
+    }
+    int failed = prefetcher->read(prefetcher->context, tile, *slot);
+    double elapsed = PerfWallTime() - start;
+    prefetcher->read_seconds += elapsed;
+    prefetcher->wait_seconds += elapsed;
+    return failed;
+  }
+  pthread_mutex_lock(&prefetcher->lock);
+  while (prefetcher->ready <= tile && !prefetcher->failed) {
+    pthread_cond_wait(&prefetcher->cond, &prefetcher->lock);
+  }
+  int failed = prefetcher->ready <= tile;
+  pthread_mutex_unlock(&prefetcher->lock);
+  prefetcher->wait_seconds += PerfWallTime() - start;
+  return failed;
+}
+
+void ReleaseTile(Prefetcher *prefetcher, size_t tile) {
+  pthread_mutex_lock(&prefetcher->lock);
+  prefetcher->released = tile + 1;
+  pthread_cond_broadcast(&prefetcher->cond);
+  pthread_mutex_unlock(&prefetcher->lock);
+}
+
+void StopPrefetcher(Prefetcher *prefetcher) {
+  if (prefetcher->threaded) {
+    pthread_mutex_lock(&prefetcher->lock);
+    prefetcher->stop = 1;
+    pthread_cond_broadcast(&prefetcher->cond);
+    pthread_mutex_unlock(&prefetcher->lock);
+    pthread_join(prefetcher->thread, NULL);
+    prefetcher->threaded = 0;
+  }
+  pthread_cond_destroy(&prefetcher->cond);
+  pthread_mutex_destroy(&prefetcher->lock);
+}
+
+// Share of the read time spent while the main thread was busy elsewhere.
+double PrefetchOverlap(const Prefetcher *prefetcher) {
+  if (prefetcher->read_seconds <= 0.0) {
+    return 0.0;
+  }
+  double hidden = prefetcher->read_seconds - prefetcher->wait_seconds;
+  return hidden > 0.0 ? hidden / prefetcher->read_seconds : 0.0;
+}
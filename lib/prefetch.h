@@ -0,0 +1,43 @@
+#ifndef WTH_PREFETCH_H_
+#define WTH_PREFETCH_H_
+#include <stddef.h>
+
+#include <pthread.h>
+
+// Number of tile buffers in flight when reading ahead.
+#define PREFETCH_SLOTS 2
+
+// Reads tile into buffer slot, returns non-zero on failure.
+typedef int (*PrefetchReadFunction)(void *context, size_t tile, size_t slot);
+// Hints the kernel about a tile which will be read next.
+typedef void (*PrefetchAdviseFunction)(void *context, size_t tile);
+
+// Double-buffered tile reader. With a background thread the next tile is
+// read while the current one is used; without it tiles are read on demand
+// through the same calls.
+typedef struct Prefetcher_ {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  PrefetchReadFunction read;
+  PrefetchAdviseFunction advise;
+  void *context;
+  size_t num_tiles;
+  size_t num_slots;
+  size_t ready;
+  size_t released;
+  int failed;
+  int stop;
+  int threaded;
+  double read_seconds;
+  double wait_seconds;
+} Prefetcher;
+
+int StartPrefetcher(Prefetcher *prefetcher, size_t num_tiles,
+                    PrefetchReadFunction read, PrefetchAdviseFunction advise,
+                    void *context, int threaded);
+int WaitForTile(Prefetcher *prefetcher, size_t tile, size_t *slot);
+void ReleaseTile(Prefetcher *prefetcher, size_t tile);
+void StopPrefetcher(Prefetcher *prefetcher);
+double PrefetchOverlap(const Prefetcher *prefetcher);
+#endif // WTH_PREFETCH_H_
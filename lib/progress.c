@@ -0,0 +1,323 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "perf.h"
+#include "progress.h"
+
+static const char *kMetricPrefix = "ggcmiw_";
+
+// The counters as the thread sees them at one moment.
+static void SampleProgress(const Progress *progress, ProgressSample *sample) {
+  sample->cells_done =
+      __atomic_load_n(&progress->cells_done, __ATOMIC_RELAXED);
+  sample->cells_total = progress->cells_total;
+  sample->bytes_written =
+      __atomic_load_n(&progress->bytes_written, __ATOMIC_RELAXED);
+  sample->elapsed_seconds = PerfWallTime() - progress->start;
+  sample->eta_seconds = -1.0;
+  if (sample->cells_done >= sample->cells_total) {
+    sample->eta_seconds = 0.0;
+  } else if (sample->cells_done > 0) {
+    sample->eta_seconds = sample->elapsed_seconds *
+                          (sample->cells_total - sample->cells_done) /
+                          sample->cells_done;
+  }
+  sample->updated = (double)time(NULL);
+}
+
+size_t ProgressFileName(const Progress *progress, int world_rank,
+                        char *dest_str, size_t dest_size) {
+  size_t size = snprintf(dest_str, dest_size,
+                         progress->format == progress_prometheus
+                             ? "%sggcmiw_rank_%d.prom"
+                             : "%srank-%d.progress",
+                         progress->dir, world_rank);
+  return size >= dest_size;
+}
+
+static void WriteMetric(FILE *fh, const Progress *progress, const char *name,
+                        const char *help, double value) {
+  fprintf(fh, "# HELP %s%s %s\n# TYPE %s%s gauge\n", kMetricPrefix, name, help,
+          kMetricPrefix, name);
+  fprintf(fh, "%s%s{rank=\"%d\",scenario=\"%s\"} %.17g\n", kMetricPrefix,
+          name, progress->world_rank, progress->scenario, value);
+}
+
+// Writes the file of the rank next to its final name and renames it over
+// the previous one, so readers never see half of it.
+int WriteProgressFile(const Progress *progress) {
+  char file_name[2048];
+  char temp_name[2048 + 4];
+  if (ProgressFileName(progress, progress->world_rank, file_name,
+                       sizeof(file_name))) {
+    return 1;
+  }
+  snprintf(temp_name, sizeof(temp_name), "%s.tmp", file_name);
+  ProgressSample sample;
+  SampleProgress(progress, &sample);
+  const char *phase = __atomic_load_n(&progress->phase, __ATOMIC_RELAXED);
+  FILE *fh = fopen(temp_name, "w");
+  if (fh == NULL) {
+    return 1;
+  }
+  if (progress->format == progress_prometheus) {
+    WriteMetric(fh, progress, "cells_done",
+                "Cells of the rank's slab processed so far.",
+                (double)sample.cells_done);
+    WriteMetric(fh, progress, "cells_total", "Cells of the rank's slab.",
+                (double)sample.cells_total);
+    WriteMetric(fh, progress, "bytes_written",
+                "Bytes of weather file text written so far.",
+                (double)sample.bytes_written);
+    WriteMetric(fh, progress, "elapsed_seconds",
+                "Seconds since the rank started reading.",
+                sample.elapsed_seconds);
+    WriteMetric(fh, progress, "eta_seconds",
+                "Predicted seconds until the rank is done, -1 if unknown.",
+                sample.eta_seconds);
+    WriteMetric(fh, progress, "updated_seconds",
+                "Unix time of this sample.", sample.updated);
+    fprintf(fh, "# HELP %sphase The phase the rank is in.\n"
+                "# TYPE %sphase gauge\n",
+            kMetricPrefix, kMetricPrefix);
+    fprintf(fh, "%sphase{rank=\"%d\",scenario=\"%s\",phase=\"%s\"} 1\n",
+            kMetricPrefix, progress->world_rank, progress->scenario, phase);
+  } else {
+    fprintf(fh, "scenario %s\nrank %d\nphase %s\n", progress->scenario,
+            progress->world_rank, phase);
+    fprintf(fh, "cells_done %zu\ncells_total %zu\nbytes_written %zu\n",
+            sample.cells_done, sample.cells_total, sample.bytes_written);
+    fprintf(fh, "elapsed_seconds %.3f\neta_seconds %.3f\nupdated_seconds "
+                "%.0f\n",
+            sample.elapsed_seconds, sample.eta_seconds, sample.updated);
+  }
+  if (fclose(fh) != 0 || rename(temp_name, file_name) != 0) {
+    remove(temp_name);
+    return 1;
+  }
+  return 0;
+}
+
+// Reads the numbers of a file in either format back: each line which is not
+// a comment is a name, optionally with the metric prefix and labels, and a
+// value at its end. Returns 1 when the file cannot be read or misses cells.
+int ReadProgressFile(const char *file_name, ProgressSample *sample) {
+  memset(sample, 0, sizeof(ProgressSample));
+  sample->cells_total = 0;
+  sample->eta_seconds = -1.0;
+  FILE *fh = fopen(file_name, "r");
+  if (fh == NULL) {
+    return 1;
+  }
+  int found = 0;
+  char line[1024];
+  while (fgets(line, sizeof(line), fh) != NULL) {
+    if (line[0] == '#') {
+      continue;
+    }
+    char *name = line;
+    if (strncmp(name, kMetricPrefix, strlen(kMetricPrefix)) == 0) {
+      name += strlen(kMetricPrefix);
+    }
+    size_t name_len = strcspn(name, " {");
+    char *value_str = strrchr(line, ' ');
+    if (value_str == NULL) {
+      continue;
+    }
+    double value = strtod(value_str + 1, NULL);
+    if (name_len == 10 && strncmp(name, "cells_done", 10) == 0) {
+      sample->cells_done = (size_t)value;
+      found |= 1;
+    } else if (name_len == 11 && strncmp(name, "cells_total", 11) == 0) {
+      sample->cells_total = (size_t)value;
+      found |= 2;
+    } else if (name_len == 13 && strncmp(name, "bytes_written", 13) == 0) {
+      sample->bytes_written = (size_t)value;
+    } else if (name_len == 15 && strncmp(name, "elapsed_seconds", 15) == 0) {
+      sample->elapsed_seconds = value;
+    } else if (name_len == 11 && strncmp(name, "eta_seconds", 11) == 0) {
+      sample->eta_seconds = value;
+    } else if (name_len == 15 && strncmp(name, "updated_seconds", 15) == 0) {
+      sample->updated = value;
+    }
+  }
+  fclose(fh);
+  return found != 3;
+}
+
+// Prints one line for the ranks of the run from their files: the cells and
+// bytes done, the ranks whose file has not changed for a few intervals, and
+// the slowest rank, whose ETA is that of the run.
+static void PrintProgressReport(const Progress *progress) {
+  size_t cells_done = 0;
+  size_t cells_total = 0;
+  size_t bytes_written = 0;
+  size_t reporting = 0;
+  size_t stale = 0;
+  int slowest_rank = -1;
+  double slowest_fraction = 2.0;
+  double eta = 0.0;
+  double now = (double)time(NULL);
+  for (size_t r = 0; r < progress->num_report_ranks; ++r) {
+    char file_name[2048];
+    ProgressSample sample;
+    if (ProgressFileName(progress, progress->report_ranks[r], file_name,
+                         sizeof(file_name)) ||
+        ReadProgressFile(file_name, &sample)) {
+      continue;
+    }
+    ++reporting;
+    cells_done += sample.cells_done;
+    cells_total += sample.cells_total;
+    bytes_written += sample.bytes_written;
+    if (now - sample.updated > PROGRESS_STALE_INTERVALS * progress->interval) {
+      ++stale;
+    }
+    double fraction = sample.cells_total > 0
+                          ? (double)sample.cells_done / sample.cells_total
+                          : 1.0;
+    if (fraction < slowest_fraction) {
+      slowest_fraction = fraction;
+      slowest_rank = progress->report_ranks[r];
+    }
+    if (sample.eta_seconds < 0.0 || eta < 0.0) {
+      eta = -1.0;
+    } else if (sample.eta_seconds > eta) {
+      eta = sample.eta_seconds;
+    }
+  }
+  printf("Progress: %zu of %zu cells (%.1f%%), %.1f MiB written, %zu of %zu "
+         "ranks reporting, %zu stale",
+         cells_done, cells_total,
+         cells_total > 0 ? 100.0 * cells_done / cells_total : 0.0,
+         bytes_written / 1048576.0, reporting, progress->num_report_ranks,
+         stale);
+  if (slowest_rank >= 0) {
+    printf(", slowest rank %d at %.1f%%", slowest_rank,
+           100.0 * slowest_fraction);
+  }
+  if (eta >= 0.0) {
+    printf(", ETA %.0f s\n", eta);
+  } else {
+    printf(", ETA unknown\n");
+  }
+  fflush(stdout);
+}
+
+static void *ProgressWorker(void *arg) {
+  Progress *progress = (Progress *)arg;
+  pthread_mutex_lock(&progress->lock);
+  while (!progress->stopping) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    double seconds = deadline.tv_nsec * 1.0e-9 + progress->interval;
+    deadline.tv_sec += (time_t)seconds;
+    deadline.tv_nsec = (long)((seconds - (time_t)seconds) * 1.0e9);
+    int waited = 0;
+    while (!progress->stopping && waited != ETIMEDOUT) {
+      waited = pthread_cond_timedwait(&progress->wake, &progress->lock,
+                                      &deadline);
+    }
+    if (progress->stopping) {
+      break;
+    }
+    pthread_mutex_unlock(&progress->lock);
+    if (WriteProgressFile(progress)) {
+      fprintf(stderr, "warning: [%d] cannot write the progress file\n",
+              progress->world_rank);
+    }
+    if (progress->report_ranks != NULL) {
+      PrintProgressReport(progress);
+    }
+    pthread_mutex_lock(&progress->lock);
+  }
+  pthread_mutex_unlock(&progress->lock);
+  return NULL;
+}
+
+// Collective over mpi_comm, whose first rank learns the world ranks of the
+// others to report on them. Returns 1 without a thread when progress is not
+// configured or the thread cannot start.
+int StartProgress(Progress *progress, const Config *config, MPI_Comm mpi_comm,
+                  size_t cells_total) {
+  if (config->progress_dir == NULL) {
+    return 1;
+  }
+  int comm_rank;
+  int comm_size;
+  MPI_Comm_rank(mpi_comm, &comm_rank);
+  MPI_Comm_size(mpi_comm, &comm_size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &progress->world_rank);
+  progress->dir = config->progress_dir;
+  progress->scenario = config->name != NULL ? config->name : "run";
+  progress->format = config->progress_format;
+  progress->interval = config->progress_interval;
+  progress->report_ranks = NULL;
+  progress->num_report_ranks = 0;
+  progress->start = PerfWallTime();
+  progress->cells_total = cells_total;
+  progress->cells_done = 0;
+  progress->bytes_written = 0;
+  progress->phase = "start";
+  progress->stopping = 0;
+  int *world_ranks = NULL;
+  if (config->progress_report && comm_rank == 0) {
+    world_ranks = (int *)malloc(sizeof(int) * comm_size);
+  }
+  MPI_Gather(&progress->world_rank, 1, MPI_INT, world_ranks, 1, MPI_INT, 0,
+             mpi_comm);
+  if (world_ranks != NULL) {
+    progress->report_ranks = world_ranks;
+    progress->num_report_ranks = comm_size;
+  }
+  WriteProgressFile(progress);
+  pthread_mutex_init(&progress->lock, NULL);
+  pthread_cond_init(&progress->wake, NULL);
+  if (pthread_create(&progress->thread, NULL, ProgressWorker, progress)) {
+    fprintf(stderr, "warning: [%d] unable to start the progress thread\n",
+            progress->world_rank);
+    pthread_cond_destroy(&progress->wake);
+    pthread_mutex_destroy(&progress->lock);
+    free(progress->report_ranks);
+    progress->report_ranks = NULL;
+    return 1;
+  }
+  return 0;
+}
+
+void SetProgressPhase(Progress *progress, const char *phase) {
+  if (progress != NULL) {
+    __atomic_store_n(&progress->phase, phase, __ATOMIC_RELAXED);
+  }
+}
+
+// Only the extraction stores the counters, the thread only loads them.
+void AddProgress(Progress *progress, size_t cells, size_t bytes) {
+  if (progress != NULL) {
+    __atomic_store_n(&progress->cells_done, progress->cells_done + cells,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&progress->bytes_written, progress->bytes_written + bytes,
+                     __ATOMIC_RELAXED);
+  }
+}
+
+// Stops the thread and leaves the final state of the rank in its file.
+void StopProgress(Progress *progress) {
+  pthread_mutex_lock(&progress->lock);
+  progress->stopping = 1;
+  pthread_cond_signal(&progress->wake);
+  pthread_mutex_unlock(&progress->lock);
+  pthread_join(progress->thread, NULL);
+  pthread_cond_destroy(&progress->wake);
+  pthread_mutex_destroy(&progress->lock);
+  SetProgressPhase(progress, "done");
+  if (WriteProgressFile(progress)) {
+    fprintf(stderr, "warning: [%d] cannot write the progress file\n",
+            progress->world_rank);
+  }
+  free(progress->report_ranks);
+  progress->report_ranks = NULL;
+}
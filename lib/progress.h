@@ -0,0 +1,58 @@
+#ifndef WTH_PROGRESS_H_
+#define WTH_PROGRESS_H_
+#include <pthread.h>
+#include <stddef.h>
+
+#include <mpi.h>
+
+#include "config.h"
+
+// A rank whose file is older than this many intervals is reported as stale
+#define PROGRESS_STALE_INTERVALS 3
+
+// What a rank publishes about itself, as written to and read from its file.
+// The ETA is negative until the first cell is done.
+typedef struct ProgressSample_ {
+  size_t cells_done;
+  size_t cells_total;
+  size_t bytes_written;
+  double elapsed_seconds;
+  double eta_seconds;
+  double updated;
+} ProgressSample;
+
+// Publishes the progress of a rank to a file in progress_dir every interval,
+// from a thread of its own: a heartbeat of name and value lines, or gauges
+// for the textfile collector of the Prometheus node exporter. The extraction
+// only stores its counters and phase, without locking, and the thread reads
+// them. The first rank of a run can also print the progress of all of them,
+// read back from their files, so the thread never calls MPI.
+typedef struct Progress_ {
+  const char *dir;
+  const char *scenario;
+  int format;
+  double interval;
+  int world_rank;
+  int *report_ranks;
+  size_t num_report_ranks;
+  double start;
+  size_t cells_total;
+  size_t cells_done;
+  size_t bytes_written;
+  const char *phase;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  int stopping;
+} Progress;
+
+int StartProgress(Progress *progress, const Config *config, MPI_Comm mpi_comm,
+                  size_t cells_total);
+void SetProgressPhase(Progress *progress, const char *phase);
+void AddProgress(Progress *progress, size_t cells, size_t bytes);
+void StopProgress(Progress *progress);
+size_t ProgressFileName(const Progress *progress, int world_rank,
+                        char *dest_str, size_t dest_size);
+int WriteProgressFile(const Progress *progress);
+int ReadProgressFile(const char *file_name, ProgressSample *sample);
+#endif // WTH_PROGRESS_H_
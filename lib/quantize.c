@@ -0,0 +1,73 @@
+#include <math.h>
+
+#include "quantize.h"
+
+// A float times ten is exact in a double, so rounding it to even gives the
+// same tenths as printing the float with %.1f.
+static double Tenths(float value) { return nearbyint((double)value * 10.0); }
+
+// The midpoint of the tenths of the values, which centres them on the codes
+// available around it.
+int32_t QuantizeOffset(const float *values, size_t length, float fill_value) {
+  double low = INFINITY;
+  double high = -INFINITY;
+  for (size_t i = 0; i < length; ++i) {
+    if (values[i] == fill_value || !isfinite(values[i])) {
+      continue;
+    }
+    double tenths = Tenths(values[i]);
+    if (tenths < low) {
+      low = tenths;
+    }
+    if (tenths > high) {
+      high = tenths;
+    }
+  }
+  if (low > high) {
+    return 0;
+  }
+  double middle = floor((low + high) / 2.0);
+  if (middle < INT32_MIN) {
+    return INT32_MIN;
+  }
+  if (middle > INT32_MAX) {
+    return INT32_MAX;
+  }
+  return (int32_t)middle;
+}
+
+// Returns the number of values which did not fit around the offset and were
+// clamped to the nearest code.
+size_t QuantizeValues(const float *values, size_t length, float fill_value,
+                      int32_t offset, int16_t *dest) {
+  size_t clamped = 0;
+  for (size_t i = 0; i < length; ++i) {
+    if (values[i] == fill_value) {
+      dest[i] = QUANTIZED_FILL;
+      continue;
+    }
+    double tenths = Tenths(values[i]);
+    if (tenths == 0.0 && signbit(tenths)) {
+      dest[i] = QUANTIZED_NEGATIVE_ZERO;
+      continue;
+    }
+    double code = tenths - offset;
+    if (code >= QUANTIZED_MIN && code <= QUANTIZED_MAX) {
+      dest[i] = (int16_t)code;
+      continue;
+    }
+    dest[i] = code < QUANTIZED_MIN ? QUANTIZED_MIN : QUANTIZED_MAX;
+    ++clamped;
+  }
+  return clamped;
+}
+
+float DequantizeValue(int16_t value, int32_t offset, float fill_value) {
+  if (value == QUANTIZED_FILL) {
+    return fill_value;
+  }
+  if (value == QUANTIZED_NEGATIVE_ZERO) {
+    return -0.0f;
+  }
+  return (float)(((double)value + offset) / 10.0);
+}
@@ -0,0 +1,18 @@
+#ifndef WTH_QUANTIZE_H_
+#define WTH_QUANTIZE_H_
+#include <stddef.h>
+#include <stdint.h>
+
+// Quantized values are the tenths of a converted value less an offset per
+// variable. The two lowest codes are reserved for missing values and for the
+// values which are written as -0.0.
+#define QUANTIZED_FILL INT16_MIN
+#define QUANTIZED_NEGATIVE_ZERO (INT16_MIN + 1)
+#define QUANTIZED_MIN (INT16_MIN + 2)
+#define QUANTIZED_MAX INT16_MAX
+
+int32_t QuantizeOffset(const float *values, size_t length, float fill_value);
+size_t QuantizeValues(const float *values, size_t length, float fill_value,
+                      int32_t offset, int16_t *dest);
+float DequantizeValue(int16_t value, int32_t offset, float fill_value);
+#endif // WTH_QUANTIZE_H_
@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <mpi.h>
+#include <netcdf.h>
+#include <netcdf_par.h>
+
+#include "hyperslab.h"
+#include "io.h"
+#include "rechunk.h"
+
+static const char *kLongitudeString = "lon";
+static const char *kLatitudeString = "lat";
+static const char *kTimeString = "time";
+static const char *kStoreSuffix = ".pm.nc";
+
+size_t PointMajorFileName(const char *file_name, char *dest_str,
+                          size_t dest_size) {
+  size_t base_len = strlen(file_name);
+  if (base_len > 3 && strcmp(file_name + base_len - 3, ".nc") == 0) {
+    base_len -= 3;
+  }
+  size_t size = snprintf(dest_str, dest_size, "%.*s%s", (int)base_len,
+                         file_name, kStoreSuffix);
+  return size >= dest_size;
+}
+
+int PointMajorStoreIsCurrent(const char *file_name, const char *store_name) {
+  struct stat source;
+  struct stat store;
+  if (stat(file_name, &source) || stat(store_name, &store)) {
+    return 0;
+  }
+  return store.st_mtime >= source.st_mtime;
+}
+
+size_t PointMajorChunkCells(size_t days, size_t longitude_len) {
+  size_t cells = POINT_MAJOR_CHUNK_BYTES / (days * sizeof(float));
+  if (cells == 0) {
+    cells = 1;
+  }
+  if (cells > longitude_len) {
+    cells = longitude_len;
+  }
+  return cells;
+}
+
+// Copies the attributes of a variable to one of another file. The fill value
+// has to have the type of the variable, so it is left out unless copy_fill
+// says that both variables have the same type.
+static int CopyAttributes(int source_id, int source_varid, int store_id,
+                          int store_varid, int copy_fill) {
+  int status;
+  int num_atts;
+  char name[NC_MAX_NAME + 1];
+  if ((status = nc_inq_varnatts(source_id, source_varid, &num_atts))) {
+    fprintf(stderr, "error: cannot inquire attributes: %s\n",
+            nc_strerror(status));
+    return 1;
+  }
+  for (int i = 0; i < num_atts; ++i) {
+    if ((status = nc_inq_attname(source_id, source_varid, i, name)) == 0 &&
+        !copy_fill && strcmp(name, "_FillValue") == 0) {
+      continue;
+    }
+    if (status ||
+        (status = nc_copy_att(source_id, source_varid, name, store_id,
+                              store_varid))) {
+      fprintf(stderr, "error: cannot copy attribute #%d: %s\n", i + 1,
+              nc_strerror(status));
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Defines a coordinate variable of another file like the one of a source
+// file, with its type and attributes.
+int DefineCoordinate(int source_id, int source_varid, int store_id,
+                     const char *name, int dimid, int *store_varid) {
+  int status;
+  nc_type type;
+  if ((status = nc_inq_vartype(source_id, source_varid, &type)) ||
+      (status = nc_def_var(store_id, name, type, 1, &dimid, store_varid))) {
+    fprintf(stderr, "error: cannot define coordinate %s: %s\n", name,
+            nc_strerror(status));
+    return 1;
+  }
+  return CopyAttributes(source_id, source_varid, store_id, *store_varid, 1);
+}
+
+int CopyCoordinate(int source_id, int source_varid, int store_id,
+                   int store_varid, size_t length) {
+  int status;
+  double *values = (double *)malloc(sizeof(double) * length);
+  if (values == NULL) {
+    fprintf(stderr, "error: unable to allocate coordinate values\n");
+    return 1;
+  }
+  if ((status = nc_get_var_double(source_id, source_varid, values)) ||
+      (status = nc_put_var_double(store_id, store_varid, values))) {
+    fprintf(stderr, "error: cannot copy coordinate values: %s\n",
+            nc_strerror(status));
+    free(values);
+    return 1;
+  }
+  free(values);
+  return 0;
+}
+
+// Writes the (lat, lon, time) copy of the variable of one mapping to
+// store_name. The whole grid is split between the ranks, and each rank
+// streams its part through sub-tiles that fit the budget.
+static int WritePointMajorStore(const FileConfig *mapping,
+                                const NetCdfInfo *info, MPI_Comm mpi_comm,
+                                size_t budget, const char *store_name,
+                                size_t *num_written) {
+  int status;
+  int world_rank;
+  int world_size;
+  MPI_Comm_rank(mpi_comm, &world_rank);
+  MPI_Comm_size(mpi_comm, &world_size);
+
+  int store_id;
+  if ((status = nc_create_par(store_name, NC_NETCDF4 | NC_CLOBBER, mpi_comm,
+                              MPI_INFO_NULL, &store_id))) {
+    fprintf(stderr, "error: cannot create %s: %s\n", store_name,
+            nc_strerror(status));
+    return 1;
+  }
+
+  int failed = 0;
+  int dimids[3];
+  int lon_varid, lat_varid, time_varid, var_varid;
+  size_t chunks[3] = {1, PointMajorChunkCells(info->time_len,
+                                              info->longitude_len),
+                      info->time_len};
+  if ((status = nc_def_dim(store_id, kLatitudeString, info->latitude_len,
+                           &dimids[0])) ||
+      (status = nc_def_dim(store_id, kLongitudeString, info->longitude_len,
+                           &dimids[1])) ||
+      (status =
+           nc_def_dim(store_id, kTimeString, info->time_len, &dimids[2]))) {
+    fprintf(stderr, "error: cannot define dimensions in %s: %s\n", store_name,
+            nc_strerror(status));
+    failed = 1;
+  }
+  failed = failed ||
+           DefineCoordinate(mapping->netcdf_id, info->longitude_varid,
+                            store_id, kLongitudeString, dimids[1],
+                            &lon_varid) ||
+           DefineCoordinate(mapping->netcdf_id, info->latitude_varid,
+                            store_id, kLatitudeString, dimids[0],
+                            &lat_varid) ||
+           DefineCoordinate(mapping->netcdf_id, info->time_varid, store_id,
+                            kTimeString, dimids[2], &time_varid);
+  if (!failed) {
+    if ((status = nc_def_var(store_id, mapping->netcdf_var, NC_FLOAT, 3,
+                             dimids, &var_varid)) ||
+        (status = nc_def_var_chunking(store_id, var_varid, NC_CHUNKED,
+                                      chunks))) {
+      fprintf(stderr, "error: cannot define %s in %s: %s\n",
+              mapping->netcdf_var, store_name, nc_strerror(status));
+      failed = 1;
+    } else if (CopyAttributes(mapping->netcdf_id, info->var_varid, store_id,
+                              var_varid, 0)) {
+      failed = 1;
+    } else if ((status = nc_put_att_float(store_id, var_varid, "_FillValue",
+                                          NC_FLOAT, 1, &info->fill_value))) {
+      // The store holds floats whatever the source variable was
+      fprintf(stderr, "error: cannot set the fill value of %s in %s: %s\n",
+              mapping->netcdf_var, store_name, nc_strerror(status));
+      failed = 1;
+    }
+  }
+  if (!failed && (status = nc_enddef(store_id))) {
+    fprintf(stderr, "error: cannot write the header of %s: %s\n", store_name,
+            nc_strerror(status));
+    failed = 1;
+  }
+  if (!failed && world_rank == 0) {
+    failed = CopyCoordinate(mapping->netcdf_id, info->longitude_varid,
+                            store_id, lon_varid, info->longitude_len) ||
+             CopyCoordinate(mapping->netcdf_id, info->latitude_varid,
+                            store_id, lat_varid, info->latitude_len) ||
+             CopyCoordinate(mapping->netcdf_id, info->time_varid, store_id,
+                            time_varid, info->time_len);
+  }
+
+  Hyperslab *slabs = NULL;
+  Hyperslab *tiles = NULL;
+  size_t num_tiles = 0;
+  float *values = NULL;
+  float *series = NULL;
+  if (!failed) {
+    slabs = AllocateHyperslabs(
+        Position(0, 0, 0),
+        Edges(info->time_len, info->longitude_len, info->latitude_len),
+        world_size, world_rank);
+    // Each tile needs its map-major read buffer and the transposed series
+    tiles = slabs == NULL
+                ? NULL
+                : SubdivideHyperslab(slabs[world_rank], 1, budget, &num_tiles);
+    failed = tiles == NULL;
+  }
+  if (!failed) {
+    size_t capacity = 0;
+    for (size_t t = 0; t < num_tiles; ++t) {
+      if (tiles[t].flat_size > capacity) {
+        capacity = tiles[t].flat_size;
+      }
+    }
+    values = (float *)malloc(sizeof(float) * capacity);
+    series = (float *)malloc(sizeof(float) * capacity);
+    if (values == NULL || series == NULL) {
+      fprintf(stderr, "error: unable to allocate the rechunking buffers\n");
+      failed = 1;
+    }
+  }
+  for (size_t t = 0; !failed && t < num_tiles; ++t) {
+    Hyperslab h = tiles[t];
+    if (ReadHyperslab(mapping, info, h, values)) {
+      failed = 1;
+      break;
+    }
+    for (size_t y = 0; y < h.edges.y_length; ++y) {
+      for (size_t x = 0; x < h.edges.x_length; ++x) {
+        float *cell =
+            &series[((y * h.edges.x_length) + x) * h.edges.days];
+        for (size_t d = 0; d < h.edges.days; ++d) {
+          cell[d] = values[HyperslabValueIndex(h, Position(d, x, y))];
+        }
+      }
+    }
+    size_t start[3] = {h.corner.y, h.corner.x, h.corner.day};
+    size_t count[3] = {h.edges.y_length, h.edges.x_length, h.edges.days};
+    if ((status = nc_put_vara_float(store_id, var_varid, start, count,
+                                    series))) {
+      fprintf(stderr, "error: cannot write to %s: %s\n", store_name,
+              nc_strerror(status));
+      failed = 1;
+    }
+  }
+  free(series);
+  free(values);
+  free(tiles);
+  free(slabs);
+  if ((status = nc_close(store_id))) {
+    fprintf(stderr, "error: cannot close %s: %s\n", store_name,
+            nc_strerror(status));
+    failed = 1;
+  }
+  *num_written = num_tiles;
+  return failed;
+}
+
+// Rewrites the variable of one mapping as (lat, lon, time) so the series of
+// a cell is contiguous. The store is written under a temporary name and
+// only renamed once every rank has written its part, so a rechunk which
+// fails or is killed never leaves a partial store for later runs to read.
+// Collective over mpi_comm, which all agree on the result.
+int RechunkMapping(const FileConfig *mapping, const NetCdfInfo *info,
+                   MPI_Comm mpi_comm, size_t budget) {
+  int world_rank;
+  MPI_Comm_rank(mpi_comm, &world_rank);
+
+  // A store would only be kept current with the first file of the axis
+  if (info->num_parts > 0) {
+    if (world_rank == 0) {
+      fprintf(stderr, "warning: %s continues in %zu other files and is not "
+                      "rechunked\n",
+              mapping->file_name, info->num_parts);
+    }
+    return 0;
+  }
+  // The store of an ensemble would hold its statistic, not the first model
+  if (info->num_members > 0) {
+    if (world_rank == 0) {
+      fprintf(stderr, "warning: %s is the first of an ensemble of %zu "
+                      "models and is not rechunked\n",
+              mapping->file_name, info->num_members + 1);
+    }
+    return 0;
+  }
+  char store_name[2048];
+  char temp_name[2048 + 4] = "";
+  size_t num_tiles = 0;
+  int failed =
+      PointMajorFileName(mapping->file_name, store_name, sizeof(store_name));
+  if (failed) {
+    fprintf(stderr, "error: store name for %s is too long\n",
+            mapping->file_name);
+  } else {
+    snprintf(temp_name, sizeof(temp_name), "%s.tmp", store_name);
+    failed = WritePointMajorStore(mapping, info, mpi_comm, budget, temp_name,
+                                  &num_tiles);
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, mpi_comm);
+  if (world_rank == 0 && temp_name[0] != '\0') {
+    if (failed) {
+      remove(temp_name);
+    } else if (rename(temp_name, store_name)) {
+      fprintf(stderr, "error: cannot rename %s to %s\n", temp_name,
+              store_name);
+      failed = 1;
+    }
+  }
+  MPI_Bcast(&failed, 1, MPI_INT, 0, mpi_comm);
+  if (!failed) {
+    printf("[%d] Rechunked %s into %s (%zu sub-tiles)\n", world_rank,
+           mapping->file_name, store_name, num_tiles);
+  }
+  return failed;
+}
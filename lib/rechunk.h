@@ -0,0 +1,26 @@
+#ifndef WTH_RECHUNK_H_
+#define WTH_RECHUNK_H_
+#include <stddef.h>
+
+#include <mpi.h>
+
+#include "config.h"
+#include "io.h"
+
+// Chunks of the point-major store hold the whole time series of a block of
+// cells along a row and are kept close to this size.
+#define POINT_MAJOR_CHUNK_BYTES 4194304
+// Memory used per rank for rechunking when max_memory_per_rank is not set.
+#define DEFAULT_RECHUNK_BUDGET 1073741824
+
+size_t PointMajorFileName(const char *file_name, char *dest_str,
+                          size_t dest_size);
+int PointMajorStoreIsCurrent(const char *file_name, const char *store_name);
+size_t PointMajorChunkCells(size_t days, size_t longitude_len);
+int DefineCoordinate(int source_id, int source_varid, int store_id,
+                     const char *name, int dimid, int *store_varid);
+int CopyCoordinate(int source_id, int source_varid, int store_id,
+                   int store_varid, size_t length);
+int RechunkMapping(const FileConfig *mapping, const NetCdfInfo *info,
+                   MPI_Comm mpi_comm, size_t budget);
+#endif // WTH_RECHUNK_H_
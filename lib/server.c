@@ -0,0 +1,429 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "perf.h"
+#include "server.h"
+#include "weather_file.h"
+
+typedef struct Client_ {
+  int fd;
+  char request[SERVER_MAX_REQUEST];
+  size_t request_length;
+  char *response;
+  size_t response_length;
+  size_t response_sent;
+  int closing;
+} Client;
+
+typedef struct ServerState_ {
+  Dataset *dataset;
+  const Config *config;
+  float *series;
+  size_t days;
+  size_t requests;
+  size_t errors;
+  size_t num_clients;
+  LatencyWindow latencies;
+} ServerState;
+
+static volatile sig_atomic_t stop_serving = 0;
+
+static void StopServing(int signal_number) {
+  (void)signal_number;
+  stop_serving = 1;
+}
+
+// Requests are one line each: "WTH lon lat", "SERIES lon lat" or "STATS".
+int ParseServerRequest(const char *line, ServerRequest *request) {
+  char command[8];
+  double longitude;
+  double latitude;
+  char extra;
+  if (sscanf(line, "%7s %c", command, &extra) == 1 &&
+      strcmp(command, "STATS") == 0) {
+    request->command = kServerStats;
+    return 0;
+  }
+  if (sscanf(line, "%7s %lf %lf %c", command, &longitude, &latitude,
+             &extra) != 3) {
+    return 1;
+  }
+  if (strcmp(command, "WTH") == 0) {
+    request->command = kServerWeatherFile;
+  } else if (strcmp(command, "SERIES") == 0) {
+    request->command = kServerSeries;
+  } else {
+    return 1;
+  }
+  if (!(longitude >= -180.0 && longitude <= 180.0 && latitude >= -90.0 &&
+        latitude <= 90.0)) {
+    return 1;
+  }
+  request->position = LonLatPosition(longitude, latitude);
+  return 0;
+}
+
+void RecordLatency(LatencyWindow *window, double seconds) {
+  window->samples[window->next] = seconds;
+  window->next = (window->next + 1) % SERVER_LATENCY_SAMPLES;
+  if (window->count < SERVER_LATENCY_SAMPLES) {
+    ++window->count;
+  }
+}
+
+static int CompareDoubles(const void *a, const void *b) {
+  double lhs = *(const double *)a;
+  double rhs = *(const double *)b;
+  return (lhs > rhs) - (lhs < rhs);
+}
+
+// The nearest-rank percentile of the recorded latencies, 0 without any.
+double LatencyPercentile(const LatencyWindow *window, double percent) {
+  if (window->count == 0) {
+    return 0.0;
+  }
+  double sorted[SERVER_LATENCY_SAMPLES];
+  memcpy(sorted, window->samples, sizeof(double) * window->count);
+  qsort(sorted, window->count, sizeof(double), CompareDoubles);
+  size_t rank = (size_t)ceil(percent / 100.0 * (double)window->count);
+  if (rank < 1) {
+    rank = 1;
+  } else if (rank > window->count) {
+    rank = window->count;
+  }
+  return sorted[rank - 1];
+}
+
+static int QueueResponse(Client *client, const char *header,
+                         const void *payload, size_t payload_size) {
+  size_t header_size = strlen(header);
+  char *response = (char *)realloc(
+      client->response, client->response_length + header_size + payload_size);
+  if (response == NULL) {
+    fprintf(stderr, "error: unable to allocate a response of %zu bytes\n",
+            header_size + payload_size);
+    return 1;
+  }
+  memcpy(&response[client->response_length], header, header_size);
+  if (payload_size > 0) {
+    memcpy(&response[client->response_length + header_size], payload,
+           payload_size);
+  }
+  client->response = response;
+  client->response_length += header_size + payload_size;
+  return 0;
+}
+
+static int QueueError(ServerState *state, Client *client, const char *reason) {
+  char header[SERVER_MAX_REQUEST];
+  ++state->errors;
+  snprintf(header, sizeof(header), "ERR %s\n", reason);
+  return QueueResponse(client, header, NULL, 0);
+}
+
+static int QueueStats(ServerState *state, Client *client) {
+  size_t hits;
+  size_t misses;
+  DatasetCacheStats(state->dataset, &hits, &misses);
+  char text[1024];
+  int size = snprintf(
+      text, sizeof(text),
+      "requests %zu\nerrors %zu\nclients %zu\ncache_hits %zu\n"
+      "cache_misses %zu\ncache_hit_rate %.3f\nlatency_ms_p50 %.3f\n"
+      "latency_ms_p90 %.3f\nlatency_ms_p99 %.3f\nlatency_ms_max %.3f\n",
+      state->requests, state->errors, state->num_clients, hits, misses,
+      hits + misses > 0 ? (double)hits / (double)(hits + misses) : 0.0,
+      1e3 * LatencyPercentile(&state->latencies, 50.0),
+      1e3 * LatencyPercentile(&state->latencies, 90.0),
+      1e3 * LatencyPercentile(&state->latencies, 99.0),
+      1e3 * LatencyPercentile(&state->latencies, 100.0));
+  char header[32];
+  snprintf(header, sizeof(header), "OK %d\n", size);
+  return QueueResponse(client, header, text, (size_t)size);
+}
+
+// Answers one request line, queueing the response on the client. Returns
+// non-zero only when the response could not be queued at all.
+static int AnswerRequest(ServerState *state, Client *client,
+                         const char *line) {
+  double start = PerfWallTime();
+  ServerRequest request;
+  int status;
+  ++state->requests;
+  if (ParseServerRequest(line, &request)) {
+    status = QueueError(state, client, "malformed request");
+  } else if (request.command == kServerStats) {
+    status = QueueStats(state, client);
+  } else {
+    CellSummary summary;
+    char header[64];
+    if (QueryCell(state->dataset, request.position, state->series,
+                  &summary)) {
+      status = QueueError(state, client, "cell could not be read");
+    } else if (request.command == kServerSeries) {
+      size_t size = sizeof(float) * state->config->num_mappings * state->days;
+      snprintf(header, sizeof(header), "OK %zu %zu %zu\n", size,
+               state->config->num_mappings, state->days);
+      status = QueueResponse(client, header, state->series, size);
+    } else if (summary.missing) {
+      status = QueueError(state, client, "cell has no data");
+    } else {
+      char *text = NULL;
+      size_t text_size = 0;
+      FILE *fh = open_memstream(&text, &text_size);
+      if (fh == NULL) {
+        status = QueueError(state, client, "weather file could not be "
+                                           "rendered");
+      } else {
+        WriteWeatherFile(fh, state->config, DatasetDates(state->dataset),
+                         LonLatPosition(summary.longitude, summary.latitude),
+                         state->series, summary.tav, summary.amp);
+        fclose(fh);
+        snprintf(header, sizeof(header), "OK %zu\n", text_size);
+        status = QueueResponse(client, header, text, text_size);
+      }
+      free(text);
+    }
+  }
+  RecordLatency(&state->latencies, PerfWallTime() - start);
+  return status;
+}
+
+static void CloseClient(ServerState *state, Client *client) {
+  close(client->fd);
+  free(client->response);
+  memset(client, 0, sizeof(Client));
+  client->fd = -1;
+  --state->num_clients;
+}
+
+// Reads what the client sent and answers every complete line. Returns
+// non-zero when the client is gone or has to be dropped.
+static int ReadRequests(ServerState *state, Client *client) {
+  ssize_t received =
+      recv(client->fd, &client->request[client->request_length],
+           SERVER_MAX_REQUEST - client->request_length, 0);
+  if (received < 0) {
+    return errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR;
+  }
+  if (received == 0) {
+    return 1;
+  }
+  client->request_length += (size_t)received;
+  char *line = client->request;
+  char *end;
+  while ((end = memchr(line, '\n',
+                       client->request_length -
+                           (size_t)(line - client->request))) != NULL) {
+    *end = '\0';
+    if (end > line && end[-1] == '\r') {
+      end[-1] = '\0';
+    }
+    if (AnswerRequest(state, client, line)) {
+      return 1;
+    }
+    line = end + 1;
+  }
+  client->request_length -= (size_t)(line - client->request);
+  memmove(client->request, line, client->request_length);
+  // The rest of an overlong line cannot be told from the next request, so
+  // the client is dropped once it has the error
+  if (client->request_length == SERVER_MAX_REQUEST) {
+    client->request_length = 0;
+    client->closing = 1;
+    return QueueError(state, client, "request too long");
+  }
+  return 0;
+}
+
+// Sends as much of the pending response as the socket takes. Returns
+// non-zero when the client is gone or is done once the response is sent.
+static int WriteResponse(Client *client) {
+  ssize_t sent =
+      send(client->fd, &client->response[client->response_sent],
+           client->response_length - client->response_sent, MSG_NOSIGNAL);
+  if (sent < 0) {
+    return errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR;
+  }
+  client->response_sent += (size_t)sent;
+  if (client->response_sent == client->response_length) {
+    free(client->response);
+    client->response = NULL;
+    client->response_length = 0;
+    client->response_sent = 0;
+    return client->closing;
+  }
+  return 0;
+}
+
+static int OpenListener(const char *socket_path) {
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "error: socket path is too long: %s\n", socket_path);
+    return -1;
+  }
+  strcpy(address.sun_path, socket_path);
+  // A socket left behind by a previous server is replaced, anything else is
+  // not touched
+  struct stat status;
+  if (lstat(socket_path, &status) == 0) {
+    if (!S_ISSOCK(status.st_mode)) {
+      fprintf(stderr, "error: %s exists and is not a socket\n", socket_path);
+      return -1;
+    }
+    unlink(socket_path);
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror("error: unable to create the socket");
+    return -1;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(fd, SERVER_MAX_CLIENTS) != 0) {
+    fprintf(stderr, "error: unable to listen on %s: %s\n", socket_path,
+            strerror(errno));
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Answers requests on a Unix domain socket until SIGINT or SIGTERM. The
+// clients are served from one thread, a request at a time, since the
+// dataset and the NetCDF library are not thread safe; a client waiting for
+// its response to drain is not read from, so slow readers only hold up
+// themselves.
+int ServeDataset(Dataset *dataset, const Config *config,
+                 const char *socket_path) {
+  ServerState *state = (ServerState *)calloc(1, sizeof(ServerState));
+  Client *clients = (Client *)calloc(SERVER_MAX_CLIENTS, sizeof(Client));
+  if (state == NULL || clients == NULL) {
+    fprintf(stderr, "error: unable to allocate the server\n");
+    free(state);
+    free(clients);
+    return 1;
+  }
+  state->dataset = dataset;
+  state->config = config;
+  state->days = DatasetDays(dataset);
+  state->series =
+      (float *)malloc(sizeof(float) * config->num_mappings * state->days);
+  if (state->series == NULL) {
+    fprintf(stderr, "error: unable to allocate the series of a cell\n");
+    free(state);
+    free(clients);
+    return 1;
+  }
+  int listener = OpenListener(socket_path);
+  if (listener < 0) {
+    free(state->series);
+    free(state);
+    free(clients);
+    return 1;
+  }
+  for (size_t i = 0; i < SERVER_MAX_CLIENTS; ++i) {
+    clients[i].fd = -1;
+  }
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = StopServing;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  printf("Serving on %s\n", socket_path);
+  fflush(stdout);
+
+  struct pollfd fds[SERVER_MAX_CLIENTS + 1];
+  size_t owners[SERVER_MAX_CLIENTS + 1];
+  int status = 0;
+  while (!stop_serving) {
+    nfds_t num_fds = 0;
+    if (state->num_clients < SERVER_MAX_CLIENTS) {
+      fds[num_fds].fd = listener;
+      fds[num_fds].events = POLLIN;
+      owners[num_fds++] = SERVER_MAX_CLIENTS;
+    }
+    for (size_t i = 0; i < SERVER_MAX_CLIENTS; ++i) {
+      if (clients[i].fd >= 0) {
+        fds[num_fds].fd = clients[i].fd;
+        fds[num_fds].events = clients[i].response != NULL ? POLLOUT : POLLIN;
+        owners[num_fds++] = i;
+      }
+    }
+    // The timeout catches a signal which lands before the poll starts
+    int ready = poll(fds, num_fds, 1000);
+    if (ready < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("error: poll failed");
+      status = 1;
+      break;
+    }
+    for (nfds_t f = 0; f < num_fds; ++f) {
+      if (fds[f].revents == 0) {
+        continue;
+      }
+      if (owners[f] == SERVER_MAX_CLIENTS) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+          continue;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        for (size_t i = 0; i < SERVER_MAX_CLIENTS; ++i) {
+          if (clients[i].fd < 0) {
+            clients[i].fd = fd;
+            ++state->num_clients;
+            break;
+          }
+        }
+        continue;
+      }
+      Client *client = &clients[owners[f]];
+      int gone;
+      if (client->response != NULL) {
+        gone = (fds[f].revents & (POLLERR | POLLHUP)) || WriteResponse(client);
+      } else {
+        gone = ReadRequests(state, client);
+      }
+      if (gone) {
+        CloseClient(state, client);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < SERVER_MAX_CLIENTS; ++i) {
+    if (clients[i].fd >= 0) {
+      CloseClient(state, &clients[i]);
+    }
+  }
+  close(listener);
+  unlink(socket_path);
+  size_t hits;
+  size_t misses;
+  DatasetCacheStats(dataset, &hits, &misses);
+  printf("Served %zu requests (%zu errors), tile cache hit rate %.1f%%, "
+         "latency p50 %.3f ms, p90 %.3f ms, p99 %.3f ms\n",
+         state->requests, state->errors,
+         hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0,
+         1e3 * LatencyPercentile(&state->latencies, 50.0),
+         1e3 * LatencyPercentile(&state->latencies, 90.0),
+         1e3 * LatencyPercentile(&state->latencies, 99.0));
+  free(state->series);
+  free(state);
+  free(clients);
+  return status;
+}
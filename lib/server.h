@@ -0,0 +1,34 @@
+#ifndef WTH_SERVER_H_
+#define WTH_SERVER_H_
+#include <stddef.h>
+
+#include "config.h"
+#include "dataset.h"
+#include "location.h"
+
+// Longest request line, connections served at once and the number of recent
+// request latencies the percentiles are computed over.
+#define SERVER_MAX_REQUEST 256
+#define SERVER_MAX_CLIENTS 64
+#define SERVER_LATENCY_SAMPLES 4096
+
+enum { kServerWeatherFile, kServerSeries, kServerStats };
+
+typedef struct ServerRequest_ {
+  int command;
+  LonLat position;
+} ServerRequest;
+
+// The latencies of the last SERVER_LATENCY_SAMPLES requests, in seconds.
+typedef struct LatencyWindow_ {
+  double samples[SERVER_LATENCY_SAMPLES];
+  size_t count;
+  size_t next;
+} LatencyWindow;
+
+int ParseServerRequest(const char *line, ServerRequest *request);
+void RecordLatency(LatencyWindow *window, double seconds);
+double LatencyPercentile(const LatencyWindow *window, double percent);
+int ServeDataset(Dataset *dataset, const Config *config,
+                 const char *socket_path);
+#endif // WTH_SERVER_H_
@@ -0,0 +1,185 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "slab_cache.h"
+
+size_t SlabCacheKey(const FileConfig *mapping, Hyperslab slab, char *dest_str,
+                    size_t dest_size) {
+  char source[PATH_MAX];
+  if (realpath(mapping->file_name, source) == NULL) {
+    snprintf(source, sizeof(source), "%s", mapping->file_name);
+  }
+  size_t size = snprintf(
+      dest_str, dest_size, "%s|%s|%s|%s|%zu,%zu,%zu|%zu,%zu,%zu", source,
+      mapping->netcdf_var,
+      mapping->source_unit == NULL ? "-" : mapping->source_unit,
+      mapping->target_unit == NULL ? "-" : mapping->target_unit,
+      slab.corner.day, slab.corner.x, slab.corner.y, slab.edges.days,
+      slab.edges.x_length, slab.edges.y_length);
+  return size >= dest_size;
+}
+
+// FNV-1a is enough to spread the keys over file names, the full key in the
+// header settles collisions.
+size_t SlabCacheFileName(const char *cache_dir, const char *key,
+                         char *dest_str, size_t dest_size) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (const char *c = key; *c != '\0'; ++c) {
+    hash ^= (unsigned char)*c;
+    hash *= 1099511628211ULL;
+  }
+  size_t size = snprintf(dest_str, dest_size, "%s%016llx.slab", cache_dir,
+                         (unsigned long long)hash);
+  return size >= dest_size;
+}
+
+static void FillHeader(SlabCacheHeader *header, const char *key,
+                       Hyperslab slab, const struct stat *source) {
+  memset(header, 0, sizeof(SlabCacheHeader));
+  memcpy(header->magic, SLAB_CACHE_MAGIC, sizeof(header->magic));
+  header->version = SLAB_CACHE_VERSION;
+  header->value_size = sizeof(float);
+  header->source_size = (uint64_t)source->st_size;
+  header->source_mtime_sec = (int64_t)source->st_mtim.tv_sec;
+  header->source_mtime_nsec = (int64_t)source->st_mtim.tv_nsec;
+  for (size_t i = 0; i < 3; ++i) {
+    header->corner[i] = slab.corner.shape[i];
+    header->edges[i] = slab.edges.shape[i];
+  }
+  snprintf(header->key, sizeof(header->key), "%s", key);
+}
+
+int OpenSlabCacheEntry(const char *cache_dir, const FileConfig *mapping,
+                       Hyperslab slab, SlabCacheEntry *entry) {
+  entry->map = NULL;
+  entry->map_size = 0;
+  entry->values = NULL;
+
+  // Entries are only checked against the first file of a time axis or an
+  // ensemble, so slabs read from several files are not cached
+  if (mapping->num_parts > 0 || mapping->num_members > 0) {
+    return 0;
+  }
+  char key[SLAB_CACHE_KEY_LEN];
+  char file_name[2048];
+  struct stat source;
+  if (SlabCacheKey(mapping, slab, key, sizeof(key)) ||
+      SlabCacheFileName(cache_dir, key, file_name, sizeof(file_name)) ||
+      stat(mapping->file_name, &source)) {
+    return 0;
+  }
+  int fd = open(file_name, O_RDONLY);
+  if (fd == -1) {
+    return 0;
+  }
+  size_t map_size = SLAB_CACHE_DATA_OFFSET + sizeof(float) * slab.flat_size;
+  struct stat cached;
+  SlabCacheHeader expected;
+  SlabCacheHeader header;
+  FillHeader(&expected, key, slab, &source);
+  if (fstat(fd, &cached) || (size_t)cached.st_size != map_size ||
+      pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+    close(fd);
+    return 0;
+  }
+  if (memcmp(&header, &expected, sizeof(header)) != 0) {
+    // Entries written for an older version of the source are removed so they
+    // are rebuilt by this run. Hash collisions are left alone.
+    if (strcmp(header.key, expected.key) == 0) {
+      unlink(file_name);
+    }
+    close(fd);
+    return 0;
+  }
+  void *map = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "warning: cannot map %s: %s\n", file_name,
+            strerror(errno));
+    return 0;
+  }
+  madvise(map, map_size, MADV_SEQUENTIAL);
+  entry->map = map;
+  entry->map_size = map_size;
+  entry->values = (const float *)((const char *)map + SLAB_CACHE_DATA_OFFSET);
+  return 1;
+}
+
+void CloseSlabCacheEntry(SlabCacheEntry *entry) {
+  if (entry->map != NULL) {
+    munmap(entry->map, entry->map_size);
+    entry->map = NULL;
+  }
+  entry->map_size = 0;
+  entry->values = NULL;
+}
+
+static int WriteAll(int fd, const void *buffer, size_t size) {
+  const char *cursor = (const char *)buffer;
+  while (size > 0) {
+    ssize_t written = write(fd, cursor, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return 1;
+    }
+    cursor += written;
+    size -= written;
+  }
+  return 0;
+}
+
+// Entries are written under a temporary name and renamed into place so a
+// concurrent or interrupted run never maps a partial file.
+int StoreSlabCacheEntry(const char *cache_dir, const FileConfig *mapping,
+                        Hyperslab slab, const float *values) {
+  char key[SLAB_CACHE_KEY_LEN];
+  char file_name[2048];
+  char temp_name[2048 + 8];
+  struct stat source;
+  if (mapping->num_parts > 0 || mapping->num_members > 0) {
+    return 0;
+  }
+  if (SlabCacheKey(mapping, slab, key, sizeof(key)) ||
+      SlabCacheFileName(cache_dir, key, file_name, sizeof(file_name))) {
+    fprintf(stderr, "warning: cache key for %s is too long\n",
+            mapping->file_name);
+    return 1;
+  }
+  if (stat(mapping->file_name, &source)) {
+    fprintf(stderr, "warning: cannot stat %s: %s\n", mapping->file_name,
+            strerror(errno));
+    return 1;
+  }
+  snprintf(temp_name, sizeof(temp_name), "%s.XXXXXX", file_name);
+  int fd = mkstemp(temp_name);
+  if (fd == -1) {
+    fprintf(stderr, "warning: cannot create %s: %s\n", temp_name,
+            strerror(errno));
+    return 1;
+  }
+  fchmod(fd, 0644);
+  char *page = (char *)calloc(1, SLAB_CACHE_DATA_OFFSET);
+  int failed = page == NULL;
+  if (!failed) {
+    FillHeader((SlabCacheHeader *)page, key, slab, &source);
+    failed = WriteAll(fd, page, SLAB_CACHE_DATA_OFFSET) ||
+             WriteAll(fd, values, sizeof(float) * slab.flat_size);
+  }
+  free(page);
+  if (close(fd) || failed || rename(temp_name, file_name)) {
+    fprintf(stderr, "warning: cannot write the cache entry %s: %s\n",
+            file_name, strerror(errno));
+    unlink(temp_name);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef WTH_SLAB_CACHE_H_
+#define WTH_SLAB_CACHE_H_
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "hyperslab.h"
+
+#define SLAB_CACHE_MAGIC "GGCMISLB"
+#define SLAB_CACHE_VERSION 1
+// The values start on a page boundary so the mapping can be used in place.
+#define SLAB_CACHE_DATA_OFFSET 4096
+#define SLAB_CACHE_KEY_LEN 3072
+
+// Fixed header at the start of every cache file. The key holds the whole
+// description of the entry so hash collisions of the file name are caught.
+typedef struct SlabCacheHeader_ {
+  char magic[8];
+  uint32_t version;
+  uint32_t value_size;
+  uint64_t source_size;
+  int64_t source_mtime_sec;
+  int64_t source_mtime_nsec;
+  uint64_t corner[3];
+  uint64_t edges[3];
+  char key[SLAB_CACHE_KEY_LEN];
+} SlabCacheHeader;
+
+typedef struct SlabCacheEntry_ {
+  void *map;
+  size_t map_size;
+  const float *values;
+} SlabCacheEntry;
+
+size_t SlabCacheKey(const FileConfig *mapping, Hyperslab slab, char *dest_str,
+                    size_t dest_size);
+size_t SlabCacheFileName(const char *cache_dir, const char *key,
+                         char *dest_str, size_t dest_size);
+int OpenSlabCacheEntry(const char *cache_dir, const FileConfig *mapping,
+                       Hyperslab slab, SlabCacheEntry *entry);
+void CloseSlabCacheEntry(SlabCacheEntry *entry);
+int StoreSlabCacheEntry(const char *cache_dir, const FileConfig *mapping,
+                        Hyperslab slab, const float *values);
+#endif // WTH_SLAB_CACHE_H_
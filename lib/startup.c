@@ -0,0 +1,286 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <mpi.h>
+
+#include "startup.h"
+
+// Sends a byte buffer and its size from the root, returning it on every
+// rank or NULL on all of them when the root has none.
+static char *BroadcastBuffer(char *buffer, uint64_t *size_ptr,
+                             MPI_Comm mpi_comm) {
+  int rank;
+  MPI_Comm_rank(mpi_comm, &rank);
+  if (rank == 0 && buffer == NULL) {
+    *size_ptr = UINT64_MAX;
+  }
+  MPI_Bcast(size_ptr, 1, MPI_UINT64_T, 0, mpi_comm);
+  uint64_t size = *size_ptr;
+  if (size == UINT64_MAX) {
+    return NULL;
+  }
+  if (rank != 0) {
+    buffer = (char *)malloc(size + 1);
+    if (buffer == NULL) {
+      fprintf(stderr, "error: [%d] unable to allocate %llu bytes for the "
+                      "startup data\n",
+              rank, (unsigned long long)size);
+      MPI_Abort(mpi_comm, EXIT_FAILURE);
+    }
+  }
+  // Large configurations are sent in pieces below the int count limit
+  for (uint64_t sent = 0; sent < size;) {
+    int count = size - sent > INT32_MAX ? INT32_MAX : (int)(size - sent);
+    MPI_Bcast(buffer + sent, count, MPI_BYTE, 0, mpi_comm);
+    sent += count;
+  }
+  return buffer;
+}
+
+// Only the root reads the configuration file, the others get its text.
+char *BroadcastConfigText(const char *source, MPI_Comm mpi_comm) {
+  int rank;
+  MPI_Comm_rank(mpi_comm, &rank);
+  char *text = NULL;
+  uint64_t size = 0;
+  if (rank == 0) {
+    text = ReadConfigText(source);
+    size = text == NULL ? 0 : strlen(text) + 1;
+  }
+  return BroadcastBuffer(text, &size, mpi_comm);
+}
+
+static void PutBytes(char **cursor, const char *end, const void *value,
+                     size_t size) {
+  if (*cursor != NULL && *cursor + size <= end) {
+    memcpy(*cursor, value, size);
+    *cursor += size;
+  } else {
+    *cursor = NULL;
+  }
+}
+
+static int GetBytes(const char **cursor, const char *end, void *value,
+                    size_t size) {
+  if (*cursor + size > end) {
+    return 1;
+  }
+  memcpy(value, *cursor, size);
+  *cursor += size;
+  return 0;
+}
+
+// Packs the fields the other ranks cannot get without asking the file: ids,
+// lengths, layout, fill value, unit and the days of the files continuing the
+// time axis. Returns the size like snprintf and only writes when it fits.
+size_t PackNetCdfInfo(const NetCdfInfo *info, size_t num_mappings, char *dest,
+                      size_t dest_size) {
+  size_t size = 0;
+  for (size_t i = 0; i < num_mappings; ++i) {
+    size += 9 * sizeof(int32_t) + 4 * sizeof(uint64_t) + 2 * sizeof(double) +
+            sizeof(float) + sizeof(uint32_t);
+    size += info[i].unit == NULL ? 0 : strlen(info[i].unit);
+    size += sizeof(uint64_t) * (1 + info[i].num_parts);
+  }
+  if (dest == NULL || dest_size < size) {
+    return size;
+  }
+  char *cursor = dest;
+  const char *end = dest + dest_size;
+  for (size_t i = 0; i < num_mappings; ++i) {
+    int32_t ids[9] = {info[i].longitude_varid,
+                      info[i].latitude_varid,
+                      info[i].time_varid,
+                      info[i].var_varid,
+                      info[i].point_major,
+                      info[i].native_short,
+                      info[i].packed,
+                      (int32_t)info[i].num_members,
+                      info[i].ensemble_statistic};
+    uint64_t lengths[4] = {info[i].longitude_len, info[i].latitude_len,
+                           info[i].time_len, info[i].chunk_cache_size};
+    double packing[2] = {info[i].scale_factor, info[i].add_offset};
+    uint32_t unit_len =
+        info[i].unit == NULL ? 0 : (uint32_t)strlen(info[i].unit) + 1;
+    PutBytes(&cursor, end, ids, sizeof(ids));
+    PutBytes(&cursor, end, lengths, sizeof(lengths));
+    PutBytes(&cursor, end, packing, sizeof(packing));
+    PutBytes(&cursor, end, &info[i].fill_value, sizeof(float));
+    PutBytes(&cursor, end, &unit_len, sizeof(unit_len));
+    if (unit_len > 1) {
+      PutBytes(&cursor, end, info[i].unit, unit_len - 1);
+    }
+    uint64_t num_parts = info[i].num_parts;
+    PutBytes(&cursor, end, &num_parts, sizeof(num_parts));
+    for (size_t k = 0; k < info[i].num_parts; ++k) {
+      uint64_t days = info[i].parts[k].days;
+      PutBytes(&cursor, end, &days, sizeof(days));
+    }
+  }
+  return size;
+}
+
+int UnpackNetCdfInfo(const char *source, size_t size, NetCdfInfo *info,
+                     size_t num_mappings) {
+  const char *cursor = source;
+  const char *end = source + size;
+  for (size_t i = 0; i < num_mappings; ++i) {
+    int32_t ids[9];
+    uint64_t lengths[4];
+    double packing[2];
+    uint32_t unit_len;
+    info[i].unit = NULL;
+    info[i].chunk_reader = NULL;
+    info[i].parts = NULL;
+    info[i].num_parts = 0;
+    info[i].members = NULL;
+    info[i].num_members = 0;
+    if (GetBytes(&cursor, end, ids, sizeof(ids)) ||
+        GetBytes(&cursor, end, lengths, sizeof(lengths)) ||
+        GetBytes(&cursor, end, packing, sizeof(packing)) ||
+        GetBytes(&cursor, end, &info[i].fill_value, sizeof(float)) ||
+        GetBytes(&cursor, end, &unit_len, sizeof(unit_len))) {
+      return 1;
+    }
+    info[i].longitude_varid = ids[0];
+    info[i].latitude_varid = ids[1];
+    info[i].time_varid = ids[2];
+    info[i].var_varid = ids[3];
+    info[i].point_major = ids[4];
+    info[i].native_short = ids[5];
+    info[i].packed = ids[6];
+    info[i].scale_factor = packing[0];
+    info[i].add_offset = packing[1];
+    info[i].ensemble_statistic = ids[8];
+    // The other models are opened by the ranks which read them
+    if (ids[7] > 0) {
+      info[i].members =
+          (EnsembleMember *)calloc(ids[7], sizeof(EnsembleMember));
+      if (info[i].members == NULL) {
+        return 1;
+      }
+      info[i].num_members = ids[7];
+      for (int32_t k = 0; k < ids[7]; ++k) {
+        info[i].members[k].netcdf_id = -1;
+        info[i].members[k].var_varid = -1;
+      }
+    }
+    info[i].longitude_len = lengths[0];
+    info[i].latitude_len = lengths[1];
+    info[i].time_len = lengths[2];
+    info[i].chunk_cache_size = lengths[3];
+    if (unit_len > 0) {
+      info[i].unit = (char *)calloc(unit_len, sizeof(char));
+      if (info[i].unit == NULL ||
+          GetBytes(&cursor, end, info[i].unit, unit_len - 1)) {
+        return 1;
+      }
+    }
+    uint64_t num_parts;
+    if (GetBytes(&cursor, end, &num_parts, sizeof(num_parts)) ||
+        num_parts > (size_t)(end - cursor) / sizeof(uint64_t)) {
+      return 1;
+    }
+    if (num_parts > 0) {
+      info[i].parts = (TimePart *)calloc(num_parts, sizeof(TimePart));
+      if (info[i].parts == NULL) {
+        return 1;
+      }
+      info[i].num_parts = num_parts;
+    }
+    // The parts end the time axis, after the days of the first file
+    size_t first_day = info[i].time_len;
+    for (size_t k = 0; k < info[i].num_parts; ++k) {
+      uint64_t days;
+      if (GetBytes(&cursor, end, &days, sizeof(days)) || days > first_day) {
+        return 1;
+      }
+      info[i].parts[k].days = days;
+      info[i].parts[k].netcdf_id = -1;
+      info[i].parts[k].var_varid = -1;
+      first_day -= days;
+    }
+    for (size_t k = 0; k < info[i].num_parts; ++k) {
+      info[i].parts[k].first_day = first_day;
+      first_day += info[i].parts[k].days;
+    }
+  }
+  return 0;
+}
+
+// The root inquires the files, which every rank has opened, and sends what
+// it found to the others.
+int BroadcastNetCdfInfo(Config *config, NetCdfInfo *info, MPI_Comm mpi_comm) {
+  int rank;
+  MPI_Comm_rank(mpi_comm, &rank);
+  char *packed = NULL;
+  uint64_t size = 0;
+  if (rank == 0 && !InjectNetCdfInfo(config, info)) {
+    size = PackNetCdfInfo(info, config->num_mappings, NULL, 0);
+    packed = (char *)malloc(size + 1);
+    if (packed != NULL) {
+      PackNetCdfInfo(info, config->num_mappings, packed, size);
+    }
+  }
+  packed = BroadcastBuffer(packed, &size, mpi_comm);
+  if (packed == NULL) {
+    return 1;
+  }
+  int status = 0;
+  if (rank != 0) {
+    status = UnpackNetCdfInfo(packed, size, info, config->num_mappings);
+    if (status) {
+      fprintf(stderr, "error: [%d] malformed NetCDF metadata from the root\n",
+              rank);
+    }
+  }
+  free(packed);
+  return status;
+}
+
+// The root builds the converters with udunits and sends the affine ones as
+// their coefficients, so the other ranks only need the unit system when a
+// conversion is not affine. Those are counted in num_udunits and left for
+// the caller to build.
+int BroadcastConverters(const Config *config, ConverterContainer *converters,
+                        MPI_Comm mpi_comm, size_t *num_udunits) {
+  int rank;
+  MPI_Comm_rank(mpi_comm, &rank);
+  size_t num_mappings = config->num_mappings;
+  double coefficients[3 * num_mappings];
+  for (size_t i = 0; i < num_mappings; ++i) {
+    double *kind = &coefficients[3 * i];
+    if (rank != 0) {
+      continue;
+    }
+    const FileConfig *mapping = &config->mappings[i];
+    if (BuildConverter(mapping->source_unit, mapping->target_unit,
+                       &converters[i])) {
+      fprintf(stderr, "error: unable to build the converter for %s -> %s\n",
+              mapping->source_unit, mapping->target_unit);
+      kind[0] = converter_failed;
+    } else if (converters[i].cv == NULL) {
+      kind[0] = converter_none;
+    } else if (AffineCoefficients(&converters[i], &kind[1], &kind[2])) {
+      kind[0] = converter_affine;
+    } else {
+      kind[0] = converter_udunits;
+    }
+  }
+  MPI_Bcast(coefficients, (int)(3 * num_mappings), MPI_DOUBLE, 0, mpi_comm);
+  *num_udunits = 0;
+  for (size_t i = 0; i < num_mappings; ++i) {
+    int kind = (int)coefficients[3 * i];
+    if (kind == converter_failed) {
+      return 1;
+    } else if (kind == converter_affine) {
+      SetAffineConverter(&converters[i], coefficients[3 * i + 1],
+                         coefficients[3 * i + 2]);
+    } else if (kind == converter_udunits) {
+      ++*num_udunits;
+    }
+  }
+  return 0;
+}
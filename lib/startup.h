@@ -0,0 +1,27 @@
+#ifndef WTH_STARTUP_H_
+#define WTH_STARTUP_H_
+#include <stddef.h>
+
+#include <mpi.h>
+
+#include "config.h"
+#include "io.h"
+#include "unit_util.h"
+
+// How the root builds each converter for the other ranks.
+enum {
+  converter_none,
+  converter_affine,
+  converter_udunits,
+  converter_failed
+};
+
+char *BroadcastConfigText(const char *source, MPI_Comm mpi_comm);
+size_t PackNetCdfInfo(const NetCdfInfo *info, size_t num_mappings, char *dest,
+                      size_t dest_size);
+int UnpackNetCdfInfo(const char *source, size_t size, NetCdfInfo *info,
+                     size_t num_mappings);
+int BroadcastNetCdfInfo(Config *config, NetCdfInfo *info, MPI_Comm mpi_comm);
+int BroadcastConverters(const Config *config, ConverterContainer *converters,
+                        MPI_Comm mpi_comm, size_t *num_udunits);
+#endif // WTH_STARTUP_H_
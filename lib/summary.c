@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <netcdf.h>
+#include <netcdf_par.h>
+
+#include "rechunk.h"
+#include "summary.h"
+
+static const char *kLongitudeString = "lon";
+static const char *kLatitudeString = "lat";
+
+int InitSummaryGrid(SummaryGrid *grid, Hyperslab slab) {
+  grid->slab = slab;
+  grid->cells = slab.edges.x_length * slab.edges.y_length;
+  grid->tav = (float *)malloc(sizeof(float) * grid->cells);
+  grid->amp = (float *)malloc(sizeof(float) * grid->cells);
+  grid->rain = (float *)malloc(sizeof(float) * grid->cells);
+  grid->missing_days = (int *)malloc(sizeof(int) * grid->cells);
+  if (grid->tav == NULL || grid->amp == NULL || grid->rain == NULL ||
+      grid->missing_days == NULL) {
+    fprintf(stderr, "error: unable to allocate the summary of %zu cells\n",
+            grid->cells);
+    FreeSummaryGrid(grid);
+    return 1;
+  }
+  for (size_t i = 0; i < grid->cells; ++i) {
+    grid->tav[i] = NC_FILL_FLOAT;
+    grid->amp[i] = NC_FILL_FLOAT;
+    grid->rain[i] = NC_FILL_FLOAT;
+    grid->missing_days[i] = NC_FILL_INT;
+  }
+  return 0;
+}
+
+// The mean annual rainfall of the RAIN mapping over the days it has, and the
+// number of days on which a mapping written to the weather file is missing.
+void SummarizeSeries(const Config *config, const float *fills,
+                     const float *series, size_t days, float *rain,
+                     int *missing_days) {
+  *rain = NC_FILL_FLOAT;
+  *missing_days = 0;
+  for (size_t d = 0; d < days; ++d) {
+    for (size_t m = 0; m < config->num_mappings; ++m) {
+      if (config->mappings[m].output && series[m * days + d] == fills[m]) {
+        ++*missing_days;
+        break;
+      }
+    }
+  }
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    const char *dssat_var = config->mappings[m].dssat_var;
+    if (dssat_var == NULL || strcmp(dssat_var, "RAIN") != 0) {
+      continue;
+    }
+    double total = 0.0;
+    for (size_t d = 0; d < days; ++d) {
+      if (series[m * days + d] != fills[m]) {
+        total += series[m * days + d];
+      }
+    }
+    *rain = (float)(total * SUMMARY_DAYS_PER_YEAR / days);
+    return;
+  }
+}
+
+void AddCellSummary(SummaryGrid *grid, XY position, double tav, float amp,
+                    float rain, int missing_days) {
+  size_t index = (position.y - grid->slab.corner.y) *
+                     grid->slab.edges.x_length +
+                 position.x - grid->slab.corner.x;
+  grid->tav[index] = (float)tav;
+  grid->amp[index] = amp;
+  grid->rain[index] = rain;
+  grid->missing_days[index] = missing_days;
+}
+
+static int DefineSummaryVariable(int ncid, const char *name, nc_type type,
+                                 const int *dimids, const char *long_name,
+                                 const char *units, int *varid) {
+  int status;
+  if ((status = nc_def_var(ncid, name, type, 2, dimids, varid)) ||
+      (status = nc_put_att_text(ncid, *varid, "long_name", strlen(long_name),
+                                long_name)) ||
+      (status = nc_put_att_text(ncid, *varid, "units", strlen(units),
+                                units))) {
+    fprintf(stderr, "error: cannot define %s in the summary: %s\n", name,
+            nc_strerror(status));
+    return 1;
+  }
+  return 0;
+}
+
+// Writes the summary of every rank into one file on the grid of the input,
+// by all ranks of the run together. Ranks sharing a slab through a node
+// first combine their cells on the first rank of the node, which writes
+// them; the fill values are the largest floats and the smallest ints, so
+// the written cells win the reduction.
+int WriteSummaryGrid(SummaryGrid *grid, const char *file_name,
+                     const FileConfig *mapping, const NetCdfInfo *info,
+                     MPI_Comm mpi_comm, MPI_Comm node_comm) {
+  int status;
+  int comm_rank;
+  MPI_Comm_rank(mpi_comm, &comm_rank);
+  int writes = 1;
+  if (node_comm != MPI_COMM_NULL) {
+    int node_rank;
+    MPI_Comm_rank(node_comm, &node_rank);
+    writes = node_rank == 0;
+    int count = (int)grid->cells;
+    float *floats[3] = {grid->tav, grid->amp, grid->rain};
+    for (size_t i = 0; i < 3; ++i) {
+      MPI_Reduce(writes ? MPI_IN_PLACE : floats[i], floats[i], count,
+                 MPI_FLOAT, MPI_MIN, 0, node_comm);
+    }
+    MPI_Reduce(writes ? MPI_IN_PLACE : grid->missing_days, grid->missing_days,
+               count, MPI_INT, MPI_MAX, 0, node_comm);
+  }
+
+  int ncid;
+  if ((status = nc_create_par(file_name, NC_NETCDF4 | NC_CLOBBER, mpi_comm,
+                              MPI_INFO_NULL, &ncid))) {
+    fprintf(stderr, "error: cannot create %s: %s\n", file_name,
+            nc_strerror(status));
+    return 1;
+  }
+  int failed = 0;
+  int dimids[2];
+  int lon_varid, lat_varid, tav_varid, amp_varid, rain_varid, missing_varid;
+  if ((status = nc_def_dim(ncid, kLatitudeString, info->latitude_len,
+                           &dimids[0])) ||
+      (status = nc_def_dim(ncid, kLongitudeString, info->longitude_len,
+                           &dimids[1]))) {
+    fprintf(stderr, "error: cannot define dimensions in %s: %s\n", file_name,
+            nc_strerror(status));
+    failed = 1;
+  }
+  failed = failed ||
+           DefineCoordinate(mapping->netcdf_id, info->longitude_varid, ncid,
+                            kLongitudeString, dimids[1], &lon_varid) ||
+           DefineCoordinate(mapping->netcdf_id, info->latitude_varid, ncid,
+                            kLatitudeString, dimids[0], &lat_varid) ||
+           DefineSummaryVariable(ncid, "tav", NC_FLOAT, dimids,
+                                 "average temperature", "degree_C",
+                                 &tav_varid) ||
+           DefineSummaryVariable(ncid, "amp", NC_FLOAT, dimids,
+                                 "amplitude of monthly mean temperatures",
+                                 "degree_C", &amp_varid) ||
+           DefineSummaryVariable(ncid, "rain", NC_FLOAT, dimids,
+                                 "mean annual rainfall", "mm year-1",
+                                 &rain_varid) ||
+           DefineSummaryVariable(ncid, "missing_days", NC_INT, dimids,
+                                 "days with a missing value", "days",
+                                 &missing_varid);
+  if (!failed && (status = nc_enddef(ncid))) {
+    fprintf(stderr, "error: cannot write the header of %s: %s\n", file_name,
+            nc_strerror(status));
+    failed = 1;
+  }
+  if (!failed && comm_rank == 0) {
+    failed = CopyCoordinate(mapping->netcdf_id, info->longitude_varid, ncid,
+                            lon_varid, info->longitude_len) ||
+             CopyCoordinate(mapping->netcdf_id, info->latitude_varid, ncid,
+                            lat_varid, info->latitude_len);
+  }
+  if (!failed && writes && grid->cells > 0) {
+    size_t start[2] = {grid->slab.corner.y, grid->slab.corner.x};
+    size_t count[2] = {grid->slab.edges.y_length, grid->slab.edges.x_length};
+    if ((status = nc_put_vara_float(ncid, tav_varid, start, count,
+                                    grid->tav)) ||
+        (status = nc_put_vara_float(ncid, amp_varid, start, count,
+                                    grid->amp)) ||
+        (status = nc_put_vara_float(ncid, rain_varid, start, count,
+                                    grid->rain)) ||
+        (status = nc_put_vara_int(ncid, missing_varid, start, count,
+                                  grid->missing_days))) {
+      fprintf(stderr, "error: cannot write to %s: %s\n", file_name,
+              nc_strerror(status));
+      failed = 1;
+    }
+  }
+  if ((status = nc_close(ncid))) {
+    fprintf(stderr, "error: cannot close %s: %s\n", file_name,
+            nc_strerror(status));
+    failed = 1;
+  }
+  return failed;
+}
+
+void FreeSummaryGrid(SummaryGrid *grid) {
+  free(grid->tav);
+  free(grid->amp);
+  free(grid->rain);
+  free(grid->missing_days);
+  grid->tav = NULL;
+  grid->amp = NULL;
+  grid->rain = NULL;
+  grid->missing_days = NULL;
+  grid->cells = 0;
+}
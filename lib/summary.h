@@ -0,0 +1,37 @@
+#ifndef WTH_SUMMARY_H_
+#define WTH_SUMMARY_H_
+#include <stddef.h>
+
+#include <mpi.h>
+
+#include "config.h"
+#include "hyperslab.h"
+#include "io.h"
+#include "location.h"
+
+// Days in the average year the annual rainfall is given for
+#define SUMMARY_DAYS_PER_YEAR 365.25
+
+// The gridded summary of the cells of one slab: TAV and AMP as written in
+// the weather files, the mean annual rainfall and the days with a missing
+// value. Cells which are not written keep the NetCDF fill values.
+typedef struct SummaryGrid_ {
+  Hyperslab slab;
+  size_t cells;
+  float *tav;
+  float *amp;
+  float *rain;
+  int *missing_days;
+} SummaryGrid;
+
+int InitSummaryGrid(SummaryGrid *grid, Hyperslab slab);
+void SummarizeSeries(const Config *config, const float *fills,
+                     const float *series, size_t days, float *rain,
+                     int *missing_days);
+void AddCellSummary(SummaryGrid *grid, XY position, double tav, float amp,
+                    float rain, int missing_days);
+int WriteSummaryGrid(SummaryGrid *grid, const char *file_name,
+                     const FileConfig *mapping, const NetCdfInfo *info,
+                     MPI_Comm mpi_comm, MPI_Comm node_comm);
+void FreeSummaryGrid(SummaryGrid *grid);
+#endif // WTH_SUMMARY_H_
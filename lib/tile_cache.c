@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tile_cache.h"
+
+int InitTileCache(TileCache *cache, size_t capacity, size_t values_per_entry) {
+  cache->capacity = capacity;
+  cache->values_per_entry = values_per_entry;
+  cache->clock = 0;
+  cache->hits = 0;
+  cache->misses = 0;
+  cache->entries = (TileCacheEntry *)calloc(capacity, sizeof(TileCacheEntry));
+  if (cache->entries == NULL) {
+    fprintf(stderr, "error: unable to allocate the tile cache\n");
+    return 1;
+  }
+  for (size_t i = 0; i < capacity; ++i) {
+    cache->entries[i].values =
+        (float *)malloc(sizeof(float) * values_per_entry);
+    if (cache->entries[i].values == NULL) {
+      fprintf(stderr, "error: unable to allocate %zu bytes for a cached "
+                      "tile\n",
+              sizeof(float) * values_per_entry);
+      FreeTileCache(cache);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Returns the entry holding the tile with hit set, or hands out the least
+// recently used entry for the caller to fill, which it then has to either
+// keep or invalidate.
+TileCacheEntry *LookupTile(TileCache *cache, size_t tile_x, size_t tile_y,
+                           int *hit) {
+  TileCacheEntry *victim = &cache->entries[0];
+  ++cache->clock;
+  for (size_t i = 0; i < cache->capacity; ++i) {
+    TileCacheEntry *entry = &cache->entries[i];
+    if (entry->valid && entry->tile_x == tile_x && entry->tile_y == tile_y) {
+      entry->last_used = cache->clock;
+      ++cache->hits;
+      *hit = 1;
+      return entry;
+    }
+    // Empty entries are used before any tile is evicted
+    if (victim->valid &&
+        (!entry->valid || entry->last_used < victim->last_used)) {
+      victim = entry;
+    }
+  }
+  ++cache->misses;
+  victim->tile_x = tile_x;
+  victim->tile_y = tile_y;
+  victim->last_used = cache->clock;
+  victim->valid = 1;
+  *hit = 0;
+  return victim;
+}
+
+void InvalidateTile(TileCacheEntry *entry) { entry->valid = 0; }
+
+void FreeTileCache(TileCache *cache) {
+  if (cache->entries != NULL) {
+    for (size_t i = 0; i < cache->capacity; ++i) {
+      free(cache->entries[i].values);
+    }
+  }
+  free(cache->entries);
+  cache->entries = NULL;
+  cache->capacity = 0;
+}
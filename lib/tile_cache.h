@@ -0,0 +1,34 @@
+#ifndef WTH_TILE_CACHE_H_
+#define WTH_TILE_CACHE_H_
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hyperslab.h"
+
+// One decoded tile: the converted values of every mapping over a block of
+// cells, laid out like a slab of the extraction.
+typedef struct TileCacheEntry_ {
+  size_t tile_x;
+  size_t tile_y;
+  Hyperslab slab;
+  float *values;
+  uint64_t last_used;
+  int valid;
+} TileCacheEntry;
+
+// A small least recently used cache of decoded tiles kept in memory.
+typedef struct TileCache_ {
+  TileCacheEntry *entries;
+  size_t capacity;
+  size_t values_per_entry;
+  uint64_t clock;
+  size_t hits;
+  size_t misses;
+} TileCache;
+
+int InitTileCache(TileCache *cache, size_t capacity, size_t values_per_entry);
+TileCacheEntry *LookupTile(TileCache *cache, size_t tile_x, size_t tile_y,
+                           int *hit);
+void InvalidateTile(TileCacheEntry *entry);
+void FreeTileCache(TileCache *cache);
+#endif // WTH_TILE_CACHE_H_
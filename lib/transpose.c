@@ -0,0 +1,170 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "perf.h"
+#include "transpose.h"
+
+static void BlockShare(size_t length, size_t index, size_t count,
+                       size_t *first, size_t *share) {
+  size_t base = length / count;
+  size_t extra = length % count;
+  *first = index * base + (index < extra ? index : extra);
+  *share = base + (index < extra ? 1 : 0);
+}
+
+// The days of the file-th of num_files file mappings a rank reads over the
+// whole extent. By time, every rank reads its range of days of every file;
+// by variable, the ranks are dealt out to the files and the ranks of a file
+// split its days, or each rank reads whole files when there are more files
+// than ranks. Ranks which read nothing of the file get no days.
+void PlanTransposedRead(int strategy, size_t num_files, size_t file,
+                        size_t time_len, int rank, int size, size_t *first_day,
+                        size_t *days) {
+  if (strategy == read_by_time) {
+    BlockShare(time_len, (size_t)rank, (size_t)size, first_day, days);
+    return;
+  }
+  *first_day = 0;
+  *days = 0;
+  if ((size_t)size < num_files) {
+    if (file % (size_t)size == (size_t)rank) {
+      *days = time_len;
+    }
+    return;
+  }
+  if ((size_t)rank % num_files != file) {
+    return;
+  }
+  size_t readers = (size_t)size / num_files +
+                   (file < (size_t)size % num_files ? 1 : 0);
+  BlockShare(time_len, (size_t)rank / num_files, readers, first_day, days);
+}
+
+// Copies the cells of slab out of a block of days read over the extent, in
+// the layout of the slab.
+static void PackSlab(const float *block, Hyperslab extent, size_t days,
+                     Hyperslab slab, float *dest) {
+  size_t x0 = slab.corner.x - extent.corner.x;
+  size_t y0 = slab.corner.y - extent.corner.y;
+  for (size_t d = 0; d < days; ++d) {
+    for (size_t y = 0; y < slab.edges.y_length; ++y) {
+      const float *row = &block[(d * extent.edges.y_length + y0 + y) *
+                                    extent.edges.x_length +
+                                x0];
+      for (size_t x = 0; x < slab.edges.x_length; ++x) {
+        *dest++ = row[x];
+      }
+    }
+  }
+}
+
+// Reads the file mappings of the extent in blocks of whole daily maps
+// spread over the ranks, then exchanges them with MPI_Alltoallv so that each
+// rank ends up with its slab of slabs in dest, laid out like ReadHyperslab
+// leaves it. Collective over mpi_comm; every rank has to pass the same
+// extent and slabs.
+int TransposedRead(const Config *config, const NetCdfInfo *info,
+                   Hyperslab extent, const Hyperslab *slabs, MPI_Comm mpi_comm,
+                   float *dest, TransposeStats *stats) {
+  int rank;
+  int size;
+  MPI_Comm_rank(mpi_comm, &rank);
+  MPI_Comm_size(mpi_comm, &size);
+  size_t time_len = extent.edges.days;
+  size_t map_cells = extent.edges.x_length * extent.edges.y_length;
+  size_t num_files = 0;
+  size_t max_slab_cells = 0;
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    num_files += config->mappings[m].derived == NULL;
+  }
+  for (int q = 0; q < size; ++q) {
+    size_t cells = slabs[q].edges.x_length * slabs[q].edges.y_length;
+    max_slab_cells = cells > max_slab_cells ? cells : max_slab_cells;
+  }
+  // The counts and displacements of MPI_Alltoallv are ints
+  if (time_len * max_slab_cells > INT_MAX || time_len * map_cells > INT_MAX) {
+    fprintf(stderr, "error: [%d] transposed reads of %zu days over %zu "
+                    "cells exceed the MPI count limit\n",
+            rank, time_len, map_cells);
+    return 1;
+  }
+
+  Hyperslab own = slabs[rank];
+  size_t own_cells = own.edges.x_length * own.edges.y_length;
+  int *send_counts = (int *)malloc(sizeof(int) * size * 4);
+  if (send_counts == NULL) {
+    fprintf(stderr, "error: [%d] unable to allocate the exchange plan\n",
+            rank);
+    return 1;
+  }
+  int *send_displs = &send_counts[size];
+  int *recv_counts = &send_counts[2 * size];
+  int *recv_displs = &send_counts[3 * size];
+  int status = 0;
+  size_t file = 0;
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    if (config->mappings[m].derived != NULL) {
+      continue;
+    }
+    size_t first_day;
+    size_t days;
+    PlanTransposedRead(config->read_strategy, num_files, file, time_len, rank,
+                       size, &first_day, &days);
+    float *block = NULL;
+    float *packed = NULL;
+    double read_start = PerfWallTime();
+    if (days > 0) {
+      block = (float *)malloc(sizeof(float) * days * map_cells);
+      packed = (float *)malloc(sizeof(float) * days * map_cells);
+      if (block == NULL || packed == NULL) {
+        fprintf(stderr, "error: [%d] unable to allocate %zu days of %s\n",
+                rank, days, config->mappings[m].netcdf_var);
+        status = 1;
+      } else {
+        Hyperslab read = CreateHyperslab(
+            Position(first_day, extent.corner.x, extent.corner.y),
+            Edges(days, extent.edges.x_length, extent.edges.y_length));
+        status = ReadHyperslab(&config->mappings[m], &info[m], read, block);
+        stats->bytes_read += sizeof(float) * read.flat_size;
+      }
+    }
+    double exchange_start = PerfWallTime();
+    stats->read_seconds += exchange_start - read_start;
+    // A failed read on any rank stops all of them before the exchange
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MAX, mpi_comm);
+    if (status) {
+      free(block);
+      free(packed);
+      break;
+    }
+    size_t offset = 0;
+    for (int q = 0; q < size; ++q) {
+      size_t cells = slabs[q].edges.x_length * slabs[q].edges.y_length;
+      send_counts[q] = (int)(days * cells);
+      send_displs[q] = (int)offset;
+      if (days > 0) {
+        PackSlab(block, extent, days, slabs[q], &packed[offset]);
+      }
+      offset += days * cells;
+      if (q != rank) {
+        stats->bytes_sent += sizeof(float) * days * cells;
+      }
+      size_t source_first;
+      size_t source_days;
+      PlanTransposedRead(config->read_strategy, num_files, file, time_len, q,
+                         size, &source_first, &source_days);
+      recv_counts[q] = (int)(source_days * own_cells);
+      recv_displs[q] = (int)(source_first * own_cells);
+    }
+    MPI_Alltoallv(packed, send_counts, send_displs, MPI_FLOAT,
+                  &dest[m * own.flat_size], recv_counts, recv_displs,
+                  MPI_FLOAT, mpi_comm);
+    stats->exchange_seconds += PerfWallTime() - exchange_start;
+    free(block);
+    free(packed);
+    ++file;
+  }
+  free(send_counts);
+  return status;
+}
@@ -0,0 +1,24 @@
+#ifndef WTH_TRANSPOSE_H_
+#define WTH_TRANSPOSE_H_
+#include <stddef.h>
+
+#include <mpi.h>
+
+#include "config.h"
+#include "hyperslab.h"
+#include "io.h"
+
+typedef struct TransposeStats_ {
+  double read_seconds;
+  double exchange_seconds;
+  size_t bytes_read;
+  size_t bytes_sent;
+} TransposeStats;
+
+void PlanTransposedRead(int strategy, size_t num_files, size_t file,
+                        size_t time_len, int rank, int size, size_t *first_day,
+                        size_t *days);
+int TransposedRead(const Config *config, const NetCdfInfo *info,
+                   Hyperslab extent, const Hyperslab *slabs, MPI_Comm mpi_comm,
+                   float *dest, TransposeStats *stats);
+#endif // WTH_TRANSPOSE_H_
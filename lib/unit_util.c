@@ -1,3 +1,4 @@
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -11,13 +12,20 @@ void InitUnitSystem() {
   ut_set_error_message_handler(ut_write_to_stderr);
 }
 
-void FreeUnitSystem() { ut_free_system(kUnitSystem); }
+void FreeUnitSystem() {
+  ut_free_system(kUnitSystem);
+  kUnitSystem = NULL;
+}
+
+int UnitSystemLoaded() { return kUnitSystem != NULL; }
 
 int BuildConverter(const char *source, const char *target,
                    ConverterContainer *container) {
   container->cv = NULL;
   container->have_unit = NULL;
   container->want_unit = NULL;
+  container->affine = 0;
+  container->packed = 0;
   if (source == NULL || target == NULL) {
     return converter_ok;
   }
@@ -48,12 +56,71 @@ void FreeConverterContainer(ConverterContainer *cc) {
   cc->cv = NULL;
   cc->have_unit = NULL;
   cc->want_unit = NULL;
+  cc->affine = 0;
+  cc->packed = 0;
+}
+
+// Temperature offsets and the scale factors of fluxes are affine, so the
+// converter is reduced to y = slope * x + intercept when it samples as one.
+// Logarithmic units and the like are left to udunits.
+int AffineCoefficients(const ConverterContainer *cc, double *slope,
+                       double *intercept) {
+  if (cc->affine) {
+    *slope = cc->slope;
+    *intercept = cc->intercept;
+    return 1;
+  }
+  if (cc->cv == NULL) {
+    *slope = 1.0;
+    *intercept = 0.0;
+    return 1;
+  }
+  *intercept = cv_convert_double(cc->cv, 0.0);
+  *slope = cv_convert_double(cc->cv, 1.0) - *intercept;
+  const double samples[] = {-1000.0, 273.15, 1.0e6};
+  for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); ++i) {
+    double expected = cv_convert_double(cc->cv, samples[i]);
+    double actual = *slope * samples[i] + *intercept;
+    if (!(fabs(actual - expected) <= 1.0e-9 * (fabs(expected) + 1.0))) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Replaces the converter by its coefficients, which needs no unit system.
+void SetAffineConverter(ConverterContainer *cc, double slope,
+                        double intercept) {
+  FreeConverterContainer(cc);
+  cc->affine = 1;
+  cc->slope = slope;
+  cc->intercept = intercept;
+}
+
+// Folds the unpacking of a packed variable, scale * x + offset, into the
+// converter, so an affine conversion still takes a single multiply and add
+// from the packed values. Conversions left to udunits unpack first.
+void PackConverter(ConverterContainer *cc, double scale, double offset) {
+  double slope;
+  double intercept;
+  if (AffineCoefficients(cc, &slope, &intercept)) {
+    SetAffineConverter(cc, slope * scale, slope * offset + intercept);
+    return;
+  }
+  cc->packed = 1;
+  cc->pack_scale = scale;
+  cc->pack_offset = offset;
 }
 
-float ConvertValue(const cv_converter *converter, const float val) {
-  if (converter == NULL) {
+float ConvertValue(const ConverterContainer *cc, const float val) {
+  if (cc->affine) {
+    return (float)(cc->slope * val + cc->intercept);
+  } else if (cc->cv == NULL) {
     return val;
+  } else if (cc->packed) {
+    return cv_convert_float(cc->cv,
+                            (float)(cc->pack_scale * val + cc->pack_offset));
   } else {
-    return cv_convert_float(converter, val);
+    return cv_convert_float(cc->cv, val);
   }
 }
\ No newline at end of file
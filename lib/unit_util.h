@@ -6,14 +6,26 @@ typedef struct cv_retainer {
   cv_converter *cv;
   ut_unit *have_unit;
   ut_unit *want_unit;
+  int affine;
+  double slope;
+  double intercept;
+  int packed;
+  double pack_scale;
+  double pack_offset;
 } ConverterContainer;
 
 enum { converter_ok, converter_error };
 
 void InitUnitSystem();
 void FreeUnitSystem();
+int UnitSystemLoaded();
 int BuildConverter(const char *source, const char *target,
                    ConverterContainer *container);
 void FreeConverterContainer(ConverterContainer *cc);
-float ConvertValue(const cv_converter *converter, const float val);
+int AffineCoefficients(const ConverterContainer *cc, double *slope,
+                       double *intercept);
+void SetAffineConverter(ConverterContainer *cc, double slope,
+                        double intercept);
+void PackConverter(ConverterContainer *cc, double scale, double offset);
+float ConvertValue(const ConverterContainer *cc, const float val);
 #endif // GGCMI_WTH_GEN__UNIT_UTIL_H_
@@ -0,0 +1,29 @@
+#include "weather_file.h"
+
+// Renders the DSSAT weather file of a cell. The series holds every mapping
+// of the cell one after the other, with dates->days values each, and only
+// the mappings marked for output are written.
+void WriteWeatherFile(FILE *fh, const Config *config, const DateTable *dates,
+                      LonLat position, const float *series, double tav,
+                      float amp) {
+  fprintf(fh, "*WEATHER DATA: GGCMI\n\n");
+  fprintf(fh, "@ INSI      LAT     LONG  ELEV   TAV   AMP REFHT WNDHT\n");
+  fprintf(fh, " GGCMI %8.2f %8.2f %5d %5.1f %5.1f\n", position.latitude,
+          position.longitude, -99, tav, amp);
+  fprintf(fh, "@DATE");
+  for (size_t m = 0; m < config->num_mappings; ++m) {
+    if (config->mappings[m].output) {
+      fprintf(fh, "  %4s", config->mappings[m].dssat_var);
+    }
+  }
+  fprintf(fh, "\n");
+  for (size_t d = 0; d < dates->days; ++d) {
+    fprintf(fh, "%s", dates->dssat[d]);
+    for (size_t m = 0; m < config->num_mappings; ++m) {
+      if (config->mappings[m].output) {
+        fprintf(fh, " %5.1f", series[m * dates->days + d]);
+      }
+    }
+    fprintf(fh, "\n");
+  }
+}
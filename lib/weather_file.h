@@ -0,0 +1,12 @@
+#ifndef WTH_WEATHER_FILE_H_
+#define WTH_WEATHER_FILE_H_
+#include <stdio.h>
+
+#include "calendar.h"
+#include "config.h"
+#include "location.h"
+
+void WriteWeatherFile(FILE *fh, const Config *config, const DateTable *dates,
+                      LonLat position, const float *series, double tav,
+                      float amp);
+#endif // WTH_WEATHER_FILE_H_
@@ -0,0 +1,69 @@
+#include <mpi.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "admission.h"
+#include "perf.h"
+}
+
+// Slots in local memory stand in for the window a node shares.
+static void LocalAdmission(Admission *admission, AdmissionSlots *slots,
+                           int limit, int ceiling) {
+  admission->slots = slots;
+  admission->ceiling = ceiling;
+  admission->files = 0;
+  admission->wait_seconds = 0.0;
+  admission->first_start = -1.0;
+  admission->last_end = -1.0;
+  pthread_mutex_init(&admission->lock, NULL);
+  slots->in_use = 0;
+  slots->limit = limit;
+  slots->fastest_ns = INT64_MAX;
+}
+
+TEST(AdmissionTest, ceiling_is_the_node_share_of_the_limits) {
+  EXPECT_EQ(16u, AdmissionCeiling(64, 0, 4));
+  EXPECT_EQ(8u, AdmissionCeiling(64, 8, 4));
+  EXPECT_EQ(1u, AdmissionCeiling(3, 0, 4));
+  EXPECT_EQ(5u, AdmissionCeiling(0, 5, 4));
+  EXPECT_EQ((size_t)INT32_MAX, AdmissionCeiling(0, 0, 2));
+}
+
+TEST(AdmissionTest, slots_are_taken_and_given_back) {
+  Admission admission;
+  AdmissionSlots slots;
+  LocalAdmission(&admission, &slots, 2, 2);
+  double first = AdmitFile(&admission);
+  double second = AdmitFile(&admission);
+  EXPECT_EQ(2, slots.in_use);
+  ReleaseFile(&admission, first);
+  ReleaseFile(&admission, second);
+  EXPECT_EQ(0, slots.in_use);
+  EXPECT_EQ(2u, admission.files);
+  EXPECT_LE(admission.first_start, admission.last_end);
+  pthread_mutex_destroy(&admission.lock);
+}
+
+TEST(AdmissionTest, limit_follows_the_create_latency) {
+  Admission admission;
+  AdmissionSlots slots;
+  LocalAdmission(&admission, &slots, 2, 3);
+  // A fast create raises the limit up to the ceiling
+  ReleaseFile(&admission, AdmitFile(&admission));
+  EXPECT_EQ(3, slots.limit);
+  ReleaseFile(&admission, AdmitFile(&admission));
+  EXPECT_EQ(3, slots.limit);
+  // One taking far longer than the fastest lowers it, down to one
+  for (int i = 0; i < 4; ++i) {
+    AdmitFile(&admission);
+    ReleaseFile(&admission, PerfWallTime() - 1.0);
+  }
+  EXPECT_EQ(1, slots.limit);
+  EXPECT_EQ(0, slots.in_use);
+  pthread_mutex_destroy(&admission.lock);
+}
+
+TEST(AdmissionTest, without_admission_files_are_not_held) {
+  ReleaseFile(NULL, AdmitFile(NULL));
+}
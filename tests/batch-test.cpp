@@ -0,0 +1,42 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "batch.h"
+}
+
+TEST(BatchTest, fewer_ranks_than_scenarios_balances_cost) {
+  double costs[] = {1.0, 4.0, 2.0, 3.0};
+  size_t scenario_group[4];
+  int group_ranks[4];
+  size_t num_groups = 0;
+  ASSERT_EQ(0, PlanBatch(costs, 4, 2, scenario_group, group_ranks,
+                         &num_groups));
+  ASSERT_EQ(2, num_groups);
+  EXPECT_EQ(1, group_ranks[0]);
+  EXPECT_EQ(1, group_ranks[1]);
+  // 4 + 1 against 3 + 2
+  EXPECT_EQ(scenario_group[1], scenario_group[0]);
+  EXPECT_EQ(scenario_group[3], scenario_group[2]);
+  EXPECT_NE(scenario_group[0], scenario_group[2]);
+}
+
+TEST(BatchTest, spare_ranks_follow_cost) {
+  double costs[] = {1.0, 3.0};
+  size_t scenario_group[2];
+  int group_ranks[2];
+  size_t num_groups = 0;
+  ASSERT_EQ(0, PlanBatch(costs, 2, 8, scenario_group, group_ranks,
+                         &num_groups));
+  ASSERT_EQ(2, num_groups);
+  EXPECT_EQ(2, group_ranks[scenario_group[0]]);
+  EXPECT_EQ(6, group_ranks[scenario_group[1]]);
+}
+
+TEST(BatchTest, ranks_map_to_consecutive_groups) {
+  int group_ranks[] = {2, 1, 3};
+  EXPECT_EQ(0, GroupOfRank(group_ranks, 3, 0));
+  EXPECT_EQ(0, GroupOfRank(group_ranks, 3, 1));
+  EXPECT_EQ(1, GroupOfRank(group_ranks, 3, 2));
+  EXPECT_EQ(2, GroupOfRank(group_ranks, 3, 3));
+  EXPECT_EQ(2, GroupOfRank(group_ranks, 3, 5));
+}
@@ -247,3 +247,37 @@ TEST(CalendarTest, check_dssat_format_mar_no_leap) {
   ASSERT_EQ(0, status);
   ASSERT_STREQ("81073", dssat2_string);
 }
+
+TEST(CalendarTest, date_table_marks_month_ends) {
+  DateTable table;
+  ASSERT_EQ(0, BuildDateTable("2011-01-30", 33, &table));
+  ASSERT_EQ(33, table.days);
+  EXPECT_STREQ("11030", table.dssat[0]);
+  EXPECT_STREQ("11032", table.dssat[2]);
+  EXPECT_EQ(30, table.day_of_month[0]);
+  EXPECT_EQ(0, table.month_ends[0]);
+  EXPECT_EQ(1, table.month_ends[1]);
+  EXPECT_EQ(1, table.day_of_month[2]);
+  EXPECT_EQ(1, table.month_ends[29]);
+  EXPECT_EQ(1, table.day_of_month[30]);
+  FreeDateTable(&table);
+  EXPECT_EQ(nullptr, table.dssat);
+}
+
+TEST(CalendarTest, temperature_summary_uses_monthly_averages) {
+  DateTable table;
+  ASSERT_EQ(0, BuildDateTable("2011-01-01", 59, &table));
+  float tmin[59];
+  float tmax[59];
+  for (size_t d = 0; d < 59; ++d) {
+    tmin[d] = 0.0f;
+    tmax[d] = d < 31 ? 10.0f : 20.0f;
+  }
+  double tav;
+  float amp;
+  SummarizeTemperatures(tmin, tmax, &table, &tav, &amp);
+  // Two complete months, averaged over one more as the files always were
+  EXPECT_DOUBLE_EQ(5.0, tav);
+  EXPECT_FLOAT_EQ(5.0f, amp);
+  FreeDateTable(&table);
+}
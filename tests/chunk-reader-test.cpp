@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <hdf5.h>
+#include <netcdf.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "chunk_reader.h"
+}
+
+TEST(ChunkReaderTest, unshuffle_restores_elements) {
+  // Three 4 byte elements stored as byte planes
+  const unsigned char shuffled[12] = {0x01, 0x11, 0x21, 0x02, 0x12, 0x22,
+                                      0x03, 0x13, 0x23, 0x04, 0x14, 0x24};
+  const unsigned char expected[12] = {0x01, 0x02, 0x03, 0x04, 0x11, 0x12,
+                                      0x13, 0x14, 0x21, 0x22, 0x23, 0x24};
+  unsigned char dest[12];
+  UnshuffleBytes(shuffled, sizeof(shuffled), 4, dest);
+  for (size_t i = 0; i < sizeof(dest); ++i) {
+    EXPECT_EQ(expected[i], dest[i]);
+  }
+}
+
+TEST(ChunkReaderTest, unshuffle_keeps_trailing_bytes) {
+  const unsigned char shuffled[6] = {0x01, 0x02, 0x03, 0x04, 0xaa, 0xbb};
+  unsigned char dest[6];
+  UnshuffleBytes(shuffled, sizeof(shuffled), 4, dest);
+  EXPECT_EQ(0xaa, dest[4]);
+  EXPECT_EQ(0xbb, dest[5]);
+}
+
+TEST(ChunkReaderTest, missing_file_is_not_supported) {
+  EXPECT_EQ(nullptr, OpenChunkReader("chunk-reader-missing.nc", "tasmax", 2));
+}
+
+// A (time, lat, lon) variable of 5 x 7 x 6 floats in chunks of 2 x 3 x 4,
+// shuffled and deflated, so the last chunk along each axis is cut short.
+// The first chunk is never written and holds the fill value.
+class ChunkedFileTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    int fd = mkstemp(file_name_);
+    ASSERT_NE(-1, fd);
+    close(fd);
+    const hsize_t dims[3] = {5, 7, 6};
+    const hsize_t chunk_dims[3] = {2, 3, 4};
+    const hsize_t unwritten[3] = {0, 0, 0};
+    std::vector<float> values(5 * 7 * 6);
+    for (size_t i = 0; i < values.size(); ++i) {
+      values[i] = 0.25f * i - 20.0f;
+    }
+    hid_t file = H5Fcreate(file_name_, H5F_ACC_TRUNC, H5P_DEFAULT,
+                           H5P_DEFAULT);
+    ASSERT_GE(file, 0);
+    hid_t space = H5Screate_simple(3, dims, NULL);
+    hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(dcpl, 3, chunk_dims);
+    H5Pset_shuffle(dcpl);
+    H5Pset_deflate(dcpl, 4);
+    H5Pset_fill_value(dcpl, H5T_NATIVE_FLOAT, &kFill);
+    hid_t dataset = H5Dcreate2(file, "tasmax", H5T_NATIVE_FLOAT, space,
+                               H5P_DEFAULT, dcpl, H5P_DEFAULT);
+    ASSERT_GE(dataset, 0);
+    hid_t attribute_space = H5Screate(H5S_SCALAR);
+    hid_t attribute = H5Acreate2(dataset, "_FillValue", H5T_NATIVE_FLOAT,
+                                 attribute_space, H5P_DEFAULT, H5P_DEFAULT);
+    H5Awrite(attribute, H5T_NATIVE_FLOAT, &kFill);
+    H5Aclose(attribute);
+    H5Sclose(attribute_space);
+    // Everything but the first chunk
+    H5Sselect_all(space);
+    H5Sselect_hyperslab(space, H5S_SELECT_NOTB, unwritten, NULL, chunk_dims,
+                        NULL);
+    ASSERT_GE(H5Dwrite(dataset, H5T_NATIVE_FLOAT, space, space, H5P_DEFAULT,
+                       values.data()),
+              0);
+    unsigned int filter_mask;
+    haddr_t address = 0;
+    hsize_t stored;
+    H5Dget_chunk_info_by_coord(dataset, unwritten, &filter_mask, &address,
+                               &stored);
+    EXPECT_EQ(HADDR_UNDEF, address);
+    H5Dclose(dataset);
+    H5Pclose(dcpl);
+    H5Sclose(space);
+    H5Fclose(file);
+  }
+
+  void TearDown() override { remove(file_name_); }
+
+  // Reads a slab with the chunk reader and with netCDF, which must agree
+  void ExpectSameSlab(Hyperslab slab, size_t num_threads) {
+    ChunkReader *reader = OpenChunkReader(file_name_, "tasmax", num_threads);
+    ASSERT_NE(nullptr, reader);
+    std::vector<float> chunked(slab.flat_size, -1.0f);
+    EXPECT_EQ(0, ReadChunkedHyperslab(reader, slab, chunked.data()));
+    CloseChunkReader(reader);
+    int ncid;
+    int varid;
+    ASSERT_EQ(NC_NOERR, nc_open(file_name_, NC_NOWRITE, &ncid));
+    ASSERT_EQ(NC_NOERR, nc_inq_varid(ncid, "tasmax", &varid));
+    std::vector<float> expected(slab.flat_size);
+    EXPECT_EQ(NC_NOERR, nc_get_vara_float(ncid, varid, slab.corner.shape,
+                                          slab.edges.shape, expected.data()));
+    nc_close(ncid);
+    for (size_t i = 0; i < slab.flat_size; ++i) {
+      EXPECT_EQ(expected[i], chunked[i]) << "value #" << i;
+    }
+  }
+
+  static const float kFill;
+  char file_name_[32] = "/tmp/chunk-reader-XXXXXX";
+};
+
+const float ChunkedFileTest::kFill = 1.0e20f;
+
+TEST_F(ChunkedFileTest, whole_variable_matches_netcdf) {
+  ExpectSameSlab(CreateHyperslab(Position(0, 0, 0), Edges(5, 6, 7)), 1);
+}
+
+TEST_F(ChunkedFileTest, slab_inside_chunks_matches_netcdf) {
+  // Starts partway into chunks and runs into the edge chunks
+  ExpectSameSlab(CreateHyperslab(Position(1, 2, 1), Edges(4, 4, 6)), 3);
+  ExpectSameSlab(CreateHyperslab(Position(3, 5, 4), Edges(1, 1, 2)), 2);
+}
+
+TEST_F(ChunkedFileTest, unwritten_chunk_holds_the_fill_value) {
+  Hyperslab slab = CreateHyperslab(Position(0, 1, 1), Edges(2, 2, 2));
+  ChunkReader *reader = OpenChunkReader(file_name_, "tasmax", 2);
+  ASSERT_NE(nullptr, reader);
+  std::vector<float> chunked(slab.flat_size, -1.0f);
+  EXPECT_EQ(0, ReadChunkedHyperslab(reader, slab, chunked.data()));
+  CloseChunkReader(reader);
+  for (size_t i = 0; i < slab.flat_size; ++i) {
+    EXPECT_EQ(kFill, chunked[i]) << "value #" << i;
+  }
+  ExpectSameSlab(slab, 1);
+}
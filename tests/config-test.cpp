@@ -1,3 +1,5 @@
+#include <string>
+
 #include "gtest/gtest.h"
 
 extern "C" {
@@ -34,4 +36,165 @@ TEST(ConfigTest, check_non_writable_directory) {
     int expected = 0;
     int actual = DirectoryExists(directory);
     ASSERT_EQ(expected, actual);
-}
\ No newline at end of file
+}
+TEST(ConfigTest, parse_byte_size_integer) {
+    size_t bytes = 0;
+    json_t *value = json_integer(4096);
+    ASSERT_EQ(1, ParseByteSize(value, &bytes));
+    ASSERT_EQ(4096, bytes);
+    json_decref(value);
+}
+
+TEST(ConfigTest, parse_byte_size_suffix) {
+    size_t bytes = 0;
+    json_t *value = json_string("1.5G");
+    ASSERT_EQ(1, ParseByteSize(value, &bytes));
+    ASSERT_EQ(1610612736, bytes);
+    json_decref(value);
+    value = json_string("512MB");
+    ASSERT_EQ(1, ParseByteSize(value, &bytes));
+    ASSERT_EQ(536870912, bytes);
+    json_decref(value);
+    value = json_string("512B");
+    ASSERT_EQ(1, ParseByteSize(value, &bytes));
+    ASSERT_EQ(512, bytes);
+    json_decref(value);
+}
+
+TEST(ConfigTest, parse_byte_size_invalid) {
+    size_t bytes = 0;
+    json_t *value = json_string("lots");
+    ASSERT_EQ(0, ParseByteSize(value, &bytes));
+    json_decref(value);
+    value = json_string("12Q");
+    ASSERT_EQ(0, ParseByteSize(value, &bytes));
+    json_decref(value);
+}
+
+TEST(ConfigTest, config_text_skips_path_checks_on_request) {
+    const char *text =
+        "{\"start_year\": 2011, \"output_dir\": \"/nonexistent/output\","
+        " \"mapping\": [{\"file\": \"pr.nc\", \"netcdfVar\": \"pr\","
+        " \"dssatVar\": \"RAIN\"}]}";
+    ASSERT_EQ(nullptr, LoadConfigText(text, 1));
+    Config *config = LoadConfigText(text, 0);
+    ASSERT_NE(nullptr, config);
+    ASSERT_STREQ("/nonexistent/output/", config->output_dir);
+    ASSERT_EQ(1, config->num_mappings);
+    FreeConfig(config);
+}
+
+TEST(ConfigTest, file_list_continues_the_time_axis) {
+    const char *text =
+        "{\"start_year\": 1981, \"output_dir\": \"/tmp\","
+        " \"mapping\": [{\"file\": [\"pr_1981.nc\", \"pr_1991.nc\","
+        " \"pr_2001.nc\"], \"netcdfVar\": \"pr\", \"dssatVar\": \"RAIN\"}]}";
+    Config *config = LoadConfigText(text, 0);
+    ASSERT_NE(nullptr, config);
+    ASSERT_STREQ("pr_1981.nc", config->mappings[0].file_name);
+    ASSERT_EQ(2, config->mappings[0].num_parts);
+    ASSERT_STREQ("pr_1991.nc", config->mappings[0].parts[0]);
+    ASSERT_STREQ("pr_2001.nc", config->mappings[0].parts[1]);
+    FreeConfig(config);
+}
+
+TEST(ConfigTest, file_glob_is_sorted) {
+    char dir[] = "/tmp/config-test-XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+    std::string base(dir);
+    const char *names[] = {"/tas_2001.nc", "/tas_1981.nc", "/tas_1991.nc"};
+    for (const char *name : names) {
+        FILE *fh = fopen((base + name).c_str(), "w");
+        ASSERT_NE(nullptr, fh);
+        fclose(fh);
+    }
+    std::string text = "{\"start_year\": 1981, \"output_dir\": \"/tmp\","
+                       " \"mapping\": [{\"file\": \"" + base +
+                       "/tas_*.nc\", \"netcdfVar\": \"tas\","
+                       " \"dssatVar\": \"TAVG\"}]}";
+    Config *config = LoadConfigText(text.c_str(), 0);
+    ASSERT_NE(nullptr, config);
+    EXPECT_EQ(base + "/tas_1981.nc", config->mappings[0].file_name);
+    ASSERT_EQ(2, config->mappings[0].num_parts);
+    EXPECT_EQ(base + "/tas_1991.nc", config->mappings[0].parts[0]);
+    EXPECT_EQ(base + "/tas_2001.nc", config->mappings[0].parts[1]);
+    FreeConfig(config);
+    for (const char *name : names) {
+        remove((base + name).c_str());
+    }
+    rmdir(dir);
+
+    EXPECT_EQ(nullptr, LoadConfigText(text.c_str(), 0));
+}
+
+TEST(ConfigTest, members_make_an_ensemble) {
+    const char *text =
+        "{\"start_year\": 1981, \"output_dir\": \"/tmp\","
+        " \"ensemble_statistic\": \"max\","
+        " \"mapping\": [{\"file\": \"tasmax_gfdl.nc\", \"members\":"
+        " [\"tasmax_ipsl.nc\", \"tasmax_mri.nc\"], \"netcdfVar\": \"tasmax\","
+        " \"dssatVar\": \"TMAX\"}]}";
+    Config *config = LoadConfigText(text, 0);
+    ASSERT_NE(nullptr, config);
+    EXPECT_EQ(ensemble_max, config->ensemble_statistic);
+    ASSERT_EQ(2, config->mappings[0].num_members);
+    EXPECT_STREQ("tasmax_ipsl.nc", config->mappings[0].members[0]);
+    EXPECT_STREQ("tasmax_mri.nc", config->mappings[0].members[1]);
+    FreeConfig(config);
+}
+
+TEST(ConfigTest, ensembles_are_checked) {
+    // Statistics other than mean, min and max
+    EXPECT_EQ(nullptr,
+              LoadConfigText("{\"start_year\": 1981, \"output_dir\": \"/tmp\","
+                             " \"ensemble_statistic\": \"median\","
+                             " \"mapping\": [{\"file\": \"pr.nc\","
+                             " \"netcdfVar\": \"pr\","
+                             " \"dssatVar\": \"RAIN\"}]}",
+                             0));
+    // Members of a time axis split over several files
+    EXPECT_EQ(nullptr,
+              LoadConfigText("{\"start_year\": 1981, \"output_dir\": \"/tmp\","
+                             " \"mapping\": [{\"file\": [\"pr_1.nc\","
+                             " \"pr_2.nc\"], \"members\": [\"pr_b.nc\"],"
+                             " \"netcdfVar\": \"pr\","
+                             " \"dssatVar\": \"RAIN\"}]}",
+                             0));
+    // Members which are not paths
+    EXPECT_EQ(nullptr,
+              LoadConfigText("{\"start_year\": 1981, \"output_dir\": \"/tmp\","
+                             " \"mapping\": [{\"file\": \"pr.nc\","
+                             " \"members\": [1], \"netcdfVar\": \"pr\","
+                             " \"dssatVar\": \"RAIN\"}]}",
+                             0));
+    Config *config = LoadConfigText(
+        "{\"start_year\": 1981, \"output_dir\": \"/tmp\", \"mapping\":"
+        " [{\"file\": \"pr.nc\", \"netcdfVar\": \"pr\", \"dssatVar\":"
+        " \"RAIN\"}]}",
+        0);
+    ASSERT_NE(nullptr, config);
+    EXPECT_EQ(ensemble_mean, config->ensemble_statistic);
+    EXPECT_EQ(0, config->mappings[0].num_members);
+    FreeConfig(config);
+}
+
+TEST(ConfigTest, derived_mapping_reads_no_file) {
+    const char *derived =
+        "{\"start_year\": 1981, \"output_dir\": \"/tmp\", \"mapping\": ["
+        "{\"file\": \"tasmin.nc\", \"netcdfVar\": \"tasmin\","
+        " \"dssatVar\": \"TMIN\"},"
+        " {\"dssatVar\": \"TDEW\", \"expression\": \"TMIN - 2\"}]}";
+    Config *config = LoadConfigText(derived, 0);
+    ASSERT_NE(nullptr, config);
+    EXPECT_NE(nullptr, config->mappings[1].derived);
+    EXPECT_EQ(nullptr, config->mappings[1].file_name);
+    FreeConfig(config);
+
+    const char *both =
+        "{\"start_year\": 1981, \"output_dir\": \"/tmp\", \"mapping\": ["
+        "{\"file\": \"tasmin.nc\", \"netcdfVar\": \"tasmin\","
+        " \"dssatVar\": \"TMIN\"},"
+        " {\"file\": \"tdew.nc\", \"dssatVar\": \"TDEW\","
+        " \"expression\": \"TMIN - 2\"}]}";
+    EXPECT_EQ(nullptr, LoadConfigText(both, 0));
+}
@@ -0,0 +1,108 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "expression.h"
+}
+
+static const char *kNames[] = {"TMIN", "TMAX", "RHUM"};
+
+static float evaluateSingle(const char *source, float tmin, float tmax,
+                            float rhum) {
+  float tmin_v[] = {tmin};
+  float tmax_v[] = {tmax};
+  float rhum_v[] = {rhum};
+  const float *inputs[] = {tmin_v, tmax_v, rhum_v};
+  const float fills[] = {1.0e20f, 1.0e20f, 1.0e20f};
+  float result = 0.0f;
+  Expression *expression = CompileExpression(source, kNames, 3);
+  EXPECT_NE(nullptr, expression);
+  if (expression == NULL) {
+    return 0.0f;
+  }
+  EXPECT_EQ(0, EvaluateExpression(expression, inputs, fills, 1, 1.0e20f,
+                                  &result));
+  FreeExpression(expression);
+  return result;
+}
+
+TEST(ExpressionTest, average_of_two_variables) {
+  EXPECT_FLOAT_EQ(15.0f, evaluateSingle("(TMAX + TMIN) / 2", 10.0f, 20.0f, 0));
+}
+
+TEST(ExpressionTest, operator_precedence) {
+  EXPECT_FLOAT_EQ(14.0f, evaluateSingle("2 + 3 * 4", 0, 0, 0));
+  EXPECT_FLOAT_EQ(-9.0f, evaluateSingle("-3^2", 0, 0, 0));
+  EXPECT_FLOAT_EQ(512.0f, evaluateSingle("2^3^2", 0, 0, 0));
+  EXPECT_FLOAT_EQ(1.0f, evaluateSingle("10 - 6 - 3", 0, 0, 0));
+  EXPECT_FLOAT_EQ(0.5f, evaluateSingle("2 ^ -1", 0, 0, 0));
+}
+
+TEST(ExpressionTest, functions) {
+  EXPECT_FLOAT_EQ(3.0f, evaluateSingle("sqrt(9)", 0, 0, 0));
+  EXPECT_FLOAT_EQ(1.0f, evaluateSingle("log(exp(1))", 0, 0, 0));
+  EXPECT_FLOAT_EQ(10.0f, evaluateSingle("min(TMIN, TMAX)", 10.0f, 20.0f, 0));
+  EXPECT_FLOAT_EQ(20.0f, evaluateSingle("max(TMIN, TMAX)", 10.0f, 20.0f, 0));
+}
+
+TEST(ExpressionTest, dew_point_from_humidity) {
+  const char *dewp = "243.04 * (log(RHUM / 100) + 17.625 * TMAX / (243.04 + "
+                     "TMAX)) / (17.625 - log(RHUM / 100) - 17.625 * TMAX / "
+                     "(243.04 + TMAX))";
+  EXPECT_NEAR(13.9f, evaluateSingle(dewp, 0, 20.0f, 68.0f), 0.05f);
+}
+
+TEST(ExpressionTest, tracks_inputs_and_depth) {
+  Expression *expression =
+      CompileExpression("TMAX * TMAX + (TMIN - 1) * 2", kNames, 3);
+  ASSERT_NE(nullptr, expression);
+  EXPECT_EQ(2, expression->num_inputs);
+  EXPECT_EQ(1, expression->inputs[0]);
+  EXPECT_EQ(0, expression->inputs[1]);
+  EXPECT_EQ(3, expression->max_depth);
+  FreeExpression(expression);
+}
+
+TEST(ExpressionTest, missing_inputs_propagate) {
+  const size_t length = 1500;
+  float *tmin = new float[length];
+  float *tmax = new float[length];
+  float *result = new float[length];
+  for (size_t i = 0; i < length; ++i) {
+    tmin[i] = (float)i;
+    tmax[i] = (i % 7 == 0) ? -99.0f : (float)i + 2.0f;
+  }
+  const float *inputs[] = {tmin, tmax, NULL};
+  const float fills[] = {1.0e20f, -99.0f, 1.0e20f};
+  Expression *expression = CompileExpression("(TMAX + TMIN) / 2", kNames, 3);
+  ASSERT_NE(nullptr, expression);
+  ASSERT_EQ(0, EvaluateExpression(expression, inputs, fills, length, 1.0e20f,
+                                  result));
+  for (size_t i = 0; i < length; ++i) {
+    if (i % 7 == 0) {
+      EXPECT_EQ(1.0e20f, result[i]);
+    } else {
+      EXPECT_FLOAT_EQ((float)i + 1.0f, result[i]);
+    }
+  }
+  FreeExpression(expression);
+  delete[] result;
+  delete[] tmax;
+  delete[] tmin;
+}
+
+TEST(ExpressionTest, non_finite_results_are_missing) {
+  EXPECT_EQ(1.0e20f, evaluateSingle("TMAX / TMIN", 0.0f, 20.0f, 0));
+  EXPECT_EQ(1.0e20f, evaluateSingle("log(TMIN)", 0.0f, 0, 0));
+  EXPECT_EQ(1.0e20f, evaluateSingle("sqrt(TMIN)", -1.0f, 0, 0));
+  EXPECT_EQ(1.0e20f, evaluateSingle("TMIN ^ 0.5", -4.0f, 0, 0));
+  EXPECT_FLOAT_EQ(2.0f, evaluateSingle("TMIN ^ 0.5", 4.0f, 0, 0));
+}
+
+TEST(ExpressionTest, rejects_invalid_expressions) {
+  EXPECT_EQ(nullptr, CompileExpression("TAVG + 1", kNames, 3));
+  EXPECT_EQ(nullptr, CompileExpression("(TMIN + 1", kNames, 3));
+  EXPECT_EQ(nullptr, CompileExpression("TMIN +", kNames, 3));
+  EXPECT_EQ(nullptr, CompileExpression("cos(TMIN)", kNames, 3));
+  EXPECT_EQ(nullptr, CompileExpression("TMIN TMAX", kNames, 3));
+  EXPECT_EQ(nullptr, CompileExpression("", kNames, 3));
+}
@@ -49,3 +49,63 @@ TEST(HyperslabTest, check_allocation_math) {
   hs = AllocateHyperslabs(pos, stride, 4, 1);
   free(hs);
 }
+
+TEST(HyperslabTest, check_footprint) {
+  EXPECT_EQ(2 * 4 * 1461 * 20 * 10 * sizeof(float),
+            HyperslabFootprint(Edges(1461, 20, 10), 4));
+}
+
+TEST(HyperslabTest, subdivide_within_budget_is_single_tile) {
+  size_t num_tiles = 0;
+  Hyperslab hs = CreateHyperslab(Position(0, 10, 20), Edges(365, 30, 40));
+  Hyperslab *tiles = SubdivideHyperslab(
+      hs, 4, HyperslabFootprint(hs.edges, 4), &num_tiles);
+  ASSERT_NE(nullptr, tiles);
+  EXPECT_EQ(1, num_tiles);
+  EXPECT_EQ(hs.flat_size, tiles[0].flat_size);
+  EXPECT_EQ(10, tiles[0].corner.x);
+  EXPECT_EQ(20, tiles[0].corner.y);
+  free(tiles);
+}
+
+TEST(HyperslabTest, subdivide_into_row_bands) {
+  size_t num_tiles = 0;
+  Hyperslab hs = CreateHyperslab(Position(0, 10, 20), Edges(365, 30, 40));
+  // Room for 3 full rows of 30 cells
+  size_t budget = HyperslabFootprint(Edges(365, 30, 3), 4) + 1;
+  Hyperslab *tiles = SubdivideHyperslab(hs, 4, budget, &num_tiles);
+  ASSERT_NE(nullptr, tiles);
+  EXPECT_EQ(14, num_tiles);
+  size_t cells = 0;
+  for (size_t i = 0; i < num_tiles; ++i) {
+    EXPECT_EQ(30, tiles[i].edges.x_length);
+    EXPECT_EQ(10, tiles[i].corner.x);
+    EXPECT_EQ(20 + (i * 3), tiles[i].corner.y);
+    EXPECT_LE(HyperslabFootprint(tiles[i].edges, 4), budget);
+    cells += tiles[i].edges.x_length * tiles[i].edges.y_length;
+  }
+  EXPECT_EQ(1, tiles[num_tiles - 1].edges.y_length);
+  EXPECT_EQ(30 * 40, cells);
+  free(tiles);
+}
+
+TEST(HyperslabTest, subdivide_rows_when_a_row_does_not_fit) {
+  size_t num_tiles = 0;
+  Hyperslab hs = CreateHyperslab(Position(0, 0, 0), Edges(365, 30, 2));
+  size_t budget = HyperslabFootprint(Edges(365, 7, 1), 4);
+  Hyperslab *tiles = SubdivideHyperslab(hs, 4, budget, &num_tiles);
+  ASSERT_NE(nullptr, tiles);
+  EXPECT_EQ(10, num_tiles);
+  EXPECT_EQ(7, tiles[0].edges.x_length);
+  EXPECT_EQ(2, tiles[4].edges.x_length);
+  EXPECT_EQ(28, tiles[4].corner.x);
+  EXPECT_EQ(1, tiles[5].corner.y);
+  free(tiles);
+}
+
+TEST(HyperslabTest, subdivide_rejects_budget_below_one_cell) {
+  size_t num_tiles = 5;
+  Hyperslab hs = CreateHyperslab(Position(0, 0, 0), Edges(365, 30, 2));
+  EXPECT_EQ(nullptr, SubdivideHyperslab(hs, 4, 16, &num_tiles));
+  EXPECT_EQ(0, num_tiles);
+}
@@ -0,0 +1,64 @@
+#include <string.h>
+
+#include <mpi.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "io.h"
+}
+
+class EnsembleTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    memset(&info_, 0, sizeof(NetCdfInfo));
+    info_.fill_value = kFill;
+    info_.num_members = 2;
+  }
+
+  // Folds three models the way an ensemble read does, the first file
+  // standing in the destination
+  void Reduce(int statistic) {
+    info_.ensemble_statistic = statistic;
+    memcpy(dest_, first_, sizeof(dest_));
+    ReduceEnsembleValues(statistic, kFill, second_, dest_, kLength);
+    ReduceEnsembleValues(statistic, kFill, third_, dest_, kLength);
+    FinishEnsembleValues(&info_, dest_, kLength);
+  }
+
+  static constexpr float kFill = 1.0e20f;
+  static constexpr size_t kLength = 4;
+  const float first_[kLength] = {3.0f, -6.0f, 1.0f, kFill};
+  const float second_[kLength] = {6.0f, 0.0f, kFill, 2.0f};
+  const float third_[kLength] = {0.0f, 3.0f, 4.0f, 5.0f};
+  float dest_[kLength];
+  NetCdfInfo info_;
+};
+
+constexpr float EnsembleTest::kFill;
+constexpr size_t EnsembleTest::kLength;
+
+TEST_F(EnsembleTest, mean_counts_the_first_file) {
+  Reduce(ensemble_mean);
+  EXPECT_FLOAT_EQ(3.0f, dest_[0]);
+  EXPECT_FLOAT_EQ(-1.0f, dest_[1]);
+}
+
+TEST_F(EnsembleTest, min_and_max) {
+  Reduce(ensemble_min);
+  EXPECT_FLOAT_EQ(0.0f, dest_[0]);
+  EXPECT_FLOAT_EQ(-6.0f, dest_[1]);
+  Reduce(ensemble_max);
+  EXPECT_FLOAT_EQ(6.0f, dest_[0]);
+  EXPECT_FLOAT_EQ(3.0f, dest_[1]);
+}
+
+TEST_F(EnsembleTest, missing_in_any_model_is_missing) {
+  const int statistics[3] = {ensemble_mean, ensemble_min, ensemble_max};
+  for (int statistic : statistics) {
+    Reduce(statistic);
+    // Missing from a member, then from the first file
+    EXPECT_EQ(kFill, dest_[2]);
+    EXPECT_EQ(kFill, dest_[3]);
+  }
+}
@@ -0,0 +1,149 @@
+#include <string.h>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "kernels.h"
+}
+
+static const float kFill = 1.0e20f;
+
+static Config MakeConfig(FileConfig *mappings, size_t num_mappings) {
+  Config config;
+  memset(&config, 0, sizeof(config));
+  memset(mappings, 0, sizeof(FileConfig) * num_mappings);
+  config.mappings = mappings;
+  config.num_mappings = num_mappings;
+  return config;
+}
+
+// SRAD, TMIN, TMAX and RAIN with the conversions of the usual inputs.
+static void MakeConverters(ConverterContainer *converters) {
+  memset(converters, 0, sizeof(ConverterContainer) * 4);
+  SetAffineConverter(&converters[0], 0.0864, 0.0);
+  SetAffineConverter(&converters[1], 1.0, -273.15);
+  SetAffineConverter(&converters[2], 1.0, -273.15);
+  SetAffineConverter(&converters[3], 86400.0, 0.0);
+}
+
+TEST(KernelsTest, usual_set_converts_like_the_converters) {
+  FileConfig mappings[4];
+  Config config = MakeConfig(mappings, 4);
+  ConverterContainer converters[4];
+  MakeConverters(converters);
+  float fills[4] = {kFill, kFill, kFill, kFill};
+  CellKernels kernels;
+  SelectCellKernels(&config, converters, fills, &kernels);
+  ASSERT_NE(nullptr, kernels.convert);
+  EXPECT_STREQ("srad_tmin_tmax_rain", kernels.convert_name);
+
+  const size_t count = 7;
+  float raw[4][count] = {{0.0f, -0.0f, 250.5f, kFill, 1.0e-3f, 800.0f, 3.3f},
+                         {273.15f, 250.0f, kFill, 300.1f, 0.0f, 1.0f, 2.0f},
+                         {kFill, 280.0f, 290.5f, 310.2f, 0.5f, 1.0f, 2.0f},
+                         {0.0f, -0.0f, 1.2e-5f, 3.0e-4f, kFill, 1.0f, 2.0f}};
+  float expected[4][count];
+  float actual[4][count];
+  const float *raw_ptrs[4];
+  float *actual_ptrs[4];
+  for (size_t m = 0; m < 4; ++m) {
+    ConvertValues(&converters[m], kFill, raw[m], expected[m], count);
+    raw_ptrs[m] = raw[m];
+    actual_ptrs[m] = actual[m];
+  }
+  kernels.convert(&kernels, raw_ptrs, actual_ptrs, count);
+  EXPECT_EQ(0, memcmp(expected, actual, sizeof(expected)));
+}
+
+TEST(KernelsTest, gather_kernels_match_the_generic_one) {
+  const size_t days = 3;
+  const size_t plane = 6;
+  float fills[5] = {kFill, kFill, kFill, kFill, -99.0f};
+  std::vector<float> tile(5 * days * plane);
+  for (size_t i = 0; i < tile.size(); ++i) {
+    tile[i] = (float)i;
+  }
+  tile[4 * days * plane + 2] = -99.0f;
+  const float *converted[5];
+  for (size_t m = 0; m < 5; ++m) {
+    converted[m] = &tile[m * days * plane];
+  }
+  for (size_t num_mappings = 4; num_mappings <= 5; ++num_mappings) {
+    FileConfig mappings[5];
+    Config config = MakeConfig(mappings, num_mappings);
+    config.quantize = 1;
+    CellKernels kernels;
+    SelectCellKernels(&config, NULL, fills, &kernels);
+    EXPECT_EQ(nullptr, kernels.convert);
+    ASSERT_NE(GatherGeneric, kernels.gather);
+    for (size_t index = 0; index < plane; ++index) {
+      std::vector<float> expected(num_mappings * days);
+      std::vector<float> actual(num_mappings * days);
+      int missing = GatherGeneric(&kernels, converted, plane, index, days,
+                                  expected.data());
+      ASSERT_EQ(missing, kernels.gather(&kernels, converted, plane, index,
+                                        days, actual.data()));
+      EXPECT_EQ(num_mappings == 5 && index == 2, missing);
+      if (!missing) {
+        EXPECT_EQ(expected, actual);
+      }
+    }
+  }
+}
+
+TEST(KernelsTest, other_sets_stay_generic) {
+  FileConfig mappings[4];
+  Config config = MakeConfig(mappings, 4);
+  ConverterContainer converters[4];
+  MakeConverters(converters);
+  float fills[4] = {kFill, kFill, kFill, kFill};
+  CellKernels kernels;
+  // Unconverted values are copied, which no affine kernel does for -0.0
+  memset(&converters[1], 0, sizeof(ConverterContainer));
+  SelectCellKernels(&config, converters, fills, &kernels);
+  EXPECT_EQ(nullptr, kernels.convert);
+
+  MakeConverters(converters);
+  SetAffineConverter(&converters[1], 1.8, -459.67);
+  SelectCellKernels(&config, converters, fills, &kernels);
+  EXPECT_STREQ("affine4", kernels.convert_name);
+
+  config.cache_dir = (char *)"/tmp";
+  SelectCellKernels(&config, converters, fills, &kernels);
+  EXPECT_EQ(nullptr, kernels.convert);
+  EXPECT_STREQ("4 mappings", kernels.gather_name);
+}
+
+TEST(KernelsTest, packed_values_convert_in_one_step) {
+  FileConfig mappings[4];
+  Config config = MakeConfig(mappings, 4);
+  ConverterContainer converters[4];
+  MakeConverters(converters);
+  // Temperatures in hundredths of a Kelvin around 273.15, rain unconverted
+  PackConverter(&converters[1], 0.01, 273.15);
+  PackConverter(&converters[2], 0.01, 273.15);
+  memset(&converters[3], 0, sizeof(ConverterContainer));
+  PackConverter(&converters[3], 1.0e-6, 0.0);
+  const float kPackedFill = -32767.0f;
+  float fills[4] = {kFill, kPackedFill, kPackedFill, kPackedFill};
+  CellKernels kernels;
+  SelectCellKernels(&config, converters, fills, &kernels);
+  ASSERT_NE(nullptr, kernels.convert);
+  EXPECT_STREQ("affine4", kernels.convert_name);
+
+  const float tmin[4] = {-2315.0f, 0.0f, kPackedFill, 3125.0f};
+  const float rain[4] = {0.0f, 1500.0f, 32000.0f, kPackedFill};
+  float converted[4];
+  ConvertValues(&converters[1], kPackedFill, tmin, converted, 4);
+  EXPECT_NEAR(-23.15f, converted[0], 1.0e-4f);
+  EXPECT_NEAR(0.0f, converted[1], 1.0e-4f);
+  EXPECT_EQ(kPackedFill, converted[2]);
+  EXPECT_NEAR(31.25f, converted[3], 1.0e-4f);
+  ConvertValues(&converters[3], kPackedFill, rain, converted, 4);
+  EXPECT_FLOAT_EQ(0.0f, converted[0]);
+  EXPECT_FLOAT_EQ(1.5e-3f, converted[1]);
+  EXPECT_FLOAT_EQ(0.032f, converted[2]);
+  EXPECT_EQ(kPackedFill, converted[3]);
+}
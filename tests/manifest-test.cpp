@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <mpi.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "manifest.h"
+}
+
+static ManifestRow Row(uint64_t global_id, const char *path) {
+  ManifestRow row = {global_id, -99.75, -10.25, 1200, 365, 0xdeadbeef,
+                     path == NULL, (char *)path};
+  return row;
+}
+
+TEST(ManifestTest, csv_row_lists_every_field) {
+  ManifestRow row = Row(144162, "out/144162.WTH");
+  char text[128];
+  size_t size = FormatManifestRow(&row, manifest_csv, text, sizeof(text));
+  EXPECT_STREQ("144162,-99.75,-10.25,out/144162.WTH,1200,365,0,deadbeef\n",
+               text);
+  EXPECT_EQ(strlen(text), size);
+}
+
+TEST(ManifestTest, binary_row_has_fixed_fields_and_path) {
+  ManifestRow row = Row(7, "a.WTH");
+  EXPECT_EQ(MANIFEST_ROW_SIZE + 5, FormatManifestRow(&row, manifest_binary,
+                                                     NULL, 0));
+  char data[MANIFEST_ROW_SIZE + 5];
+  ASSERT_EQ(sizeof(data),
+            FormatManifestRow(&row, manifest_binary, data, sizeof(data)));
+  uint64_t global_id;
+  uint16_t path_len;
+  memcpy(&global_id, data, 8);
+  memcpy(&path_len, data + 42, 2);
+  EXPECT_EQ(7, global_id);
+  EXPECT_EQ(5, path_len);
+  EXPECT_EQ(0, memcmp("a.WTH", data + MANIFEST_ROW_SIZE, 5));
+}
+
+TEST(ManifestTest, written_manifest_is_in_global_id_order) {
+  int initialized;
+  MPI_Initialized(&initialized);
+  if (!initialized) {
+    MPI_Init(NULL, NULL);
+  }
+  const char *file_name = "manifest-test.csv";
+  Manifest manifest;
+  InitManifest(&manifest, manifest_csv);
+  ManifestRow rows[] = {Row(3, "3.WTH"), Row(1, "1.WTH"), Row(2, NULL)};
+  for (size_t i = 0; i < 3; ++i) {
+    ASSERT_EQ(0, AddManifestRow(&manifest, &rows[i]));
+  }
+  ASSERT_EQ(0, WriteManifest(&manifest, file_name, MPI_COMM_SELF));
+  FreeManifest(&manifest);
+  EXPECT_EQ(0, manifest.num_rows);
+
+  FILE *fh = fopen(file_name, "r");
+  ASSERT_NE(nullptr, fh);
+  char line[128];
+  std::string ids;
+  while (fgets(line, sizeof(line), fh) != NULL) {
+    ids += std::string(line, strcspn(line, ",")) + " ";
+  }
+  fclose(fh);
+  unlink(file_name);
+  EXPECT_EQ("global_id 1 2 3 ", ids);
+  MPI_Finalize();
+}
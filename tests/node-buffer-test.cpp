@@ -0,0 +1,31 @@
+#include <mpi.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "node_buffer.h"
+}
+
+TEST(NodeBufferTest, shares_cover_the_range_in_order) {
+  size_t next = 0;
+  for (int rank = 0; rank < 4; ++rank) {
+    size_t first;
+    size_t count;
+    NodeShare(10, rank, 4, &first, &count);
+    EXPECT_EQ(next, first);
+    EXPECT_EQ(rank < 2 ? 3u : 2u, count);
+    next = first + count;
+  }
+  EXPECT_EQ(10u, next);
+}
+
+TEST(NodeBufferTest, ranks_beyond_the_range_get_nothing) {
+  size_t first;
+  size_t count;
+  NodeShare(2, 3, 4, &first, &count);
+  EXPECT_EQ(2u, first);
+  EXPECT_EQ(0u, count);
+  NodeShare(7, 0, 1, &first, &count);
+  EXPECT_EQ(0u, first);
+  EXPECT_EQ(7u, count);
+}
@@ -0,0 +1,95 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+#include <zlib.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "output_writer.h"
+}
+
+static std::string ReadGzip(const char *file_name) {
+  std::string text;
+  gzFile file = gzopen(file_name, "rb");
+  if (file == NULL) {
+    return text;
+  }
+  char buffer[4096];
+  int read;
+  while ((read = gzread(file, buffer, sizeof(buffer))) > 0) {
+    text.append(buffer, read);
+  }
+  gzclose(file);
+  return text;
+}
+
+static char *CopyText(const std::string &text) {
+  char *copy = (char *)malloc(text.size());
+  memcpy(copy, text.data(), text.size());
+  return copy;
+}
+
+TEST(OutputWriterTest, gzip_buffer_round_trips) {
+  std::string text;
+  for (int d = 0; d < 365; ++d) {
+    text += "11001  15.2  10.1  20.3   0.0\n";
+  }
+  unsigned char *compressed;
+  size_t compressed_size;
+  ASSERT_EQ(0, GzipBuffer(text.data(), text.size(), 6, &compressed,
+                          &compressed_size));
+  ASSERT_LT(compressed_size, text.size());
+  std::vector<char> inflated(text.size());
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  ASSERT_EQ(Z_OK, inflateInit2(&stream, 15 + 16));
+  stream.next_in = compressed;
+  stream.avail_in = compressed_size;
+  stream.next_out = (unsigned char *)inflated.data();
+  stream.avail_out = inflated.size();
+  EXPECT_EQ(Z_STREAM_END, inflate(&stream, Z_FINISH));
+  EXPECT_EQ(text.size(), stream.total_out);
+  inflateEnd(&stream);
+  EXPECT_EQ(text, std::string(inflated.data(), inflated.size()));
+  free(compressed);
+}
+
+TEST(OutputWriterTest, threaded_writer_writes_every_file) {
+  OutputWriter *writer = OpenOutputWriter(1, 3, NULL);
+  ASSERT_NE(nullptr, writer);
+  for (int i = 0; i < 20; ++i) {
+    char file_name[64];
+    snprintf(file_name, sizeof(file_name), "output-writer-%d.WTH.gz", i);
+    std::string text = "*WEATHER DATA: " + std::to_string(i) + "\n";
+    ASSERT_EQ(0, SubmitOutput(writer, file_name, CopyText(text), text.size()));
+  }
+  OutputStats stats;
+  CloseOutputWriter(writer, &stats);
+  EXPECT_EQ(20, stats.files);
+  EXPECT_EQ(0, stats.failures);
+  for (int i = 0; i < 20; ++i) {
+    char file_name[64];
+    snprintf(file_name, sizeof(file_name), "output-writer-%d.WTH.gz", i);
+    EXPECT_EQ("*WEATHER DATA: " + std::to_string(i) + "\n",
+              ReadGzip(file_name));
+    remove(file_name);
+  }
+}
+
+TEST(OutputWriterTest, unwritable_file_is_counted) {
+  OutputWriter *writer = OpenOutputWriter(6, 0, NULL);
+  ASSERT_NE(nullptr, writer);
+  std::string text = "text";
+  EXPECT_EQ(1, SubmitOutput(writer, "/nonexistent/dir/1.WTH.gz",
+                            CopyText(text), text.size()));
+  OutputStats stats;
+  CloseOutputWriter(writer, &stats);
+  EXPECT_EQ(1, stats.files);
+  EXPECT_EQ(1, stats.failures);
+  EXPECT_EQ(0, stats.written_bytes);
+}
@@ -0,0 +1,73 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "perf.h"
+}
+
+TEST(PerfTest, disabled_counters_report_only_time) {
+  PerfCounters counters;
+  PhaseSample sample;
+  InitPerfCounters(&counters, 0);
+  EXPECT_EQ(0, counters.num_available);
+  BeginPhase(&counters, &sample, "test");
+  EndPhase(&counters, &sample);
+  EXPECT_STREQ("test", sample.name);
+  EXPECT_GE(sample.seconds, 0.0);
+  for (size_t i = 0; i < kPerfNumCounters; ++i) {
+    EXPECT_EQ(-1, counters.fds[i]);
+    EXPECT_EQ(0, sample.valid[i]);
+  }
+  FreePerfCounters(&counters);
+}
+
+TEST(PerfTest, enabled_counters_degrade_gracefully) {
+  PerfCounters counters;
+  PhaseSample sample;
+  InitPerfCounters(&counters, 1);
+  BeginPhase(&counters, &sample, "busy");
+  volatile double sink = 0.0;
+  for (int i = 0; i < 100000; ++i) {
+    sink += i * 0.5;
+  }
+  EndPhase(&counters, &sample);
+  for (size_t i = 0; i < kPerfNumCounters; ++i) {
+    if (counters.fds[i] == -1) {
+      EXPECT_EQ(0, sample.valid[i]);
+    }
+  }
+  PrintPhaseSample(0, &sample);
+  FreePerfCounters(&counters);
+  EXPECT_EQ(0, counters.num_available);
+}
+
+TEST(PerfTest, lines_report_each_unavailable_counter) {
+  PhaseSample sample;
+  BeginPhase(NULL, &sample, "read");
+  EndPhase(NULL, &sample);
+  sample.seconds = 1.5;
+  char line[512];
+  // Without counters only the time is reported
+  FormatPhaseSample(2, &sample, line, sizeof(line));
+  EXPECT_STREQ("[2] Phase read            1.500 s", line);
+  sample.requested = 1;
+  sample.counts[kPerfCycles] = 200;
+  sample.valid[kPerfCycles] = 1;
+  sample.counts[kPerfLlcMisses] = 7;
+  sample.valid[kPerfLlcMisses] = 1;
+  FormatPhaseSample(2, &sample, line, sizeof(line));
+  EXPECT_STREQ("[2] Phase read            1.500 s cycles=200 "
+               "instructions=n/a llc_misses=7 branch_misses=n/a",
+               line);
+  sample.counts[kPerfInstructions] = 300;
+  sample.valid[kPerfInstructions] = 1;
+  FormatPhaseSample(2, &sample, line, sizeof(line));
+  EXPECT_STREQ("[2] Phase read            1.500 s cycles=200 "
+               "instructions=300 llc_misses=7 branch_misses=n/a ipc=1.50",
+               line);
+}
+
+TEST(PerfTest, wall_time_is_monotonic) {
+  double first = PerfWallTime();
+  double second = PerfWallTime();
+  EXPECT_LE(first, second);
+}
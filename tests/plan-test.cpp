@@ -0,0 +1,112 @@
+#include <string.h>
+
+#include <vector>
+
+#include <mpi.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "plan.h"
+}
+
+// Chunks of one day over the whole 360x720 grid, like the GGCMI inputs.
+static PlanInput DailyMaps() {
+  PlanInput input;
+  input.chunked = 1;
+  input.chunk_days = 1;
+  input.chunk_y = 360;
+  input.chunk_x = 720;
+  input.chunk_bytes = 4096.0;
+  return input;
+}
+
+TEST(PlanTest, daily_maps_are_touched_once_per_day) {
+  PlanInput input = DailyMaps();
+  Hyperslab slab = CreateHyperslab(Position(0, 10, 20), Edges(365, 5, 3));
+  EXPECT_EQ(365u, ChunksTouched(&input, slab));
+  EXPECT_DOUBLE_EQ(365 * 4096.0, PlannedReadBytes(&input, slab));
+}
+
+TEST(PlanTest, slabs_across_chunk_borders_touch_both_sides) {
+  PlanInput input = DailyMaps();
+  input.chunk_days = 100;
+  input.chunk_y = 10;
+  input.chunk_x = 10;
+  Hyperslab slab = CreateHyperslab(Position(50, 5, 9), Edges(100, 10, 2));
+  EXPECT_EQ(2u * 2u * 2u, ChunksTouched(&input, slab));
+  input.chunked = 0;
+  EXPECT_EQ(0u, ChunksTouched(&input, slab));
+  EXPECT_DOUBLE_EQ(100.0 * 10 * 2 * sizeof(float),
+                   PlannedReadBytes(&input, slab));
+}
+
+TEST(PlanTest, land_cells_follow_the_mask) {
+  std::vector<unsigned char> mask(4 * 3, 0);
+  mask[1 * 4 + 1] = 1;
+  mask[1 * 4 + 2] = 1;
+  mask[2 * 4 + 3] = 1;
+  Hyperslab slab = CreateHyperslab(Position(0, 1, 1), Edges(1, 2, 2));
+  EXPECT_EQ(2u, CountLandCells(mask.data(), 4, slab));
+  EXPECT_EQ(4u, CountLandCells(NULL, 4, slab));
+}
+
+TEST(PlanTest, subdivided_tiles_touch_the_chunks_again) {
+  FileConfig mappings[2];
+  memset(mappings, 0, sizeof(mappings));
+  Config config;
+  memset(&config, 0, sizeof(config));
+  config.mappings = mappings;
+  config.num_mappings = 2;
+  PlanInput inputs[2] = {DailyMaps(), DailyMaps()};
+  Hyperslab slab = CreateHyperslab(Position(0, 0, 0), Edges(10, 4, 4));
+  size_t value_bytes = TileValueBytes(&config, 1);
+  EXPECT_EQ(2 * 2 * sizeof(float), value_bytes);
+  RankPlan plan;
+  ASSERT_EQ(0, PlanRank(&config, inputs, NULL, 4, slab, value_bytes, 1000,
+                        &plan));
+  EXPECT_EQ(1u, plan.tiles);
+  EXPECT_EQ(2u * 10u, plan.chunks);
+  EXPECT_EQ(1000u + 160u * value_bytes, plan.peak_bytes);
+  // Room for two rows of cells splits the slab in two
+  config.max_memory_per_rank = 1000 + 8 * 10 * value_bytes;
+  ASSERT_EQ(0, PlanRank(&config, inputs, NULL, 4, slab, value_bytes, 1000,
+                        &plan));
+  EXPECT_EQ(2u, plan.tiles);
+  EXPECT_EQ(2u * 2u * 10u, plan.chunks);
+  EXPECT_EQ(1000u + 80u * value_bytes, plan.peak_bytes);
+}
+
+TEST(PlanTest, subdivision_budget_is_scaled_to_float_buffers) {
+  FileConfig mappings[2];
+  memset(mappings, 0, sizeof(mappings));
+  Config config;
+  memset(&config, 0, sizeof(config));
+  config.mappings = mappings;
+  config.num_mappings = 2;
+  // Float tiles take the two buffers per mapping already
+  EXPECT_EQ(1600u, SubdivisionBudget(&config, 2600, 1000,
+                                     TileValueBytes(&config, 1)));
+  // Quantized tiles take half of that, so twice the values fit
+  config.quantize = 1;
+  EXPECT_EQ(2 * sizeof(int16_t) + sizeof(float), TileValueBytes(&config, 1));
+  EXPECT_EQ(3200u, SubdivisionBudget(&config, 2600, 1000,
+                                     TileValueBytes(&config, 1)));
+}
+
+TEST(PlanTest, advice_fits_the_node_memory) {
+  Hyperslab extent = CreateHyperslab(Position(0, 0, 0), Edges(100, 8, 8));
+  PlanAdvice advice;
+  // Four ranks with whole slabs of 16 cells, 6400 bytes each next to 1000
+  // bytes of their own; eight would need 33600 bytes
+  ASSERT_EQ(0, AdviseRanks(extent, 4, 1000, 30000, 8, &advice));
+  EXPECT_EQ(4u, advice.ranks_per_node);
+  EXPECT_EQ(2u, advice.threads_per_rank);
+  EXPECT_EQ(0, advice.subdivided);
+  // Too little for one whole extent, every core subdivides its slab
+  ASSERT_EQ(0, AdviseRanks(extent, 4, 100, 8 * 1000, 8, &advice));
+  EXPECT_EQ(8u, advice.ranks_per_node);
+  EXPECT_EQ(1, advice.subdivided);
+  EXPECT_EQ(1000u, advice.max_memory_per_rank);
+  EXPECT_NE(0, AdviseRanks(extent, 4, 100, 100, 8, &advice));
+}
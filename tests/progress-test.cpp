@@ -0,0 +1,96 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <mpi.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "perf.h"
+#include "progress.h"
+}
+
+class ProgressTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    ASSERT_NE(nullptr, mkdtemp(dir_));
+    path_ = std::string(dir_) + "/";
+    memset(&progress_, 0, sizeof(Progress));
+    progress_.dir = path_.c_str();
+    progress_.scenario = "ssp126";
+    progress_.format = progress_heartbeat;
+    progress_.interval = 10.0;
+    progress_.world_rank = 3;
+    progress_.start = PerfWallTime() - 20.0;
+    progress_.cells_total = 400;
+    progress_.cells_done = 100;
+    progress_.bytes_written = 123456;
+    progress_.phase = "process";
+  }
+
+  void TearDown() override {
+    char file_name[2048];
+    ProgressFileName(&progress_, progress_.world_rank, file_name,
+                     sizeof(file_name));
+    remove(file_name);
+    rmdir(dir_);
+  }
+
+  void ExpectRoundTrip() {
+    char file_name[2048];
+    ASSERT_EQ(0u, ProgressFileName(&progress_, progress_.world_rank,
+                                   file_name, sizeof(file_name)));
+    ASSERT_EQ(0, WriteProgressFile(&progress_));
+    ProgressSample sample;
+    ASSERT_EQ(0, ReadProgressFile(file_name, &sample));
+    EXPECT_EQ(100u, sample.cells_done);
+    EXPECT_EQ(400u, sample.cells_total);
+    EXPECT_EQ(123456u, sample.bytes_written);
+    EXPECT_NEAR(20.0, sample.elapsed_seconds, 1.0);
+    // A quarter done in 20 s leaves three times that
+    EXPECT_NEAR(60.0, sample.eta_seconds, 3.0);
+    EXPECT_GT(sample.updated, 0.0);
+  }
+
+  char dir_[32] = "/tmp/progress-test-XXXXXX";
+  std::string path_;
+  Progress progress_;
+};
+
+TEST_F(ProgressTest, file_names_follow_the_format) {
+  char file_name[2048];
+  ProgressFileName(&progress_, 12, file_name, sizeof(file_name));
+  EXPECT_EQ(path_ + "rank-12.progress", file_name);
+  progress_.format = progress_prometheus;
+  ProgressFileName(&progress_, 12, file_name, sizeof(file_name));
+  EXPECT_EQ(path_ + "ggcmiw_rank_12.prom", file_name);
+  EXPECT_EQ(1u, ProgressFileName(&progress_, 12, file_name, 8));
+}
+
+TEST_F(ProgressTest, heartbeat_reads_back) { ExpectRoundTrip(); }
+
+TEST_F(ProgressTest, prometheus_reads_back) {
+  progress_.format = progress_prometheus;
+  ExpectRoundTrip();
+}
+
+TEST_F(ProgressTest, eta_is_unknown_before_the_first_cell) {
+  progress_.cells_done = 0;
+  char file_name[2048];
+  ProgressFileName(&progress_, progress_.world_rank, file_name,
+                   sizeof(file_name));
+  ASSERT_EQ(0, WriteProgressFile(&progress_));
+  ProgressSample sample;
+  ASSERT_EQ(0, ReadProgressFile(file_name, &sample));
+  EXPECT_EQ(0u, sample.cells_done);
+  EXPECT_LT(sample.eta_seconds, 0.0);
+}
+
+TEST_F(ProgressTest, missing_file_is_not_read) {
+  ProgressSample sample;
+  EXPECT_EQ(1, ReadProgressFile((path_ + "rank-0.progress").c_str(),
+                                &sample));
+}
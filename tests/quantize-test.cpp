@@ -0,0 +1,125 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "calendar.h"
+#include "config.h"
+#include "quantize.h"
+#include "weather_file.h"
+}
+
+TEST(QuantizeTest, values_print_as_their_floats) {
+  const float fill = 1.0e20f;
+  const float values[] = {0.25f, 0.35f, -0.04f, -0.05f, 12.345f, -40.15f,
+                          273.15f, 0.0f, 99.95f, 1.0e20f, 3.0f, -0.0f};
+  const size_t length = sizeof(values) / sizeof(values[0]);
+  int16_t quantized[length];
+  int32_t offset = QuantizeOffset(values, length, fill);
+  ASSERT_EQ(0u, QuantizeValues(values, length, fill, offset, quantized));
+  for (size_t i = 0; i < length; ++i) {
+    char expected[32];
+    char actual[32];
+    snprintf(expected, sizeof(expected), " %5.1f", values[i]);
+    snprintf(actual, sizeof(actual), " %5.1f",
+             DequantizeValue(quantized[i], offset, fill));
+    EXPECT_STREQ(expected, actual) << "value #" << i;
+  }
+  EXPECT_EQ(QUANTIZED_FILL, quantized[9]);
+  EXPECT_EQ(QUANTIZED_NEGATIVE_ZERO, quantized[2]);
+}
+
+TEST(QuantizeTest, offset_centres_the_range) {
+  const float values[] = {1000.0f, 1020.0f, -99.0f};
+  EXPECT_EQ(10100, QuantizeOffset(values, 2, -99.0f));
+  EXPECT_EQ(0, QuantizeOffset(values + 2, 1, -99.0f));
+}
+
+TEST(QuantizeTest, values_out_of_range_are_clamped) {
+  const float values[] = {-4000.0f, 4000.0f, NAN};
+  int16_t quantized[3];
+  ASSERT_EQ(3u, QuantizeValues(values, 3, 1.0e20f, 0, quantized));
+  EXPECT_EQ(QUANTIZED_MIN, quantized[0]);
+  EXPECT_EQ(QUANTIZED_MAX, quantized[1]);
+  EXPECT_FLOAT_EQ(3276.7f, DequantizeValue(quantized[1], 0, 1.0e20f));
+}
+
+static std::string renderCell(const Config *config, const DateTable *dates,
+                              const float *series, double tav, float amp) {
+  char *text = NULL;
+  size_t text_size = 0;
+  FILE *fh = open_memstream(&text, &text_size);
+  WriteWeatherFile(fh, config, dates, LonLatPosition(-80.75, -10.25), series,
+                   tav, amp);
+  fclose(fh);
+  std::string rendered(text, text_size);
+  free(text);
+  return rendered;
+}
+
+TEST(QuantizeTest, files_render_as_their_floats) {
+  const float fill = 1.0e20f;
+  const size_t days = 59;
+  const size_t plane = 2;
+  DateTable dates;
+  ASSERT_EQ(0, BuildDateTable("2011-01-01", days, &dates));
+  FileConfig mappings[3];
+  memset(mappings, 0, sizeof(mappings));
+  const char *names[3] = {"TMIN", "TMAX", "RAIN"};
+  for (size_t m = 0; m < 3; ++m) {
+    mappings[m].dssat_var = (char *)names[m];
+    mappings[m].is_temp = m < 2 ? (int)m + 1 : 0;
+    mappings[m].output = 1;
+  }
+  Config config;
+  memset(&config, 0, sizeof(Config));
+  config.mappings = mappings;
+  config.num_mappings = 3;
+  // The tile, day plane after day plane. Summarized from tenths the first
+  // cell would have a TAV of 0.0 instead of 0.1.
+  float tile[3][days * plane];
+  for (size_t d = 0; d < days; ++d) {
+    tile[0][d * plane] = 0.04f;
+    tile[1][d * plane] = 0.12f;
+    tile[2][d * plane] = 0.0f;
+    tile[0][d * plane + 1] = -3.26f + 0.13f * d;
+    tile[1][d * plane + 1] = 21.47f - 0.07f * d;
+    tile[2][d * plane + 1] = d % 7 == 0 ? 12.35f : 0.45f;
+  }
+  int16_t quantized[3][days * plane];
+  int32_t offsets[3];
+  for (size_t m = 0; m < 3; ++m) {
+    offsets[m] = QuantizeOffset(tile[m], days * plane, fill);
+    ASSERT_EQ(0u, QuantizeValues(tile[m], days * plane, fill, offsets[m],
+                                 quantized[m]));
+  }
+  double tile_tav[plane];
+  float tile_amp[plane];
+  ASSERT_EQ(0, SummarizeTileTemperatures(tile[0], tile[1], plane, &dates,
+                                         tile_tav, tile_amp));
+  float series[3 * days];
+  for (size_t i = 0; i < plane; ++i) {
+    for (size_t m = 0; m < 3; ++m) {
+      for (size_t d = 0; d < days; ++d) {
+        series[m * days + d] = tile[m][d * plane + i];
+      }
+    }
+    double tav;
+    float amp;
+    SummarizeTemperatures(series, &series[days], &dates, &tav, &amp);
+    std::string expected = renderCell(&config, &dates, series, tav, amp);
+    for (size_t m = 0; m < 3; ++m) {
+      for (size_t d = 0; d < days; ++d) {
+        series[m * days + d] =
+            DequantizeValue(quantized[m][d * plane + i], offsets[m], fill);
+      }
+    }
+    EXPECT_EQ(expected,
+              renderCell(&config, &dates, series, tile_tav[i], tile_amp[i]))
+        << "cell #" << i;
+  }
+  FreeDateTable(&dates);
+}
@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include <mpi.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "rechunk.h"
+}
+
+TEST(RechunkTest, store_name_replaces_extension) {
+  char name[64];
+  EXPECT_EQ(0, PointMajorFileName("data/tasmax.nc", name, sizeof(name)));
+  EXPECT_STREQ("data/tasmax.pm.nc", name);
+  EXPECT_EQ(0, PointMajorFileName("data/tasmax.nc4", name, sizeof(name)));
+  EXPECT_STREQ("data/tasmax.nc4.pm.nc", name);
+}
+
+TEST(RechunkTest, store_name_reports_truncation) {
+  char name[8];
+  EXPECT_EQ(1, PointMajorFileName("tasmax.nc", name, sizeof(name)));
+}
+
+TEST(RechunkTest, chunk_cells_stay_within_the_row) {
+  // 40 years of daily values take ~58KB per cell
+  EXPECT_EQ(71, PointMajorChunkCells(14610, 720));
+  EXPECT_EQ(720, PointMajorChunkCells(365, 720));
+  EXPECT_EQ(1, PointMajorChunkCells(POINT_MAJOR_CHUNK_BYTES, 720));
+}
+
+TEST(RechunkTest, missing_store_is_not_current) {
+  char source[] = "rechunk-test-source.nc";
+  char store[] = "rechunk-test-source.pm.nc";
+  FILE *fh = fopen(source, "w");
+  ASSERT_NE(nullptr, fh);
+  fclose(fh);
+  unlink(store);
+  EXPECT_EQ(0, PointMajorStoreIsCurrent(source, store));
+  fh = fopen(store, "w");
+  ASSERT_NE(nullptr, fh);
+  fclose(fh);
+  EXPECT_EQ(1, PointMajorStoreIsCurrent(source, store));
+  unlink(store);
+  unlink(source);
+}
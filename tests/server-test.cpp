@@ -0,0 +1,53 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "server.h"
+}
+
+TEST(ServerTest, requests_are_parsed) {
+  ServerRequest request;
+  ASSERT_EQ(0, ParseServerRequest("WTH -90.25 -20.25", &request));
+  EXPECT_EQ(kServerWeatherFile, request.command);
+  EXPECT_DOUBLE_EQ(-90.25, request.position.longitude);
+  EXPECT_DOUBLE_EQ(-20.25, request.position.latitude);
+  ASSERT_EQ(0, ParseServerRequest("SERIES 10.75 45.25", &request));
+  EXPECT_EQ(kServerSeries, request.command);
+  ASSERT_EQ(0, ParseServerRequest("STATS", &request));
+  EXPECT_EQ(kServerStats, request.command);
+}
+
+TEST(ServerTest, malformed_requests_are_rejected) {
+  ServerRequest request;
+  EXPECT_EQ(1, ParseServerRequest("", &request));
+  EXPECT_EQ(1, ParseServerRequest("WTH -90.25", &request));
+  EXPECT_EQ(1, ParseServerRequest("WTH -90.25 -20.25 1", &request));
+  EXPECT_EQ(1, ParseServerRequest("CELL -90.25 -20.25", &request));
+  EXPECT_EQ(1, ParseServerRequest("WTH 190.0 -20.25", &request));
+  EXPECT_EQ(1, ParseServerRequest("SERIES 0.25 -95.0", &request));
+  EXPECT_EQ(1, ParseServerRequest("STATS now", &request));
+}
+
+TEST(ServerTest, latency_percentiles_use_the_nearest_rank) {
+  LatencyWindow *window = new LatencyWindow();
+  EXPECT_DOUBLE_EQ(0.0, LatencyPercentile(window, 50.0));
+  for (int i = 100; i >= 1; --i) {
+    RecordLatency(window, i / 1000.0);
+  }
+  EXPECT_DOUBLE_EQ(0.050, LatencyPercentile(window, 50.0));
+  EXPECT_DOUBLE_EQ(0.099, LatencyPercentile(window, 99.0));
+  EXPECT_DOUBLE_EQ(0.100, LatencyPercentile(window, 100.0));
+  delete window;
+}
+
+TEST(ServerTest, latency_window_keeps_the_latest_requests) {
+  LatencyWindow *window = new LatencyWindow();
+  for (size_t i = 0; i < SERVER_LATENCY_SAMPLES; ++i) {
+    RecordLatency(window, 1.0);
+  }
+  for (size_t i = 0; i < SERVER_LATENCY_SAMPLES; ++i) {
+    RecordLatency(window, 0.5);
+  }
+  EXPECT_EQ((size_t)SERVER_LATENCY_SAMPLES, window->count);
+  EXPECT_DOUBLE_EQ(0.5, LatencyPercentile(window, 100.0));
+  delete window;
+}
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slab_cache.h"
+}
+
+class SlabCacheTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    mkdir(cache_dir, 0755);
+    FILE *fh = fopen(source, "w");
+    fputs("source", fh);
+    fclose(fh);
+    mapping.file_name = source;
+    mapping.netcdf_var = (char *)"tasmax";
+    mapping.source_unit = (char *)"K";
+    mapping.target_unit = (char *)"degree_C";
+    slab = CreateHyperslab(Position(0, 2, 3), Edges(4, 2, 2));
+    for (size_t i = 0; i < 16; ++i) {
+      values[i] = i * 0.5f;
+    }
+  }
+
+  void TearDown() override {
+    char key[SLAB_CACHE_KEY_LEN];
+    char file_name[2048];
+    SlabCacheKey(&mapping, slab, key, sizeof(key));
+    SlabCacheFileName(cache_dir, key, file_name, sizeof(file_name));
+    unlink(file_name);
+    unlink(source);
+    rmdir(cache_dir);
+  }
+
+  char cache_dir[32] = "slab-cache-entries/";
+  char source[32] = "slab-cache-test-source.nc";
+  FileConfig mapping = {};
+  Hyperslab slab;
+  float values[16];
+};
+
+TEST_F(SlabCacheTest, missing_entry_is_a_miss) {
+  SlabCacheEntry entry;
+  EXPECT_EQ(0, OpenSlabCacheEntry(cache_dir, &mapping, slab, &entry));
+  EXPECT_EQ(nullptr, entry.values);
+}
+
+TEST_F(SlabCacheTest, stored_entry_maps_values) {
+  SlabCacheEntry entry;
+  ASSERT_EQ(0, StoreSlabCacheEntry(cache_dir, &mapping, slab, values));
+  ASSERT_EQ(1, OpenSlabCacheEntry(cache_dir, &mapping, slab, &entry));
+  EXPECT_EQ(0, (size_t)entry.values % SLAB_CACHE_DATA_OFFSET);
+  for (size_t i = 0; i < 16; ++i) {
+    EXPECT_EQ(values[i], entry.values[i]);
+  }
+  CloseSlabCacheEntry(&entry);
+  EXPECT_EQ(nullptr, entry.values);
+}
+
+TEST_F(SlabCacheTest, key_covers_units_and_tile) {
+  SlabCacheEntry entry;
+  ASSERT_EQ(0, StoreSlabCacheEntry(cache_dir, &mapping, slab, values));
+  mapping.target_unit = (char *)"K";
+  EXPECT_EQ(0, OpenSlabCacheEntry(cache_dir, &mapping, slab, &entry));
+  mapping.target_unit = (char *)"degree_C";
+  Hyperslab other = CreateHyperslab(Position(0, 4, 3), Edges(4, 2, 2));
+  EXPECT_EQ(0, OpenSlabCacheEntry(cache_dir, &mapping, other, &entry));
+}
+
+TEST_F(SlabCacheTest, modified_source_invalidates_entry) {
+  SlabCacheEntry entry;
+  ASSERT_EQ(0, StoreSlabCacheEntry(cache_dir, &mapping, slab, values));
+  FILE *fh = fopen(source, "a");
+  fputs(" changed", fh);
+  fclose(fh);
+  EXPECT_EQ(0, OpenSlabCacheEntry(cache_dir, &mapping, slab, &entry));
+  char key[SLAB_CACHE_KEY_LEN];
+  char file_name[2048];
+  SlabCacheKey(&mapping, slab, key, sizeof(key));
+  SlabCacheFileName(cache_dir, key, file_name, sizeof(file_name));
+  EXPECT_NE(0, access(file_name, F_OK));
+}
@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <mpi.h>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "startup.h"
+}
+
+TEST(StartupTest, netcdf_info_round_trips) {
+  char unit[] = "K";
+  NetCdfInfo info[2];
+  memset(info, 0, sizeof(info));
+  info[0].longitude_varid = 1;
+  info[0].latitude_varid = 2;
+  info[0].time_varid = 3;
+  info[0].var_varid = 4;
+  info[0].longitude_len = 720;
+  info[0].latitude_len = 360;
+  info[0].time_len = 3653;
+  info[0].chunk_cache_size = 4194304;
+  info[0].point_major = 1;
+  info[0].fill_value = 1.0e20f;
+  info[0].unit = unit;
+  info[0].native_short = 1;
+  info[0].packed = 1;
+  info[0].scale_factor = 0.01;
+  info[0].add_offset = 273.15;
+  info[1].var_varid = -1;
+  info[1].fill_value = DERIVED_FILL_VALUE;
+  info[1].unit = NULL;
+
+  size_t size = PackNetCdfInfo(info, 2, NULL, 0);
+  std::vector<char> packed(size);
+  ASSERT_EQ(size, PackNetCdfInfo(info, 2, packed.data(), packed.size()));
+
+  NetCdfInfo copy[2];
+  ASSERT_EQ(0, UnpackNetCdfInfo(packed.data(), packed.size(), copy, 2));
+  EXPECT_EQ(4, copy[0].var_varid);
+  EXPECT_EQ(3653, copy[0].time_len);
+  EXPECT_EQ(4194304, copy[0].chunk_cache_size);
+  EXPECT_EQ(1, copy[0].point_major);
+  EXPECT_EQ(1.0e20f, copy[0].fill_value);
+  EXPECT_STREQ("K", copy[0].unit);
+  EXPECT_EQ(1, copy[0].native_short);
+  EXPECT_EQ(1, copy[0].packed);
+  EXPECT_EQ(0.01, copy[0].scale_factor);
+  EXPECT_EQ(273.15, copy[0].add_offset);
+  EXPECT_EQ(nullptr, copy[0].chunk_reader);
+  EXPECT_EQ(-1, copy[1].var_varid);
+  EXPECT_EQ(nullptr, copy[1].unit);
+  free(copy[0].unit);
+}
+
+TEST(StartupTest, time_parts_round_trip) {
+  TimePart parts[2];
+  memset(parts, 0, sizeof(parts));
+  parts[0].first_day = 3653;
+  parts[0].days = 3652;
+  parts[1].first_day = 7305;
+  parts[1].days = 3653;
+  NetCdfInfo info;
+  memset(&info, 0, sizeof(info));
+  info.time_len = 10958;
+  info.parts = parts;
+  info.num_parts = 2;
+
+  size_t size = PackNetCdfInfo(&info, 1, NULL, 0);
+  std::vector<char> packed(size);
+  ASSERT_EQ(size, PackNetCdfInfo(&info, 1, packed.data(), packed.size()));
+
+  NetCdfInfo copy;
+  ASSERT_EQ(0, UnpackNetCdfInfo(packed.data(), packed.size(), &copy, 1));
+  ASSERT_EQ(2, copy.num_parts);
+  EXPECT_EQ(3653, copy.parts[0].first_day);
+  EXPECT_EQ(3652, copy.parts[0].days);
+  EXPECT_EQ(7305, copy.parts[1].first_day);
+  EXPECT_EQ(3653, copy.parts[1].days);
+  EXPECT_EQ(-1, copy.parts[1].netcdf_id);
+  EXPECT_EQ(nullptr, copy.parts[1].chunk_reader);
+  free(copy.parts);
+}
+
+TEST(StartupTest, truncated_netcdf_info_is_rejected) {
+  char unit[] = "mm s-1";
+  NetCdfInfo info;
+  memset(&info, 0, sizeof(info));
+  info.unit = unit;
+  size_t size = PackNetCdfInfo(&info, 1, NULL, 0);
+  std::vector<char> packed(size);
+  PackNetCdfInfo(&info, 1, packed.data(), packed.size());
+  NetCdfInfo copy;
+  EXPECT_EQ(1, UnpackNetCdfInfo(packed.data(), size - 2, &copy, 1));
+  free(copy.unit);
+}
@@ -0,0 +1,71 @@
+#include <string.h>
+
+#include <mpi.h>
+#include <netcdf.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "summary.h"
+}
+
+static const float kFill = 1.0e20f;
+
+// RAIN, TMIN and a mapping which is read but not written.
+static Config MakeConfig(FileConfig *mappings) {
+  Config config;
+  memset(&config, 0, sizeof(config));
+  memset(mappings, 0, sizeof(FileConfig) * 3);
+  mappings[0].dssat_var = (char *)"RAIN";
+  mappings[0].output = 1;
+  mappings[1].dssat_var = (char *)"TMIN";
+  mappings[1].output = 1;
+  config.mappings = mappings;
+  config.num_mappings = 3;
+  return config;
+}
+
+TEST(SummaryTest, series_gives_annual_rain_and_missing_days) {
+  FileConfig mappings[3];
+  Config config = MakeConfig(mappings);
+  float fills[3] = {kFill, kFill, kFill};
+  // Four days: rain is missing on the second, TMIN on the fourth and the
+  // unwritten mapping on the first, which does not count.
+  float series[12] = {1.0f, kFill, 3.0f, 4.0f, 10.0f, 11.0f,
+                      12.0f, kFill, kFill, 0.0f, 0.0f, 0.0f};
+  float rain;
+  int missing_days;
+  SummarizeSeries(&config, fills, series, 4, &rain, &missing_days);
+  EXPECT_FLOAT_EQ((float)(8.0 * SUMMARY_DAYS_PER_YEAR / 4), rain);
+  EXPECT_EQ(2, missing_days);
+}
+
+TEST(SummaryTest, series_without_rain_is_filled) {
+  FileConfig mappings[3];
+  Config config = MakeConfig(mappings);
+  mappings[0].dssat_var = (char *)"SRAD";
+  float fills[3] = {kFill, kFill, kFill};
+  float series[6] = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f};
+  float rain;
+  int missing_days;
+  SummarizeSeries(&config, fills, series, 2, &rain, &missing_days);
+  EXPECT_EQ(NC_FILL_FLOAT, rain);
+  EXPECT_EQ(0, missing_days);
+}
+
+TEST(SummaryTest, cells_land_at_their_place_in_the_slab) {
+  Hyperslab slab = CreateHyperslab(Position(0, 10, 20), Edges(5, 3, 2));
+  SummaryGrid grid;
+  ASSERT_EQ(0, InitSummaryGrid(&grid, slab));
+  EXPECT_EQ((size_t)6, grid.cells);
+  AddCellSummary(&grid, XYPosition(12, 21), 15.5, 8.0f, 700.0f, 3);
+  // Row 1 of the slab, column 2
+  EXPECT_FLOAT_EQ(15.5f, grid.tav[5]);
+  EXPECT_FLOAT_EQ(8.0f, grid.amp[5]);
+  EXPECT_FLOAT_EQ(700.0f, grid.rain[5]);
+  EXPECT_EQ(3, grid.missing_days[5]);
+  EXPECT_EQ(NC_FILL_FLOAT, grid.tav[0]);
+  EXPECT_EQ(NC_FILL_INT, grid.missing_days[4]);
+  FreeSummaryGrid(&grid);
+  EXPECT_EQ(nullptr, grid.tav);
+}
@@ -0,0 +1,50 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "tile_cache.h"
+}
+
+TEST(TileCacheTest, lookups_hit_loaded_tiles) {
+  TileCache cache;
+  ASSERT_EQ(0, InitTileCache(&cache, 2, 4));
+  int hit;
+  TileCacheEntry *entry = LookupTile(&cache, 1, 2, &hit);
+  EXPECT_EQ(0, hit);
+  entry->values[0] = 42.0f;
+  entry = LookupTile(&cache, 1, 2, &hit);
+  EXPECT_EQ(1, hit);
+  EXPECT_FLOAT_EQ(42.0f, entry->values[0]);
+  EXPECT_EQ(1u, cache.hits);
+  EXPECT_EQ(1u, cache.misses);
+  FreeTileCache(&cache);
+  EXPECT_EQ(nullptr, cache.entries);
+}
+
+TEST(TileCacheTest, least_recently_used_tile_is_evicted) {
+  TileCache cache;
+  ASSERT_EQ(0, InitTileCache(&cache, 2, 1));
+  int hit;
+  LookupTile(&cache, 0, 0, &hit);
+  LookupTile(&cache, 1, 0, &hit);
+  // Using the first tile again leaves the second one to be evicted
+  LookupTile(&cache, 0, 0, &hit);
+  EXPECT_EQ(1, hit);
+  LookupTile(&cache, 2, 0, &hit);
+  EXPECT_EQ(0, hit);
+  LookupTile(&cache, 0, 0, &hit);
+  EXPECT_EQ(1, hit);
+  LookupTile(&cache, 1, 0, &hit);
+  EXPECT_EQ(0, hit);
+  FreeTileCache(&cache);
+}
+
+TEST(TileCacheTest, invalidated_tile_is_loaded_again) {
+  TileCache cache;
+  ASSERT_EQ(0, InitTileCache(&cache, 1, 1));
+  int hit;
+  InvalidateTile(LookupTile(&cache, 3, 4, &hit));
+  LookupTile(&cache, 3, 4, &hit);
+  EXPECT_EQ(0, hit);
+  EXPECT_EQ(2u, cache.misses);
+  FreeTileCache(&cache);
+}
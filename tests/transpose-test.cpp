@@ -0,0 +1,63 @@
+#include <mpi.h>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "transpose.h"
+}
+
+// Every day of every file has to be read by exactly one rank.
+static void ExpectFullCover(int strategy, size_t num_files, size_t time_len,
+                            int size) {
+  for (size_t file = 0; file < num_files; ++file) {
+    std::vector<int> readers(time_len, 0);
+    for (int rank = 0; rank < size; ++rank) {
+      size_t first;
+      size_t days;
+      PlanTransposedRead(strategy, num_files, file, time_len, rank, size,
+                         &first, &days);
+      for (size_t d = first; d < first + days; ++d) {
+        ASSERT_LT(d, time_len);
+        ++readers[d];
+      }
+    }
+    for (size_t d = 0; d < time_len; ++d) {
+      EXPECT_EQ(1, readers[d]) << "file " << file << " day " << d;
+    }
+  }
+}
+
+TEST(TransposeTest, time_plan_splits_the_days_of_every_file) {
+  size_t first;
+  size_t days;
+  PlanTransposedRead(read_by_time, 4, 2, 10, 1, 3, &first, &days);
+  EXPECT_EQ(4u, first);
+  EXPECT_EQ(3u, days);
+  ExpectFullCover(read_by_time, 4, 10, 3);
+  ExpectFullCover(read_by_time, 2, 3, 5);
+}
+
+TEST(TransposeTest, variable_plan_deals_files_to_ranks) {
+  size_t first;
+  size_t days;
+  // Six ranks over four files: files 0 and 1 get two readers each
+  PlanTransposedRead(read_by_variable, 4, 1, 10, 5, 6, &first, &days);
+  EXPECT_EQ(5u, first);
+  EXPECT_EQ(5u, days);
+  PlanTransposedRead(read_by_variable, 4, 1, 10, 2, 6, &first, &days);
+  EXPECT_EQ(0u, days);
+  ExpectFullCover(read_by_variable, 4, 10, 6);
+  ExpectFullCover(read_by_variable, 4, 10, 4);
+}
+
+TEST(TransposeTest, variable_plan_reads_whole_files_with_few_ranks) {
+  size_t first;
+  size_t days;
+  PlanTransposedRead(read_by_variable, 5, 3, 10, 1, 2, &first, &days);
+  EXPECT_EQ(0u, first);
+  EXPECT_EQ(10u, days);
+  ExpectFullCover(read_by_variable, 5, 10, 2);
+  ExpectFullCover(read_by_variable, 5, 10, 1);
+}